@@ -0,0 +1,76 @@
+// Directory jumping benchmark: cost of recording a cd and of answering a z
+// query against a database of tens of thousands of directories.
+#include "frecency.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+
+namespace {
+    const int DIRECTORIES = 40000;
+    const int ITERATIONS = 20000;
+
+    template <typename Function>
+    void measure(const char* label, int iterations, Function function) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            function(i);
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        double microseconds = std::chrono::duration<double, std::micro>(elapsed).count() / iterations;
+        std::printf("  %-32s %10.2f us/op\n", label, microseconds);
+    }
+
+    std::string directoryName(int i) {
+        return "/home/user/projects/group" + std::to_string(i % 97) + "/repo" + std::to_string(i) + "/src";
+    }
+}
+
+int main() {
+    char pathTemplate[] = "/tmp/lynx-frecency-XXXXXX";
+    int fd = mkstemp(pathTemplate);
+    if (fd < 0) {
+        return 1;
+    }
+    close(fd);
+    unlink(pathTemplate);
+
+    int64_t now = 1700000000;
+    {
+        FrecencyDatabase database(pathTemplate);
+        std::printf("Database with %d directories\n", DIRECTORIES);
+        measure("record new directory", DIRECTORIES, [&](int i) {
+            database.recordVisit(directoryName(i), now + i / 100);
+        });
+        measure("record revisit", ITERATIONS, [&](int i) {
+            database.recordVisit(directoryName((i * 7919) % DIRECTORIES), now + DIRECTORIES / 100 + i / 100);
+        });
+
+        // Queries stat() their answer, so rank one that exists on top
+        for (int i = 0; i < 3; ++i) {
+            database.recordVisit("/tmp", now + DIRECTORIES);
+        }
+        std::string result;
+        measure("query (top match)", ITERATIONS, [&](int) {
+            database.query({"tmp"}, "", result);
+        });
+        measure("query (two terms, stale entries)", 200, [&](int i) {
+            database.query({"group" + std::to_string(i % 97), "src"}, "", result);
+        });
+        measure("query (no match, full scan)", 200, [&](int) {
+            database.query({"nomatch"}, "", result);
+        });
+    }
+    {
+        auto start = std::chrono::steady_clock::now();
+        FrecencyDatabase database(pathTemplate);
+        std::string result;
+        database.query({"tmp"}, "", result);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        std::printf("  %-32s %10.2f ms\n", "open + first query",
+                    std::chrono::duration<double, std::milli>(elapsed).count());
+    }
+
+    unlink(pathTemplate);
+    return 0;
+}
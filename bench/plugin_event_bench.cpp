@@ -0,0 +1,204 @@
+// Plugin event benchmark: what one command costs in event dispatch (input,
+// before, after and the next prompt) with 0, 5 and 50 plugins loaded, for
+// string map contexts against typed events and subscription masks.
+#include "plugin.h"
+#include <chrono>
+#include <memory>
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    const int ITERATIONS = 200000;
+
+    template <typename Function>
+    void measure(const char* label, int iterations, Function function) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            function(i);
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        double nanoseconds = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+        std::printf("  %-40s %10.1f ns/command\n", label, nanoseconds);
+    }
+
+    // Counts what it sees so the handlers cannot be optimized away
+    class CountingPlugin : public IPlugin {
+    public:
+        CountingPlugin(int id, PluginEventMask mask, bool typed) : mask(mask), typed(typed) {
+            info.name = "bench" + std::to_string(id);
+            info.version = "1.0.0";
+        }
+
+        bool initialize(Shell*) override { return true; }
+        void shutdown() override {}
+        const PluginInfo& getInfo() const override { return info; }
+        PluginEventMask subscribedEvents() const override { return mask; }
+
+        void onEvent(PluginEvent, const std::map<std::string, std::string>& context) override {
+            seen += context.size();
+        }
+
+        bool handleEvent(const PluginEventData& event) override {
+            if (!typed) {
+                return false;
+            }
+            if (delay.count() > 0) {
+                std::this_thread::sleep_for(delay);
+            }
+            seen += event.command.size() + static_cast<size_t>(event.exitCode);
+            return true;
+        }
+
+        size_t seen = 0;
+        std::chrono::microseconds delay{0};
+
+    private:
+        PluginInfo info;
+        PluginEventMask mask;
+        bool typed;
+    };
+
+    struct CommandState {
+        std::string input = "git status --short";
+        std::string name = "git";
+        std::vector<std::string> args = {"status", "--short"};
+        std::string directory = "/home/user/projects/lynx";
+        int exitCode = 0;
+    };
+
+    using PluginMap = std::map<std::string, std::unique_ptr<IPlugin>>;
+
+    // The previous broadcastEvent(): every plugin, every event
+    void broadcastMap(PluginMap& plugins, PluginEvent event, const std::map<std::string, std::string>& context) {
+        for (auto& [name, plugin] : plugins) {
+            try {
+                plugin->onEvent(event, context);
+            } catch (const std::exception&) {
+            }
+        }
+    }
+
+    // The events Shell sends around one command, the way it used to
+    void dispatchMaps(PluginMap& plugins, const CommandState& state) {
+        std::map<std::string, std::string> input;
+        input["input"] = state.input;
+        broadcastMap(plugins, PluginEvent::INPUT_RECEIVED, input);
+
+        std::map<std::string, std::string> before;
+        before["command"] = state.name;
+        before["args"] = "";
+        for (const auto& arg : state.args) {
+            before["args"] += arg + " ";
+        }
+        broadcastMap(plugins, PluginEvent::COMMAND_BEFORE, before);
+
+        std::map<std::string, std::string> after;
+        after["command"] = state.name;
+        after["exit_code"] = std::to_string(state.exitCode);
+        after["success"] = state.exitCode == 0 ? "true" : "false";
+        broadcastMap(plugins, PluginEvent::COMMAND_AFTER, after);
+
+        std::map<std::string, std::string> prompt;
+        prompt["directory"] = state.directory;
+        prompt["exit_code"] = std::to_string(state.exitCode);
+        broadcastMap(plugins, PluginEvent::PROMPT_DISPLAY, prompt);
+    }
+
+    // The same events as Shell sends them now
+    void dispatchTyped(PluginManager& manager, const CommandState& state) {
+        if (manager.hasSubscribers(PluginEvent::INPUT_RECEIVED)) {
+            PluginEventData event(PluginEvent::INPUT_RECEIVED);
+            event.input = state.input;
+            manager.broadcastEvent(event);
+        }
+        if (manager.hasSubscribers(PluginEvent::COMMAND_BEFORE)) {
+            PluginEventData event(PluginEvent::COMMAND_BEFORE);
+            event.command = state.name;
+            event.args = &state.args;
+            manager.broadcastEvent(event);
+        }
+        if (manager.hasSubscribers(PluginEvent::COMMAND_AFTER)) {
+            PluginEventData event(PluginEvent::COMMAND_AFTER);
+            event.command = state.name;
+            event.exitCode = state.exitCode;
+            event.success = state.exitCode == 0;
+            manager.broadcastEvent(event);
+        }
+        if (manager.hasSubscribers(PluginEvent::PROMPT_DISPLAY)) {
+            PluginEventData event(PluginEvent::PROMPT_DISPLAY);
+            event.directory = state.directory;
+            event.exitCode = state.exitCode;
+            manager.broadcastEvent(event);
+        }
+    }
+
+    void run(int count) {
+        CommandState state;
+        std::printf("%d plugins\n", count);
+
+        PluginMap direct;
+        for (int i = 0; i < count; ++i) {
+            auto plugin = std::make_unique<CountingPlugin>(i, ALL_PLUGIN_EVENTS, false);
+            std::string name = plugin->getInfo().name;
+            direct[name] = std::move(plugin);
+        }
+        measure("string maps (previous dispatch)", ITERATIONS, [&](int) {
+            dispatchMaps(direct, state);
+        });
+
+        struct Setup {
+            const char* name;
+            PluginEventMask mask;
+            bool typed;
+        };
+        const Setup setups[] = {
+            {"onEvent() through the adapter", ALL_PLUGIN_EVENTS, false},
+            {"typed, all events", ALL_PLUGIN_EVENTS, true},
+            {"typed, COMMAND_AFTER only", pluginEventBit(PluginEvent::COMMAND_AFTER), true},
+            {"async, all events", ALL_PLUGIN_EVENTS | PLUGIN_EVENTS_ASYNC, true},
+        };
+        for (const Setup& setup : setups) {
+            PluginManager manager(nullptr);
+            manager.setEventBudget(50);  // The shell's default
+            for (int i = 0; i < count; ++i) {
+                manager.addPlugin(std::make_unique<CountingPlugin>(i, setup.mask, setup.typed));
+            }
+            measure(setup.name, ITERATIONS, [&](int i) {
+                state.exitCode = i & 1;
+                dispatchTyped(manager, state);
+            });
+        }
+    }
+
+    // The shell-side cost per command of one plugin with a 200 us handler
+    void runSlow() {
+        CommandState state;
+        std::printf("1 plugin with a 200 us handler\n");
+        for (bool async : {false, true}) {
+            PluginManager manager(nullptr);
+            PluginEventMask mask = ALL_PLUGIN_EVENTS | (async ? PLUGIN_EVENTS_ASYNC : 0);
+            auto plugin = std::make_unique<CountingPlugin>(0, mask, true);
+            plugin->delay = std::chrono::microseconds(200);
+            manager.addPlugin(std::move(plugin));
+            measure(async ? "async" : "synchronous", 2000, [&](int) {
+                dispatchTyped(manager, state);
+            });
+        }
+    }
+}
+
+int main() {
+    // Posting flat out overruns the async queues by design; skip the reports
+    std::cerr.rdbuf(nullptr);
+
+    for (int count : {0, 5, 50}) {
+        run(count);
+    }
+    runSlow();
+    return 0;
+}
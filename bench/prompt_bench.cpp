@@ -0,0 +1,119 @@
+// Prompt rendering benchmark: the per-prompt regex / find-replace code that
+// used to live in ExternalThemeManager and ThemeManager, against the
+// precompiled PromptTemplate that replaced it.
+#include "theme_manager.h"
+#include <chrono>
+#include <cstdio>
+#include <regex>
+#include <string>
+
+namespace {
+    const int ITERATIONS = 200000;
+    const std::string DIRECTORY = "/home/user/projects/lynx/src/plugins";
+    size_t sink = 0;
+
+    template <typename Function>
+    void measure(const char* label, Function function) {
+        function();  // warm up
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ITERATIONS; ++i) {
+            function();
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        double nanoseconds = std::chrono::duration<double, std::nano>(elapsed).count() / ITERATIONS;
+        std::printf("  %-28s %10.1f ns/prompt\n", label, nanoseconds);
+    }
+
+    // ExternalThemeManager::formatPrompt before templates
+    std::string legacyExternalPrompt(const ThemeConfig& theme, const std::string& directory, int exitCode) {
+        std::string prompt = theme.promptFormat;
+        prompt = std::regex_replace(prompt, std::regex("\\{prefix\\}"), theme.colors[ThemeColor::PromptPrefix]);
+        prompt = std::regex_replace(prompt, std::regex("\\{directory\\}"),
+                                    theme.colors[ThemeColor::PromptDirectory] + directory + theme.colors[ThemeColor::Reset]);
+        prompt = std::regex_replace(prompt, std::regex("\\{suffix\\}"), theme.colors[ThemeColor::PromptSuffix]);
+        if (theme.showExitCode && exitCode != 0) {
+            prompt += theme.colors[ThemeColor::OutputError] + "[" + std::to_string(exitCode) + "]" + theme.colors[ThemeColor::Reset] + " ";
+        }
+        return prompt + theme.colors[ThemeColor::Reset];
+    }
+
+    // ThemeManager::formatPrompt before templates
+    std::string legacyConfigPrompt(const std::string& format, const PromptTemplate::Style& style,
+                                   const std::string& user, const std::string& host,
+                                   const std::string& cwd, int exitCode) {
+        std::string result = format;
+        size_t pos = 0;
+        while ((pos = result.find("{user}", pos)) != std::string::npos) {
+            result.replace(pos, 6, style.user + user + style.reset);
+            pos += style.user.length() + user.length() + style.reset.length();
+        }
+        pos = 0;
+        while ((pos = result.find("{host}", pos)) != std::string::npos) {
+            result.replace(pos, 6, style.host + host + style.reset);
+            pos += style.host.length() + host.length() + style.reset.length();
+        }
+        pos = 0;
+        while ((pos = result.find("{cwd}", pos)) != std::string::npos) {
+            std::string displayCwd = cwd;
+            if (displayCwd.length() > 40) {
+                displayCwd = "..." + displayCwd.substr(displayCwd.length() - 37);
+            }
+            result.replace(pos, 5, style.directory + displayCwd + style.reset);
+            pos += style.directory.length() + displayCwd.length() + style.reset.length();
+        }
+        if (exitCode != 0) {
+            pos = result.find("$ ");
+            if (pos != std::string::npos) {
+                result.insert(pos, style.error + "[" + std::to_string(exitCode) + "]" + style.reset + " ");
+            }
+        }
+        pos = result.rfind("$ ");
+        if (pos != std::string::npos) {
+            result.replace(pos, 2, style.symbol + "$ " + style.reset);
+        }
+        return result;
+    }
+}
+
+int main() {
+    ExternalThemeManager themes;
+    const ThemeConfig& theme = *themes.getCurrentTheme();
+
+    std::printf("Theme prompt \"%s\"\n", theme.promptFormat.c_str());
+    measure("before (std::regex)", [&]() {
+        sink += legacyExternalPrompt(theme, DIRECTORY, 1).size();
+    });
+    std::string prompt;
+    measure("after (PromptTemplate)", [&]() {
+        themes.formatPrompt(DIRECTORY, 1, prompt);
+        sink += prompt.size();
+    });
+
+    const std::string format = "{user}@{host}:{cwd}$ ";
+    PromptTemplate::Style style;
+    style.user = AnsiColors::GREEN;
+    style.host = AnsiColors::BLUE;
+    style.directory = AnsiColors::CYAN;
+    style.symbol = AnsiColors::WHITE;
+    style.error = AnsiColors::RED;
+    style.reset = AnsiColors::RESET;
+    style.directoryLimit = 40;
+    PromptTemplate compiled("{user}@{host}:{cwd}{exit_code}{symbol}");
+    PromptTemplate::Values values;
+    values.user = "user";
+    values.host = "workstation";
+    values.directory = DIRECTORY;
+    values.exitCode = 1;
+
+    std::printf("Config prompt \"%s\"\n", format.c_str());
+    measure("before (find/replace)", [&]() {
+        sink += legacyConfigPrompt(format, style, "user", "workstation", DIRECTORY, 1).size();
+    });
+    measure("after (PromptTemplate)", [&]() {
+        prompt.clear();
+        compiled.render(style, values, prompt);
+        sink += prompt.size();
+    });
+
+    return sink == 0;
+}
@@ -0,0 +1,143 @@
+// Theme loading benchmark: the same theme parsed from JSON and from INI,
+// as done the first time a theme is selected.
+#include "theme_manager.h"
+#include "json_reader.h"
+#include <cstring>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+namespace {
+    const int ITERATIONS = 20000;
+
+    const char* JSON_THEME = R"({
+  "info": {
+    "name": "ocean",
+    "version": "1.0.0",
+    "author": "Lynx Shell Team",
+    "description": "Ocean-inspired theme with blue and teal colors"
+  },
+  "colors": {
+    "prompt_prefix": "#0080FF",
+    "prompt_directory": "#00CED1",
+    "prompt_suffix": "#20B2AA",
+    "prompt_input": "#F0F8FF",
+    "output_normal": "#F0F8FF",
+    "output_success": "#00FF7F",
+    "output_warning": "#FFD700",
+    "output_error": "#FF6347",
+    "output_info": "#87CEEB",
+    "syntax_keyword": "#4169E1",
+    "syntax_string": "#32CD32",
+    "syntax_number": "#DA70D6",
+    "syntax_comment": "#708090",
+    "syntax_operator": "#FFA500",
+    "highlight_background": "\u001b[48;5;17m",
+    "selection_background": "\u001b[48;5;24m",
+    "cursor_color": "#00CED1"
+  },
+  "settings": {
+    "prompt_format": "{prefix}🌊 {directory} {suffix}➜ ",
+    "show_git_branch": true,
+    "show_exit_code": true,
+    "show_timestamp": false
+  }
+}
+)";
+
+    const char* INI_THEME = R"(# Ocean theme
+[info]
+name = ocean
+version = 1.0.0
+author = Lynx Shell Team
+description = Ocean-inspired theme with blue and teal colors
+
+[colors]
+prompt_prefix = #0080FF
+prompt_directory = #00CED1
+prompt_suffix = #20B2AA
+prompt_input = #F0F8FF
+output_normal = #F0F8FF
+output_success = #00FF7F
+output_warning = #FFD700
+output_error = #FF6347
+output_info = #87CEEB
+syntax_keyword = #4169E1
+syntax_string = #32CD32
+syntax_number = #DA70D6
+syntax_comment = #708090
+syntax_operator = #FFA500
+highlight_background = "\033[48;5;17m"  # Dark blue background
+selection_background = "\033[48;5;24m"
+cursor_color = #00CED1
+
+[settings]
+prompt_format = "{prefix}🌊 {directory} {suffix}➜ "
+show_git_branch = true
+show_exit_code = true
+show_timestamp = false
+)";
+
+    template <typename Function>
+    void measure(const char* label, int iterations, Function function) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            function();
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        double microseconds = std::chrono::duration<double, std::micro>(elapsed).count() / iterations;
+        std::printf("  %-32s %10.2f us/op\n", label, microseconds);
+    }
+
+    bool writeFile(const std::string& path, const char* content) {
+        std::ofstream file(path);
+        file << content;
+        return static_cast<bool>(file);
+    }
+}
+
+int main() {
+    char directoryTemplate[] = "/tmp/lynx-theme-XXXXXX";
+    if (!mkdtemp(directoryTemplate)) {
+        return 1;
+    }
+    std::string jsonPath = std::string(directoryTemplate) + "/ocean.json";
+    std::string iniPath = std::string(directoryTemplate) + "/ocean.theme";
+    if (!writeFile(jsonPath, JSON_THEME) || !writeFile(iniPath, INI_THEME)) {
+        return 1;
+    }
+
+    ExternalThemeManager manager;
+    if (!manager.loadThemeFromJSON(jsonPath) || !manager.loadThemeFromINI(iniPath)) {
+        std::fprintf(stderr, "theme_bench: failed to load the test theme\n");
+        return 1;
+    }
+
+    std::printf("Loading one theme (%d iterations)\n", ITERATIONS);
+    measure("JSON (mmap, streaming)", ITERATIONS, [&]() {
+        manager.loadThemeFromJSON(jsonPath);
+    });
+    measure("INI (ifstream, line based)", ITERATIONS, [&]() {
+        manager.loadThemeFromINI(iniPath);
+    });
+
+    // Opening and mapping the file dominates the above; this is the parse alone
+    size_t tokens = 0;
+    measure("JSON tokenize only", ITERATIONS, [&]() {
+        JsonReader reader(JSON_THEME, std::strlen(JSON_THEME));
+        for (JsonReader::Token token = reader.next(); token != JsonReader::Token::End &&
+             token != JsonReader::Token::Error; token = reader.next()) {
+            ++tokens;
+        }
+    });
+    if (tokens == 0) {
+        return 1;
+    }
+
+    unlink(jsonPath.c_str());
+    unlink(iniPath.c_str());
+    rmdir(directoryTemplate);
+    return 0;
+}
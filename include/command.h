@@ -26,15 +26,22 @@ public:
     static bool executeBuiltinCommand(const Command& cmd, Shell* shell = nullptr);
     static int executeExternalCommand(const Command& cmd);
     static bool isBuiltinCommand(const std::string& commandName);
+    static const std::vector<std::string>& getBuiltinCommands();
     
 private:
-    static bool executeCD(const std::vector<std::string>& args);
-    static bool executePWD();
-    static bool executeExit();
+    static bool executeCD(const std::vector<std::string>& args, Shell* shell);
+    static bool executePWD(const std::vector<std::string>& args, Shell* shell);
+    static bool executePushd(const std::vector<std::string>& args, Shell* shell);
+    static bool executePopd(const std::vector<std::string>& args, Shell* shell);
+    static bool executeDirs(const std::vector<std::string>& args, Shell* shell);
+    static bool executeJump(const std::vector<std::string>& args, Shell* shell);
+    static bool executeExit(Shell* shell);
     static bool executeHelp();
-    static bool executeHistory(Shell* shell);
+    static bool executeHistory(const std::vector<std::string>& args, Shell* shell);
     static bool executeEnv();
     static bool executeVersion();
+    static bool executeSet(const std::vector<std::string>& args, Shell* shell);
+    static bool executePlugins(const std::vector<std::string>& args, Shell* shell);
 };
 
 #endif // COMMAND_H
@@ -0,0 +1,180 @@
+#ifndef COMPLETION_H
+#define COMPLETION_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <sys/types.h>
+
+// Forward declarations
+class Shell;
+
+/**
+ * Radix Tree
+ * Compressed prefix tree; children are kept sorted so lookups return
+ * candidates in lexicographic order
+ */
+class RadixTree {
+public:
+    RadixTree();
+
+    void insert(const std::string& word);
+    bool contains(const std::string& word) const;
+    void collect(const std::string& prefix, std::vector<std::string>& out, size_t limit) const;
+    size_t size() const { return count; }
+
+private:
+    struct Node {
+        std::string label;
+        bool terminal = false;
+        std::vector<std::unique_ptr<Node>> children;
+    };
+
+    Node root;
+    size_t count;
+
+    static void collectFrom(const Node& node, std::string& word, std::vector<std::string>& out, size_t limit);
+};
+
+/**
+ * Completion Result
+ * Candidates replace the bytes [start, end) of the input line
+ */
+struct CompletionResult {
+    size_t start = 0;
+    size_t end = 0;
+    bool ignoreCase = false;
+    std::vector<std::string> candidates;
+};
+
+/**
+ * Command Completer
+ * Indexes every executable on PATH in a background thread. Lookups read an
+ * immutable snapshot and never wait for the indexer.
+ */
+class CommandCompleter {
+public:
+    CommandCompleter();
+    ~CommandCompleter();
+
+    void start();
+    void requestRefresh();
+    bool isReady() const;
+    uint64_t getGeneration() const { return generation.load(); }
+
+    void complete(const std::string& prefix, std::vector<std::string>& out, size_t limit) const;
+    bool isExecutable(const std::string& name) const;
+
+private:
+    struct DirectoryListing {
+        dev_t device = 0;
+        ino_t inode = 0;
+        int64_t mtimeNs = -1;
+        std::vector<std::string> executables;
+    };
+
+    std::shared_ptr<const RadixTree> snapshot;
+    std::atomic<uint64_t> generation;
+    std::thread worker;
+    mutable std::mutex mutex;
+    std::condition_variable wakeup;
+    bool stopRequested;
+    bool refreshRequested;
+    std::string requestedPath;
+
+    // Owned by the worker thread
+    std::map<std::string, DirectoryListing> directories;
+    std::string indexedPath;
+
+    void workerLoop();
+    void rescan(const std::string& path);
+    static bool scanDirectory(const std::string& path, DirectoryListing& listing);
+};
+
+/**
+ * Path Completer
+ * Caches sorted directory listings keyed by device, inode and mtime, so
+ * completing again in an unchanged directory costs one stat() instead of a
+ * full readdir()
+ */
+class PathCompleter {
+public:
+    explicit PathCompleter(bool caseSensitive = false);
+
+    void setCaseSensitive(bool enabled);
+    bool isCaseSensitive() const { return caseSensitive; }
+
+    // Relative words are resolved against workingDirectory, so ".." follows
+    // the same logical path cd does
+    void complete(const std::string& word, const std::string& workingDirectory, std::vector<std::string>& out,
+                  size_t limit, bool directoriesOnly = false);
+
+private:
+    struct Listing {
+        dev_t device = 0;
+        ino_t inode = 0;
+        int64_t mtimeNs = -1;
+        uint64_t lastUsed = 0;
+
+        // Names packed back to back in one buffer, sorted byte-wise or by
+        // ASCII-folded name to match the completer's case sensitivity
+        std::string names;
+        std::vector<uint32_t> offsets;
+        std::vector<uint8_t> isDirectory;
+
+        size_t size() const { return isDirectory.size(); }
+        std::string_view name(size_t i) const {
+            return std::string_view(names).substr(offsets[i], offsets[i + 1] - offsets[i]);
+        }
+    };
+
+    bool caseSensitive;
+    uint64_t useCounter;
+    std::map<std::pair<dev_t, ino_t>, Listing> cache;
+
+    const Listing* getListing(const std::string& directory);
+    static bool readListing(const std::string& directory, bool caseSensitive, Listing& listing);
+};
+
+/**
+ * Command Kinds
+ * What a command name resolves to, in the order the shell looks it up
+ */
+enum class CommandKind {
+    Unknown,
+    Builtin,
+    Plugin,
+    Executable
+};
+
+/**
+ * Completion Engine
+ * Decides what the word under the cursor is and asks the right completer
+ */
+class CompletionEngine {
+public:
+    explicit CompletionEngine(Shell* shell);
+
+    CompletionResult complete(const std::string& line, size_t cursor);
+    void refresh();
+    CommandKind classifyCommand(const std::string& name) const;
+    CommandCompleter& getCommandCompleter() { return commandCompleter; }
+    PathCompleter& getPathCompleter() { return pathCompleter; }
+
+private:
+    Shell* shell;
+    CommandCompleter commandCompleter;
+    PathCompleter pathCompleter;
+    std::chrono::steady_clock::time_point lastRefresh;
+
+    void completeCommand(const std::string& prefix, std::vector<std::string>& out);
+};
+
+#endif // COMPLETION_H
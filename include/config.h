@@ -5,46 +5,88 @@
 #include <unordered_map>
 #include <vector>
 #include <memory>
+#include <array>
+#include <deque>
+#include "config_schema.h"
 
 // Forward declarations
-class ThemeManager;
 class AliasManager;
+class ConfigWriter;
 
 class ConfigManager {
 private:
     std::unordered_map<std::string, std::string> settings;
     std::string configFilePath;
     std::string configDirPath;
+    std::string homeDirPath;
     
-    std::unique_ptr<ThemeManager> themeManager;
     std::unique_ptr<AliasManager> aliasManager;
     
+    // Known settings parsed for their type; settings keeps every key,
+    // including ones only plugins read
+    std::array<ConfigSchema::Value, ConfigSchema::COUNT> values;
+    
+    // Files changed since they were last handed to the writer, and the
+    // settings of every write the watcher may still report back, oldest
+    // first, to recognise our own writes
+    uint8_t dirtyFiles;
+    std::deque<std::unordered_map<std::string, std::string>> unconfirmedSettings;
+    std::unique_ptr<ConfigWriter> writer;
+    
 public:
+    // Files under the config directory, as dirty flags
+    enum File : uint8_t {
+        SettingsFile = 1,
+        AliasFile = 2,
+        FunctionFile = 4
+    };
+    
     ConfigManager();
     ~ConfigManager();
     
-    // Config file operations
+    // Config file operations; saveConfig writes every file before returning
     bool loadConfig();
     bool saveConfig();
     bool createDefaultConfig();
     
-    // Setting management
-    void setSetting(const std::string& key, const std::string& value);
+    // Changes are written behind: marking a file dirty is all a setter does,
+    // and persistChanges hands the dirty files to a background writer that
+    // coalesces them. Called between commands; cheap when nothing changed.
+    void markDirty(uint8_t files) { dirtyFiles |= files; }
+    void persistChanges();
+    
+    // True if the watcher is reporting one of our own writes, which may be
+    // older than the settings by now
+    bool isOwnWrite(const std::unordered_map<std::string, std::string>& fileSettings);
+    
+    // Parses the config file without applying it; safe on any thread
+    bool readConfigFile(std::unordered_map<std::string, std::string>& out) const;
+    void replaceSettings(std::unordered_map<std::string, std::string> newSettings);
+    
+    // Setting management; a value the schema rejects is not stored, and
+    // error says why
+    bool setSetting(const std::string& key, const std::string& value, std::string& error);
+    bool setSetting(const std::string& key, const std::string& value) {
+        std::string error;
+        return setSetting(key, value, error);
+    }
     std::string getSetting(const std::string& key, const std::string& defaultValue = "");
     bool hasSetting(const std::string& key);
     void removeSetting(const std::string& key);
     
+    // Typed values of known settings
+    bool getBool(ConfigSetting setting) const { return values[static_cast<size_t>(setting)].enabled; }
+    int getInt(ConfigSetting setting) const { return values[static_cast<size_t>(setting)].number; }
+    const std::string& getString(ConfigSetting setting) const { return values[static_cast<size_t>(setting)].text; }
+    
     // Specialized getters with type conversion
     int getIntSetting(const std::string& key, int defaultValue = 0);
     bool getBoolSetting(const std::string& key, bool defaultValue = false);
     std::vector<std::string> getListSetting(const std::string& key);
     
     // Managers
-    ThemeManager* getThemeManager() { return themeManager.get(); }
     AliasManager* getAliasManager() { return aliasManager.get(); }
-    
-    // Validation
-    bool validateSetting(const std::string& key, const std::string& value);
+    const std::unordered_map<std::string, std::string>& getAllSettings() const { return settings; }
     
     // Config paths
     std::string getConfigDir() const { return configDirPath; }
@@ -53,39 +95,10 @@ public:
 private:
     void initializePaths();
     void createConfigDirectory();
-    std::pair<std::string, std::string> parseLine(const std::string& line);
-    std::string expandPath(const std::string& path);
-};
-
-class ThemeManager {
-private:
-    ConfigManager* config;
-    std::unordered_map<std::string, std::unordered_map<std::string, std::string>> themes;
-    std::string currentTheme;
-    
-public:
-    explicit ThemeManager(ConfigManager* configManager);
-    
-    // Theme management
-    bool loadTheme(const std::string& themeName);
-    bool saveTheme(const std::string& themeName);
-    std::vector<std::string> getAvailableThemes();
-    void setCurrentTheme(const std::string& themeName);
-    std::string getCurrentTheme() const { return currentTheme; }
-    
-    // Color and formatting
-    std::string getColor(const std::string& element);
-    std::string getPromptFormat();
-    std::string formatPrompt(const std::string& user, const std::string& host, 
-                           const std::string& cwd, int exitCode = 0);
-    
-    // ANSI color codes
-    std::string colorize(const std::string& text, const std::string& color);
-    std::string resetColor();
-    
-private:
-    void loadDefaultThemes();
-    std::string getANSICode(const std::string& colorName);
+    std::pair<std::string, std::string> parseLine(const std::string& line) const;
+    std::string expandPath(const std::string& path) const;
+    void parseSettings();
+    std::string renderConfigFile() const;
 };
 
 class AliasManager {
@@ -102,45 +115,30 @@ public:
     void removeAlias(const std::string& name);
     bool hasAlias(const std::string& name);
     std::string getAlias(const std::string& name);
-    std::string expandAlias(const std::string& command);
+    std::string expandAlias(const std::string& command) const;
     std::vector<std::pair<std::string, std::string>> getAllAliases();
+    void replaceAliases(std::unordered_map<std::string, std::string> newAliases);
     
     // Function management
     void setFunction(const std::string& name, const std::string& body);
     void removeFunction(const std::string& name);
     bool hasFunction(const std::string& name);
     std::string getFunction(const std::string& name);
+    void replaceFunctions(std::unordered_map<std::string, std::string> newFunctions);
     
-    // File operations
+    // File operations; the render functions give the contents save writes
     bool loadAliases();
     bool saveAliases();
     bool loadFunctions();
     bool saveFunctions();
-    
-private:
-    std::string getAliasFilePath();
-    std::string getFunctionFilePath();
+    std::string renderAliasFile() const;
+    std::string renderFunctionFile() const;
+    std::string getAliasFilePath() const;
+    std::string getFunctionFilePath() const;
+    
+    // Parse the files without applying them; safe on any thread
+    bool readAliasFile(std::unordered_map<std::string, std::string>& out) const;
+    bool readFunctionFile(std::unordered_map<std::string, std::string>& out) const;
 };
 
-// Color constants
-namespace Colors {
-    extern const std::string RESET;
-    extern const std::string BLACK;
-    extern const std::string RED;
-    extern const std::string GREEN;
-    extern const std::string YELLOW;
-    extern const std::string BLUE;
-    extern const std::string MAGENTA;
-    extern const std::string CYAN;
-    extern const std::string WHITE;
-    extern const std::string BRIGHT_BLACK;
-    extern const std::string BRIGHT_RED;
-    extern const std::string BRIGHT_GREEN;
-    extern const std::string BRIGHT_YELLOW;
-    extern const std::string BRIGHT_BLUE;
-    extern const std::string BRIGHT_MAGENTA;
-    extern const std::string BRIGHT_CYAN;
-    extern const std::string BRIGHT_WHITE;
-}
-
 #endif // CONFIG_H
\ No newline at end of file
@@ -0,0 +1,86 @@
+#ifndef CONFIG_SCHEMA_H
+#define CONFIG_SCHEMA_H
+
+#include <string>
+#include <string_view>
+#include <ostream>
+#include <cstdint>
+
+/**
+ * Config Settings
+ * Every setting the shell itself reads. The value doubles as a handle into
+ * ConfigManager's parsed values, so reading a setting is one array index.
+ */
+enum class ConfigSetting : uint8_t {
+    Theme,
+    PromptFormat,
+    HistorySize,
+    AutoCd,
+    CaseSensitive,
+    TabCompletion,
+    SyntaxHighlighting,
+    Autosuggestions,
+    AutosuggestBudgetMs,
+    TrackDirectories,
+    AutoReload,
+    ColorOutput,
+    ShowWelcome,
+    WelcomeMessage,
+    ExitOnEof,
+    CommandTimeout,
+    PluginBudgetMs,
+    PluginAutoReload,
+
+    Count
+};
+
+/**
+ * Config Schema
+ * Type, default, range and a one-line description of each setting. Values
+ * are checked and parsed against it once, when they are loaded or set.
+ */
+namespace ConfigSchema {
+    const size_t COUNT = static_cast<size_t>(ConfigSetting::Count);
+
+    enum class Type : uint8_t {
+        Bool,
+        Int,
+        String
+    };
+
+    struct Spec {
+        const char* key;
+        Type type;
+        const char* defaultValue;
+        int minimum;  // Int only
+        int maximum;
+        const char* description;
+    };
+
+    // A setting's value, parsed for its type
+    struct Value {
+        std::string text;
+        int number = 0;
+        bool enabled = false;
+    };
+
+    const Spec& spec(ConfigSetting setting);
+    bool find(std::string_view key, ConfigSetting& setting);
+
+    // Parses text as the setting's type; on failure error says what was expected
+    bool parse(ConfigSetting setting, std::string_view text, Value& value, std::string& error);
+    Value defaultValue(ConfigSetting setting);
+
+    // Splits a config line into its trimmed key and value, unquoting the
+    // value; false if the line is not key=value
+    bool splitLine(const std::string& line, std::string& key, std::string& value);
+
+    // Checks a config file, reporting problems by line to out; returns the
+    // number of invalid values
+    int checkFile(const std::string& path, std::ostream& out);
+
+    // Prints every setting with its type, default and description
+    void describe(std::ostream& out);
+}
+
+#endif // CONFIG_SCHEMA_H
@@ -0,0 +1,66 @@
+#ifndef CONFIG_WATCHER_H
+#define CONFIG_WATCHER_H
+
+#include <string>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+class ConfigManager;
+class AliasManager;
+class ExternalThemeManager;
+
+/**
+ * Config Watcher
+ * Watches ~/.lynx and the theme directories with inotify. Changed files are
+ * parsed on a background thread into a snapshot that the shell takes and
+ * applies between prompts; changed themes are compiled into the theme cache
+ * so reselecting them parses nothing. Taking the snapshot is one atomic load
+ * when nothing changed.
+ */
+class ConfigWatcher {
+public:
+    struct Snapshot {
+        bool settingsChanged = false;
+        bool aliasesChanged = false;
+        bool functionsChanged = false;
+        bool themesChanged = false;
+        std::unordered_map<std::string, std::string> settings;
+        std::unordered_map<std::string, std::string> aliases;
+        std::unordered_map<std::string, std::string> functions;
+    };
+
+    // The managers must outlive the watcher
+    ConfigWatcher(const ConfigManager* config, const AliasManager* aliases, const ExternalThemeManager* themes);
+    ~ConfigWatcher();
+
+    ConfigWatcher(const ConfigWatcher&) = delete;
+    ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+
+    bool start();
+
+    // Everything that changed since the last call, or null
+    std::unique_ptr<Snapshot> takeChanges();
+
+private:
+    const ConfigManager* config;
+    const AliasManager* aliases;
+    const ExternalThemeManager* themes;
+    int inotifyFd;
+    int stopPipe[2];
+    int configWatch;
+    std::vector<int> themeWatches;
+    std::thread worker;
+
+    std::mutex mutex;
+    std::unique_ptr<Snapshot> pending;
+    std::atomic<bool> ready;
+
+    void run();
+    void reload(bool settings, bool aliases, bool functions, bool themeFiles);
+};
+
+#endif // CONFIG_WATCHER_H
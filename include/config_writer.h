@@ -0,0 +1,57 @@
+#ifndef CONFIG_WRITER_H
+#define CONFIG_WRITER_H
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+
+/**
+ * Config Writer
+ * Write-behind persistence for the files in ~/.lynx. Contents submitted for
+ * a path replace any not yet written, and a background thread writes the
+ * path once no newer contents have arrived for the coalescing window, or
+ * once the first unwritten contents are four windows old. Every
+ * write goes to a temp file that is fsynced and renamed over the original,
+ * so a crash leaves either the old file or the new one.
+ */
+class ConfigWriter {
+public:
+    explicit ConfigWriter(std::chrono::milliseconds window = std::chrono::milliseconds(250));
+    ~ConfigWriter();
+
+    ConfigWriter(const ConfigWriter&) = delete;
+    ConfigWriter& operator=(const ConfigWriter&) = delete;
+
+    void submit(const std::string& path, std::string contents);
+
+    // Writes everything still pending before returning
+    bool flush();
+
+    static bool writeAtomically(const std::string& path, const std::string& contents);
+
+private:
+    struct Pending {
+        std::string contents;
+        std::chrono::steady_clock::time_point first;  // Of the contents not yet written
+        std::chrono::steady_clock::time_point due;
+    };
+
+    std::chrono::milliseconds window;
+    std::chrono::milliseconds longest;  // A steady stream still gets written
+    std::map<std::string, Pending> pending;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+    std::thread worker;
+
+    // Held while taking and writing contents, so an older write can never
+    // land after a newer one for the same path
+    std::mutex writeMutex;
+
+    void run();
+};
+
+#endif // CONFIG_WRITER_H
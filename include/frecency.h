@@ -0,0 +1,77 @@
+#ifndef FRECENCY_H
+#define FRECENCY_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <sys/types.h>
+
+/**
+ * Frecency Database
+ * Directories visited with cd, ranked by visit frequency with exponential
+ * decay. Scores are kept as logarithms relative to a fixed epoch, so a visit
+ * only rewrites its own entry and ranking never needs the current time. The
+ * file is memory-mapped and shared between shells: visits update entries in
+ * place and new directories are appended under an flock().
+ */
+class FrecencyDatabase {
+public:
+    struct Match {
+        std::string path;
+        double score;  // decayed visit count as of now
+        int64_t lastVisit;
+    };
+
+    explicit FrecencyDatabase(const std::string& path);
+    ~FrecencyDatabase();
+
+    FrecencyDatabase(const FrecencyDatabase&) = delete;
+    FrecencyDatabase& operator=(const FrecencyDatabase&) = delete;
+
+    void recordVisit(const std::string& directory);
+    void recordVisit(const std::string& directory, int64_t timestamp);
+
+    // Best existing directory matching every term in order, the last one
+    // within the final path component. All-lowercase terms ignore case.
+    bool query(const std::vector<std::string>& terms, const std::string& exclude, std::string& result);
+
+    // Up to limit matches, highest score first
+    std::vector<Match> list(const std::vector<std::string>& terms, size_t limit);
+
+    size_t size() const { return order.size(); }
+
+private:
+    struct Header;
+    struct Entry;
+
+    std::string path;
+    int fd;
+    ino_t inode;
+    unsigned char* mapping;
+    size_t mappedBytes;
+
+    // Entries read so far, in bytes after the header, and the update count
+    // they reflect; another shell's writes show up as a change in either
+    uint32_t indexedBytes;
+    uint32_t seenUpdates;
+
+    // Offsets of entries, highest score first, and each path's offset
+    std::vector<uint32_t> order;
+    std::unordered_map<std::string_view, uint32_t> index;
+
+    bool open(bool allowReset = true);
+    void close();
+    bool refresh();
+    bool indexNewEntries();
+    void sortOrder();
+    bool appendEntry(const std::string& directory, double logScore, int64_t timestamp);
+    bool compact(int64_t now);
+
+    Header* header() const;
+    Entry* entryAt(uint32_t offset) const;
+    bool matches(const Entry& entry, const std::vector<std::string>& terms, bool ignoreCase) const;
+};
+
+#endif // FRECENCY_H
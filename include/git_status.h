@@ -0,0 +1,92 @@
+#ifndef GIT_STATUS_H
+#define GIT_STATUS_H
+
+#include <string>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Git Prompt Information
+ */
+struct GitInfo {
+    bool inRepository = false;
+    std::string branch;       // branch name, or abbreviated commit when detached
+    bool dirtyKnown = false;  // false until the background check finishes
+    bool dirty = false;
+};
+
+/**
+ * Git Status Provider
+ * Reads HEAD and the index straight from the .git directory, without running
+ * git. The branch is read on the calling thread (one small file); whether the
+ * work tree differs from the index is computed on a worker thread, and
+ * getNotifyFd() becomes readable when that changes what was last returned.
+ */
+class GitStatusProvider {
+public:
+    GitStatusProvider();
+    ~GitStatusProvider();
+
+    // Returns what is known now and schedules a dirty check. A clean answer
+    // for the same HEAD and index is trusted until writes, a count of
+    // commands that may have changed files, moves on.
+    GitInfo query(const std::string& directory, uint64_t writes);
+
+    // Latest state for the repository of the last query, without rescheduling
+    GitInfo current();
+
+    // Non-blocking; the reader drains it
+    int getNotifyFd() const { return notifyPipe[0]; }
+
+private:
+    struct Repository {
+        std::string gitDir;    // empty when the directory is not in a work tree
+        std::string workTree;
+    };
+
+    struct RepositoryState {
+        int64_t headMtimeNs = -1;
+        int64_t indexMtimeNs = -1;
+        int64_t indexSize = -1;
+        std::string branch;
+        bool dirtyKnown = false;
+        bool dirty = false;
+        uint64_t checkedWrites = 0;  // The writes count the answer was checked for
+    };
+
+    struct Job {
+        std::string gitDir;
+        std::string workTree;
+        int64_t indexMtimeNs = -1;
+        int64_t indexSize = -1;
+        uint64_t writes = 0;
+    };
+
+    // Main thread only
+    std::unordered_map<std::string, Repository> repositories;
+
+    // Shared with the worker
+    std::mutex mutex;
+    std::string currentGitDir;
+    std::condition_variable wakeup;
+    std::unordered_map<std::string, RepositoryState> states;
+    GitInfo shown;
+    Job pendingJob;
+    bool jobQueued;
+    std::atomic<bool> stopRequested;  // Also abandons a scan in progress
+    std::thread worker;
+    int notifyPipe[2];
+
+    const Repository& findRepository(const std::string& directory);
+    void workerLoop();
+
+    static std::string readBranch(const std::string& gitDir);
+    static bool isWorkTreeDirty(const std::string& gitDir, const std::string& workTree, int64_t indexMtimeNs,
+                                const std::atomic<bool>& stop);
+};
+
+#endif // GIT_STATUS_H
@@ -0,0 +1,50 @@
+#ifndef HIGHLIGHTER_H
+#define HIGHLIGHTER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "line_editor.h"
+
+class CompletionEngine;
+
+/**
+ * Syntax Highlighter
+ * Assigns an EditorStyle to every byte of the input line. Lexer state is
+ * checkpointed at each token start, so an edit is relexed from the token
+ * before it and lexing stops as soon as it rejoins the old token stream.
+ */
+class SyntaxHighlighter {
+public:
+    explicit SyntaxHighlighter(CompletionEngine* completion);
+
+    void update(const std::string& line);
+    const std::vector<uint8_t>& getStyles() const { return styles; }
+
+    // Forget cached command lookups, e.g. after plugins change
+    void invalidate();
+
+private:
+    struct Checkpoint {
+        uint32_t position;
+        bool commandPosition;
+    };
+
+    CompletionEngine* completion;
+    std::string text;
+    std::vector<uint8_t> styles;
+    std::vector<Checkpoint> checkpoints;
+
+    // Previous state, kept to splice in the unchanged tail
+    std::vector<uint8_t> previousStyles;
+    std::vector<Checkpoint> previousCheckpoints;
+
+    std::unordered_map<std::string, uint8_t> commandStyles;
+    uint64_t commandGeneration;
+
+    size_t lexToken(const std::string& line, size_t pos, bool& commandPosition);
+    uint8_t commandStyle(const std::string& name);
+};
+
+#endif // HIGHLIGHTER_H
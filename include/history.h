@@ -0,0 +1,136 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * History Store
+ * Keeps command history as interned, reference-counted strings so that
+ * repeated and near-duplicate commands share storage. Persists to a compact
+ * binary file using front coding with a block index. Unique commands are
+ * also kept in byte order so prefix lookups are a binary search.
+ */
+class HistoryStore {
+public:
+    HistoryStore();
+
+    // Recording
+    void add(const std::string& command);
+    void add(const std::string& command, int64_t timestamp);
+    void add(const std::string& command, const std::string& directory);
+    void add(const std::string& command, int64_t timestamp, const std::string& directory);
+    void clear();
+    void setMaxEntries(size_t max);
+    size_t getMaxEntries() const { return maxEntries; }
+
+    // Access (index 0 is the oldest entry)
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    const std::string& operator[](size_t index) const;
+    int64_t timestampAt(size_t index) const;
+    size_t uniqueCount() const { return index.size(); }
+    size_t memoryUsage() const;
+
+    // Unique commands in byte order; position is only valid until the next
+    // change, which bumps the generation
+    struct Match {
+        const std::string* text;
+        uint64_t recency;      // larger is more recent
+        uint32_t directoryId;  // directory the command last ran in, 0 if unknown
+    };
+    size_t lowerBound(std::string_view prefix) const;
+    size_t sortedCount() const { return sortedIds.size(); }
+    Match sortedAt(size_t position) const;
+    uint32_t findDirectory(const std::string& directory) const;
+    uint64_t getGeneration() const { return generation; }
+
+    // Flat copy for callers that still expect std::vector<std::string>
+    const std::vector<std::string>& asVector() const;
+
+    // Persistence
+    bool load(const std::string& path);
+    bool save(const std::string& path) const;
+    bool exportText(const std::string& path) const;
+
+private:
+    // Eight bytes per entry; unsigned seconds cover dates up to 2106
+    struct Entry {
+        uint32_t textId;
+        uint32_t timestamp;
+    };
+
+    struct InternedString {
+        std::string text;
+        uint32_t refCount;
+        uint32_t directoryId;
+        uint64_t recency;
+    };
+
+    // Deque keeps element addresses stable, so the index can key on views
+    std::deque<InternedString> strings;
+    std::vector<uint32_t> freeIds;
+    std::unordered_map<std::string_view, uint32_t> index;
+    std::deque<Entry> entries;
+    std::vector<uint32_t> sortedIds;
+    size_t maxEntries;
+    uint64_t recencyCounter;
+    uint64_t generation;
+
+    // Directory 0 is the empty "unknown" directory
+    std::vector<std::string> directories;
+    std::unordered_map<std::string, uint32_t> directoryIndex;
+
+    mutable std::vector<std::string> flatView;
+    mutable bool flatViewDirty;
+
+    uint32_t intern(const std::string& text, uint32_t directoryId);
+    uint32_t internDirectory(const std::string& directory);
+    void release(uint32_t id);
+    void trimToLimit();
+};
+
+/**
+ * History Suggester
+ * Finds the best history entry extending the typed prefix, preferring
+ * commands last run in the current directory, then the most recent. A search
+ * that runs past its time budget stops and can be resumed later.
+ */
+class HistorySuggester {
+public:
+    explicit HistorySuggester(const HistoryStore& history);
+
+    void setBudget(std::chrono::microseconds limit) { budget = limit; }
+    void setDirectory(const std::string& directory);
+
+    // Both return true once the search for the prefix has finished
+    bool begin(const std::string& prefix);
+    bool resume();
+    bool isPending() const { return pending; }
+
+    // Full text of the best match, or empty
+    const std::string& getSuggestion() const { return suggestion; }
+
+private:
+    const HistoryStore& history;
+    std::chrono::microseconds budget;
+    std::string directory;
+    uint32_t directoryId;
+
+    std::string prefix;
+    std::string suggestion;
+    bool pending;
+    uint64_t generation;
+    size_t position;
+    bool bestInDirectory;
+    uint64_t bestRecency;
+
+    bool scan();
+};
+
+#endif // HISTORY_H
@@ -0,0 +1,82 @@
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * JSON Reader
+ * Pull parser over an in-memory buffer. Each call to next() validates and
+ * returns one token; keys and strings without escapes are views into the
+ * buffer, others are decoded into a reused scratch string. Nothing is built
+ * up, so the caller keeps only what it wants.
+ */
+class JsonReader {
+public:
+    enum class Token : uint8_t {
+        BeginObject,
+        EndObject,
+        BeginArray,
+        EndArray,
+        Key,
+        String,
+        Number,
+        True,
+        False,
+        Null,
+        End,
+        Error
+    };
+
+    JsonReader(const char* data, size_t size);
+
+    Token next();
+
+    // Text of the last Key, String or Number token; valid until next()
+    std::string_view text() const { return value; }
+
+    // Skip the rest of a value whose first token was just returned
+    bool skip(Token token);
+
+    bool failed() const { return !error.empty(); }
+    const std::string& errorMessage() const { return error; }
+    size_t errorLine() const { return line; }
+    size_t errorColumn() const { return column; }
+
+private:
+    enum class Expect : uint8_t {
+        Value,
+        KeyOrEnd,
+        Key,
+        ValueOrEnd,
+        CommaOrEnd,
+        Done
+    };
+
+    const char* begin;
+    const char* cursor;
+    const char* end;
+    Expect expect;
+    std::vector<bool> nesting;  // true for objects
+    std::string_view value;
+    std::string scratch;
+
+    std::string error;
+    size_t line;
+    size_t column;
+
+    Token readValue();
+    Token readKey();
+    Token closeContainer(bool object);
+    bool readString();
+    bool readNumber();
+    bool readLiteral(std::string_view literal);
+    void afterValue();
+    void skipWhitespace();
+    Token fail(const char* position, const std::string& message);
+};
+
+#endif // JSON_READER_H
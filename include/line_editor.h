@@ -0,0 +1,201 @@
+#ifndef LINE_EDITOR_H
+#define LINE_EDITOR_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <termios.h>
+#include "completion.h"
+
+class HistoryStore;
+class HistorySuggester;
+class SyntaxHighlighter;
+
+/**
+ * Editor Key Codes
+ */
+enum class EditorKey {
+    None,
+    Char,
+    Enter,
+    Tab,
+    Backspace,
+    Delete,
+    Left,
+    Right,
+    Up,
+    Down,
+    Home,
+    End,
+    WordLeft,
+    WordRight,
+    DeleteWordLeft,
+    KillToEnd,
+    KillToStart,
+    ClearScreen,
+    Interrupt,
+    EndOfFile,
+    Escape
+};
+
+/**
+ * Editor Styles
+ * Indices into the line editor's style palette
+ */
+enum class EditorStyle : uint8_t {
+    Plain = 0,
+    Suggestion,
+    Builtin,
+    PluginCommand,
+    Command,
+    UnknownCommand,
+    String,
+    Number,
+    Comment,
+    Operator,
+    Count
+};
+
+struct KeyEvent {
+    EditorKey key = EditorKey::None;
+    std::string text;  // UTF-8 bytes for EditorKey::Char
+};
+
+/**
+ * Key Trie
+ * Maps control bytes and terminal escape sequences to editor keys
+ */
+class KeyTrie {
+public:
+    KeyTrie();
+
+    void add(const std::string& sequence, EditorKey key);
+
+    // Decodes one key starting at input[pos]. Returns the number of bytes
+    // consumed, or 0 when the bytes so far are an unfinished prefix and more
+    // input may still arrive (pass final=true once the timeout has expired).
+    size_t decode(const std::string& input, size_t pos, bool final, KeyEvent& event) const;
+
+private:
+    struct Node {
+        std::vector<std::pair<unsigned char, uint32_t>> children;
+        EditorKey key = EditorKey::None;
+    };
+
+    std::vector<Node> nodes;
+
+    int findChild(uint32_t node, unsigned char byte) const;
+};
+
+/**
+ * Line Editor
+ * Reads a line in termios raw mode. The previously drawn line is kept as a
+ * cell array and every refresh diffs it against the new state, emitting only
+ * the cursor moves and characters that changed in a single write().
+ */
+class LineEditor {
+public:
+    using CompletionCallback = std::function<CompletionResult(const std::string& line, size_t cursor)>;
+    using PromptCallback = std::function<bool(std::string& prompt)>;
+
+    struct Cell {
+        char32_t ch;
+        uint8_t style;
+
+        bool operator==(const Cell& other) const { return ch == other.ch && style == other.style; }
+        bool operator!=(const Cell& other) const { return !(*this == other); }
+    };
+
+    explicit LineEditor(int inputFd = 0, int outputFd = 1);
+    ~LineEditor();
+
+    // Returns false on end of input. The prompt must already be on screen.
+    bool readLine(const std::string& prompt, std::string& line);
+
+    bool isInteractive() const { return interactive; }
+    void setHistory(const HistoryStore* historyStore) { history = historyStore; }
+    void setSuggester(HistorySuggester* historySuggester) { suggester = historySuggester; }
+    void setHighlighter(SyntaxHighlighter* syntaxHighlighter) { highlighter = syntaxHighlighter; }
+    void setCompletionCallback(CompletionCallback callback) { completionCallback = std::move(callback); }
+
+    // When fd becomes readable while editing, the callback may return a new
+    // prompt, which is redrawn in place of the old one
+    void setPromptSource(int fd, PromptCallback callback) {
+        promptFd = fd;
+        promptCallback = std::move(callback);
+    }
+
+    // Escape sequences indexed by EditorStyle; style 0 is plain text
+    void setStylePalette(const std::vector<std::string>& palette) { styles = palette; }
+
+private:
+    int inputFd;
+    int outputFd;
+    bool interactive;
+    bool rawMode;
+    struct termios originalTermios;
+
+    KeyTrie keyTrie;
+    std::string pending;  // bytes read but not yet decoded
+    bool inputClosed;
+    const HistoryStore* history;
+    HistorySuggester* suggester;
+    SyntaxHighlighter* highlighter;
+    CompletionCallback completionCallback;
+    std::vector<std::string> styles;
+    int promptFd;
+    PromptCallback promptCallback;
+    bool promptUpdate;
+
+    // Editing state
+    std::string prompt;
+    std::string buffer;
+    size_t cursor;
+    size_t historyIndex;
+    std::string savedLine;
+    EditorKey lastKey;
+    bool interrupted;
+
+    // Full text of the suggestion on screen, and the line it was computed for
+    std::string suggestion;
+    std::string suggestedFor;
+    bool suggestionPending;
+
+    // Screen state from the last refresh, relative to the prompt row
+    std::vector<Cell> drawnCells;
+    std::vector<Cell> nextCells;
+    size_t promptColumns;
+    size_t terminalColumns;
+    size_t cursorRow;
+    size_t cursorColumn;
+    std::string output;
+
+    bool enableRawMode();
+    void disableRawMode();
+    bool readPending(int timeoutMs);
+    size_t queryTerminalColumns() const;
+
+    void handleKey(const KeyEvent& event, bool& done, bool& accepted);
+    void moveWordLeft();
+    void moveWordRight();
+    void recallHistory(bool older);
+    void completeWord();
+    void updateSuggestion();
+    bool hasSuggestion() const;
+    void acceptSuggestion(bool wholeLine);
+    void listCandidates(const std::vector<std::string>& candidates);
+
+    void renderCells(std::vector<Cell>& cells, size_t& cursorCell) const;
+    void refresh();
+    void redrawAll(bool clearScreen);
+    void replacePrompt(const std::string& newPrompt);
+    void writePrompt();
+    void moveTo(size_t row, size_t column);
+    void writeCells(const std::vector<Cell>& cells, size_t from, size_t to);
+    void flush();
+
+    static size_t visibleWidth(const std::string& text);
+};
+
+#endif // LINE_EDITOR_H
@@ -0,0 +1,34 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Mapped File
+ * Read-only mmap of a whole file. Empty files open successfully with a null
+ * data pointer and size 0.
+ */
+class MappedFile {
+public:
+    MappedFile() : data_(nullptr), size_(0), mtimeNs(0) {}
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    int64_t modificationTimeNs() const { return mtimeNs; }
+
+private:
+    const char* data_;
+    size_t size_;
+    int64_t mtimeNs;
+};
+
+#endif // MAPPED_FILE_H
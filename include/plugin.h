@@ -6,10 +6,17 @@
 #include <map>
 #include <memory>
 #include <functional>
+#include <string_view>
+#include <set>
+#include <mutex>
+#include <cstdint>
 
 // Forward declarations
 class Shell;
 struct Command;
+class PluginEventBus;
+struct PluginEventQueue;
+struct PluginStats;
 
 /**
  * Plugin Event Types
@@ -20,7 +27,45 @@ enum class PluginEvent {
     COMMAND_BEFORE,
     COMMAND_AFTER,
     PROMPT_DISPLAY,
-    INPUT_RECEIVED
+    INPUT_RECEIVED,
+    COUNT  // Number of events, not an event
+};
+
+/**
+ * Plugin Event Mask
+ * One bit per PluginEvent, for declaring which events a plugin handles
+ */
+using PluginEventMask = uint32_t;
+
+constexpr PluginEventMask pluginEventBit(PluginEvent event) {
+    return PluginEventMask(1) << static_cast<unsigned>(event);
+}
+
+constexpr PluginEventMask ALL_PLUGIN_EVENTS = pluginEventBit(PluginEvent::COUNT) - 1;
+
+// Not an event: deliver this plugin's events on a worker thread instead of
+// the shell thread. Such handlers cannot affect the command and must not
+// call back into the shell.
+constexpr PluginEventMask PLUGIN_EVENTS_ASYNC = PluginEventMask(1) << 31;
+
+/**
+ * Plugin Event Data
+ * Built on the stack for each dispatch. The views point into the shell's own
+ * strings and are only valid for the duration of the handler; copy anything
+ * that has to outlive it. Fields that do not apply to an event are empty.
+ */
+struct PluginEventData {
+    PluginEvent type;
+    std::string_view directory;      // PROMPT_DISPLAY
+    std::string_view input;          // INPUT_RECEIVED
+    std::string_view command;        // COMMAND_BEFORE, COMMAND_AFTER
+    const std::vector<std::string>* args = nullptr;  // COMMAND_BEFORE
+    std::string_view pluginName;     // SHELL_STARTUP, when a plugin was just loaded
+    std::string_view pluginVersion;  // SHELL_STARTUP, when a plugin was just loaded
+    int exitCode = 0;                // COMMAND_AFTER, PROMPT_DISPLAY
+    bool success = false;            // COMMAND_AFTER
+
+    explicit PluginEventData(PluginEvent type) : type(type) {}
 };
 
 /**
@@ -48,7 +93,7 @@ public:
     virtual void shutdown() = 0;
     virtual const PluginInfo& getInfo() const = 0;
     
-    // Event handling
+    // Event handling (legacy string map form, still delivered by default)
     virtual void onEvent(PluginEvent event, const std::map<std::string, std::string>& context) {
         (void)event; (void)context; // Suppress unused parameter warnings
     }
@@ -63,6 +108,40 @@ public:
     virtual void configure(const std::map<std::string, std::string>& config) {
         (void)config; // Suppress unused parameter warnings
     }
+    
+    // Events to deliver, optionally with PLUGIN_EVENTS_ASYNC; read once when
+    // the plugin is loaded
+    virtual PluginEventMask subscribedEvents() const {
+        return ALL_PLUGIN_EVENTS;
+    }
+    
+    // Typed event handling; override this instead of onEvent() to skip the
+    // string map. Returning false hands the event on to onEvent().
+    virtual bool handleEvent(const PluginEventData& event) {
+        (void)event; // Suppress unused parameter warnings
+        return false;
+    }
+};
+
+/**
+ * Plugin Manifest
+ * Sidecar file next to a plugin library (libfoo.so -> libfoo.manifest) that
+ * describes the plugin well enough to leave it unloaded until one of its
+ * commands runs or one of its events fires. Lines are key = value:
+ * name, version, author, description, commands, events and lazy.
+ */
+struct PluginManifest {
+    std::string libraryPath;
+    std::string name;
+    std::string version;
+    std::string author;
+    std::string description;
+    std::vector<std::string> commands;
+    PluginEventMask events = 0;
+    bool lazy = true;
+    
+    static std::string pathFor(const std::string& libraryPath);
+    static bool read(const std::string& path, PluginManifest& manifest, std::string& error);
 };
 
 /**
@@ -84,6 +163,109 @@ private:
     std::map<std::string, std::unique_ptr<IPlugin>> loadedPlugins;
     std::map<std::string, PluginCommand> pluginCommands;
     std::vector<std::string> pluginPaths;
+    
+    // What each plugin asked for when it was loaded
+    struct Subscription {
+        PluginEventMask mask;
+        bool legacy;  // Built against API 1.0.0, which predates handleEvent()
+        PluginEventQueue* queue;  // Async plugins only
+        PluginStats* stats;
+    };
+    std::map<std::string, Subscription> subscriptions;
+    
+    // Plugins to deliver each event to, rebuilt when plugins come and go
+    struct Subscriber {
+        IPlugin* plugin;
+        const std::string* name;
+        bool legacy;
+        PluginEventQueue* queue;
+        PluginStats* stats;
+        uint64_t calls;  // Since the last rebuild
+    };
+    std::vector<Subscriber> subscribers[static_cast<size_t>(PluginEvent::COUNT)];
+    PluginEventMask subscribedMask = 0;
+    
+    // Started with the first async plugin
+    std::unique_ptr<PluginEventBus> eventBus;
+    
+    // Plugins known from their manifests, loaded on first use
+    std::map<std::string, PluginManifest> deferredPlugins;
+    std::map<std::string, std::string> deferredCommands;  // command -> plugin
+    PluginEventMask deferredMask = 0;
+    
+    std::map<std::string, std::string> commandOwners;  // command -> plugin
+    
+    // Guards the plugin and command tables while loader threads run
+    mutable std::mutex registryMutex;
+    std::set<std::string> initializingPlugins;  // Register commands before they are stored
+    
+    // A library that is open with its plugin created, not yet initialized
+    struct OpenedPlugin {
+        std::string path;
+        void* handle = nullptr;
+        void (*destroy)(IPlugin*) = nullptr;  // The library's destroyPlugin(), if it has one
+        std::unique_ptr<IPlugin> plugin;
+        bool legacy = false;
+        int64_t modifiedNs = 0;  // The build that was opened
+        std::string error;
+        int64_t startNs = 0;
+        int64_t openedNs = 0;
+        int64_t initializeStartNs = 0;
+        int64_t initializeEndNs = 0;
+    };
+    
+    // How long each plugin took to come up
+    struct LoadTime {
+        double dlopenMs;
+        double initializeMs;
+    };
+    std::map<std::string, LoadTime> loadTimes;
+    
+    // The library each plugin came from. Entries stay after the plugin is
+    // unloaded, so it can be reloaded by name.
+    struct PluginLibrary {
+        std::string path;
+        void* handle = nullptr;  // Null while unloaded
+        void (*destroy)(IPlugin*) = nullptr;
+        int64_t modifiedNs = 0;  // The build last loaded, or last tried
+        bool watched = true;     // Reload automatically; off once unloaded on purpose
+    };
+    std::map<std::string, PluginLibrary> libraries;
+    
+    // Unloaded plugins and their libraries, closed once no handler is running
+    struct RetiredPlugin {
+        std::unique_ptr<IPlugin> plugin;
+        void* handle = nullptr;  // Null for an in-process plugin
+        void (*destroy)(IPlugin*) = nullptr;
+    };
+    std::vector<RetiredPlugin> retiredPlugins;
+    
+    // Handler latencies, kept for the session so they survive a reload and
+    // a handler that unloads its own plugin
+    std::map<std::string, std::unique_ptr<PluginStats>> pluginStats;
+    int64_t eventBudgetNs = 0;  // 0 turns the warning off
+    uint32_t untilSample[static_cast<size_t>(PluginEvent::COUNT)] = {};  // Broadcasts until handlers are timed
+    
+    void checkBudget(const std::string& pluginName, PluginStats& stats, PluginEvent event, int64_t ns);
+    
+    bool openPlugin(const std::string& pluginPath, bool announce, bool privateCopy = false);
+    static bool openLibrary(const std::string& pluginPath, OpenedPlugin& opened, bool privateCopy = false);
+    static void discardLibrary(OpenedPlugin& opened);
+    void trackLibrary(const std::string& pluginName, const OpenedPlugin& opened);
+    bool startPlugin(std::unique_ptr<IPlugin>& plugin, bool legacy, const std::string& pluginPath,
+                     bool announce, double dlopenMs);
+    bool resolveDependencies(const PluginInfo& info);
+    bool initializePlugin(IPlugin& plugin, const std::string& source);
+    void activatePlugin(std::unique_ptr<IPlugin> plugin, bool legacy);
+    void announcePlugin(const std::string& pluginName, bool announce);
+    void loadInParallel(const std::vector<std::string>& pluginPaths);
+    void rebuildSubscribers();
+    bool deferPlugin(const PluginManifest& manifest);
+    bool loadDeferred(const std::string& pluginName);
+    void loadDeferredFor(PluginEvent event);
+    void removeCommandsOf(const std::string& pluginName);
+    void removePlugin(const std::string& pluginName);
+    void closePlugin(const std::string& pluginName, std::unique_ptr<IPlugin> plugin);
 
 public:
     explicit PluginManager(Shell* shell);
@@ -91,9 +273,13 @@ public:
     
     // Plugin lifecycle
     bool loadPlugin(const std::string& pluginPath);
+    bool addPlugin(std::unique_ptr<IPlugin> plugin);  // In-process, already constructed
     bool unloadPlugin(const std::string& pluginName);
+    bool reloadPlugin(const std::string& pluginName);  // Picks up a new build of its library
+    void reloadChangedPlugins();  // Reloads those whose library changed on disk
     void loadAllPlugins();
     void unloadAllPlugins();
+    void closeRetiredPlugins();  // Call when no plugin handler is running
     
     // Plugin discovery
     void addPluginPath(const std::string& path);
@@ -109,9 +295,23 @@ public:
     bool unregisterCommand(const std::string& commandName);
     bool executePluginCommand(const Command& cmd);
     bool isPluginCommand(const std::string& commandName) const;
+    std::vector<std::string> getCommandNames() const;
     
-    // Event system
-    void broadcastEvent(PluginEvent event, const std::map<std::string, std::string>& context = {});
+    // Event system; check hasSubscribers() before building an event
+    bool hasSubscribers(PluginEvent event) const {
+        return ((subscribedMask | deferredMask) & pluginEventBit(event)) != 0;
+    }
+    void broadcastEvent(const PluginEventData& event);
+    void broadcastEvent(PluginEvent event) { broadcastEvent(PluginEventData(event)); }
+    
+    // The string map that onEvent() handlers have always received
+    static std::map<std::string, std::string> legacyContext(const PluginEventData& event);
+    static const char* eventName(PluginEvent event);
+    
+    // Profiling; a synchronous event handler slower than the budget gets a
+    // warning the first time
+    void setEventBudget(int milliseconds);
+    bool printStats(const std::string& pluginName = "") const;
     
     // Plugin information
     std::vector<PluginInfo> getPluginInfos() const;
@@ -152,6 +352,10 @@ public:
     std::vector<std::string> listDirectory(const std::string& path) const;
 };
 
+// Plugin API version; plugins built against 1.0.0 still load and get onEvent()
+#define LYNX_PLUGIN_API_VERSION "1.1.0"
+#define LYNX_PLUGIN_API_VERSION_LEGACY "1.0.0"
+
 // Plugin entry point macros
 #define LYNX_PLUGIN_ENTRY_POINT(PluginClass) \
     extern "C" { \
@@ -162,10 +366,8 @@ public:
             delete plugin; \
         } \
         const char* getPluginApiVersion() { \
-            return "1.0.0"; \
+            return LYNX_PLUGIN_API_VERSION; \
         } \
     }
 
-#define LYNX_PLUGIN_API_VERSION "1.0.0"
-
 #endif // PLUGIN_H
\ No newline at end of file
@@ -0,0 +1,107 @@
+#ifndef PLUGIN_EVENT_BUS_H
+#define PLUGIN_EVENT_BUS_H
+
+#include "plugin.h"
+#include "plugin_stats.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * Plugin Event Queue
+ * Bounded single-producer ring of events for one async plugin. The shell
+ * thread is the only producer, and the bus hands the queue to at most one
+ * worker at a time, so the ring itself needs no lock. Slots keep their
+ * strings between uses, so steady-state posting does not allocate.
+ */
+struct PluginEventQueue {
+    // An event whose strings the queue owns, since the shell's are gone by
+    // the time a worker gets to it
+    struct Event {
+        PluginEvent type = PluginEvent::COUNT;
+        std::string directory;
+        std::string input;
+        std::string command;
+        std::vector<std::string> args;
+        bool hasArgs = false;
+        std::string pluginName;
+        std::string pluginVersion;
+        int exitCode = 0;
+        bool success = false;
+
+        void assign(const PluginEventData& event);
+        PluginEventData view() const;
+    };
+
+    IPlugin* plugin;
+    std::string name;
+    PluginStats* stats;  // Handler latencies, recorded by the worker
+    std::vector<Event> slots;
+    size_t mask;
+    std::atomic<size_t> head{0};  // Next slot to deliver, advanced by the worker
+    std::atomic<size_t> tail{0};  // Next slot to fill, advanced by the shell
+
+    // The latest PROMPT_DISPLAY that did not fit; a newer one replaces it
+    std::mutex overflowMutex;
+    Event overflow;
+    std::atomic<bool> hasOverflow{false};
+
+    std::atomic<bool> scheduled{false};  // Queued for or held by a worker
+    std::atomic<bool> closed{false};
+    std::atomic<uint64_t> dropped{0};
+
+    PluginEventQueue(IPlugin* plugin, const std::string& name, PluginStats* stats, size_t capacity);
+};
+
+/**
+ * Plugin Event Bus
+ * Delivers events to plugins that subscribe with PLUGIN_EVENTS_ASYNC on a
+ * small worker pool, so a slow handler never holds up the prompt. When a
+ * plugin falls a full queue behind, a new PROMPT_DISPLAY replaces the last
+ * one that did not fit and other events are dropped and counted.
+ */
+class PluginEventBus {
+public:
+    explicit PluginEventBus(size_t workers, size_t capacity = 64);
+    ~PluginEventBus();
+
+    PluginEventBus(const PluginEventBus&) = delete;
+    PluginEventBus& operator=(const PluginEventBus&) = delete;
+
+    PluginEventQueue* attach(IPlugin* plugin, const std::string& name, PluginStats* stats);
+
+    // Waits for a handler that is running, then drops whatever is left
+    void detach(PluginEventQueue* queue);
+
+    // Shell thread only; copies the event and returns without waiting
+    void post(PluginEventQueue* queue, const PluginEventData& event);
+
+    // Waits until every queue is empty, or the timeout passes
+    bool drain(std::chrono::milliseconds timeout);
+
+private:
+    size_t capacity;
+    std::list<std::unique_ptr<PluginEventQueue>> queues;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::deque<PluginEventQueue*> ready;
+    bool stopping;
+    std::vector<std::thread> workers;
+
+    void schedule(PluginEventQueue* queue);
+    void run();
+    void deliverAll(PluginEventQueue* queue);
+    static void deliver(PluginEventQueue* queue, const PluginEventQueue::Event& event);
+};
+
+#endif // PLUGIN_EVENT_BUS_H
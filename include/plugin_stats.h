@@ -0,0 +1,55 @@
+#ifndef PLUGIN_STATS_H
+#define PLUGIN_STATS_H
+
+#include "plugin.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Latency Histogram
+ * HDR-style log-linear buckets over nanoseconds: each power of two is split
+ * into 16 linear steps, so a recorded value is within 1/16 of the truth and
+ * everything up to about 36 minutes fits in a fixed 2.4 KB. Counters are
+ * atomics so the shell can read them while a worker records; there is only
+ * ever one writer, so recording is plain loads and stores.
+ */
+class LatencyHistogram {
+public:
+    void record(int64_t ns);
+
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    int64_t meanNs() const;
+    int64_t maxNs() const { return largest.load(std::memory_order_relaxed); }
+
+    // The value below which the given fraction (0.5, 0.99) of calls fell
+    int64_t percentileNs(double fraction) const;
+
+private:
+    static const int SUB_BUCKET_BITS = 4;
+    static const int MAX_EXPONENT = 40;  // Longer calls count as 2^41 ns
+    static const size_t BUCKETS = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) << SUB_BUCKET_BITS;
+
+    std::atomic<uint32_t> buckets[BUCKETS] = {};
+    std::atomic<uint64_t> total{0};
+    std::atomic<int64_t> sumNs{0};
+    std::atomic<int64_t> largest{0};
+
+    static size_t bucketFor(int64_t ns);
+    static int64_t highestIn(size_t bucket);
+};
+
+/**
+ * Plugin Stats
+ * Time spent in one plugin's handlers, per event and for its commands
+ */
+struct PluginStats {
+    static const size_t COMMANDS = static_cast<size_t>(PluginEvent::COUNT);
+
+    LatencyHistogram latency[COMMANDS + 1];  // Indexed by PluginEvent, then COMMANDS
+    std::atomic<uint64_t> overBudget[COMMANDS + 1] = {};
+    uint64_t calls[COMMANDS + 1] = {};  // Every call, timed or not; shell thread only
+    bool warned[COMMANDS] = {};         // Shell thread only
+};
+
+#endif // PLUGIN_STATS_H
@@ -4,21 +4,44 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include "history.h"
+#include "working_directory.h"
 
 // Forward declarations
 class ConfigManager;
 class PluginManager;
 class ExternalThemeManager;
+class LineEditor;
+class CompletionEngine;
+class SyntaxHighlighter;
+class GitStatusProvider;
+class FrecencyDatabase;
+class ConfigWatcher;
 
 class Shell {
 private:
-    std::vector<std::string> history;
+    HistoryStore history;
     bool running;
-    std::string currentDirectory;
+    WorkingDirectory workingDirectory;
     int lastExitCode;
     std::unique_ptr<ConfigManager> configManager;
     std::unique_ptr<PluginManager> pluginManager;
     std::unique_ptr<ExternalThemeManager> themeManager;
+    std::unique_ptr<HistorySuggester> historySuggester;
+    std::unique_ptr<LineEditor> lineEditor;
+    std::unique_ptr<CompletionEngine> completionEngine;
+    std::unique_ptr<SyntaxHighlighter> syntaxHighlighter;
+    std::unique_ptr<GitStatusProvider> gitStatus;
+    uint64_t workTreeWrites;  // Commands that may have written files; rechecks the git segment
+    std::unique_ptr<FrecencyDatabase> directoryDatabase;
+    std::string promptText;
+    std::string promptDirectory;
+    
+    // Declared last so it stops before the managers it reads from go away
+    std::unique_ptr<ConfigWatcher> configWatcher;
+    
+    void applyThemePalette();
+    void applyConfigChanges();
 
 public:
     Shell();
@@ -35,11 +58,20 @@ public:
     
     // Configuration access
     ConfigManager* getConfigManager() { return configManager.get(); }
+    
+    // Brings theme, colors and history size in line with the settings
+    void applySettings(bool themesChanged = false);
     void setLastExitCode(int code) { lastExitCode = code; }
     int getLastExitCode() const { return lastExitCode; }
     
+    // Logical current directory, updated by cd/pushd/popd
+    WorkingDirectory& getWorkingDirectory() { return workingDirectory; }
+    const std::string& getCurrentDirectory() const { return workingDirectory.get(); }
+    FrecencyDatabase* getDirectoryDatabase() { return directoryDatabase.get(); }
+    
     // History access
-    const std::vector<std::string>& getHistory() const { return history; }
+    const HistoryStore& getHistory() const { return history; }
+    std::string getHistoryFilePath() const;
     
     // Plugin system access
     PluginManager* getPluginManager() { return pluginManager.get(); }
@@ -0,0 +1,79 @@
+#ifndef STARTUP_PROFILER_H
+#define STARTUP_PROFILER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Startup Profiler
+ * Times the phases of startup as nested scopes on the monotonic clock, up
+ * to the first prompt, then prints a table or writes JSON. It is off unless
+ * lynx is started with --profile-startup, and a scope then costs a single
+ * branch, so the instrumentation stays compiled in.
+ */
+class StartupProfiler {
+public:
+    // Read by every scope; only main turns it on
+    inline static bool active = false;
+
+    static StartupProfiler& instance();
+
+    // An empty path prints a table to stderr instead of writing JSON
+    void start(const std::string& jsonPath);
+
+    size_t begin(std::string_view name, std::string_view detail);
+    void end(size_t phase);
+
+    // A phase timed elsewhere, e.g. on another thread, nested this many
+    // levels below the current scope
+    void addPhase(std::string_view name, std::string_view detail, int nesting, int64_t startNs, int64_t endNs);
+
+    // Reports once the first prompt is up, then turns profiling off
+    void finish();
+
+    // Monotonic clock the phases are measured on
+    static int64_t now();
+
+private:
+    struct Phase {
+        std::string name;
+        std::string detail;
+        int depth;
+        int64_t startNs;
+        int64_t endNs;
+    };
+
+    std::string jsonPath;
+    int64_t originNs = 0;
+    int depth = 0;
+    std::vector<Phase> phases;
+
+    void printTable(std::ostream& out, int64_t totalNs) const;
+    void writeJSON(std::ostream& out, int64_t totalNs) const;
+};
+
+/**
+ * Profile Scope
+ * Records the enclosing block as one startup phase
+ */
+class ProfileScope {
+public:
+    explicit ProfileScope(std::string_view name, std::string_view detail = {})
+        : phase(StartupProfiler::active ? StartupProfiler::instance().begin(name, detail) : NONE) {}
+    ~ProfileScope() {
+        if (phase != NONE) StartupProfiler::instance().end(phase);
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    static constexpr size_t NONE = static_cast<size_t>(-1);
+    size_t phase;
+};
+
+#endif // STARTUP_PROFILER_H
@@ -0,0 +1,62 @@
+#ifndef THEME_CACHE_H
+#define THEME_CACHE_H
+
+#include "mapped_file.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+struct ThemeConfig;
+
+/**
+ * Theme Cache
+ * Compiled themes in one flat, versioned file: a header, a fixed-size
+ * record per theme file with offsets into a string pool, and the pool. The
+ * file is mapped and read in place; colors are stored already resolved to
+ * escape sequences, so a hit copies strings and parses nothing. A record is
+ * only used while its source file keeps the mtime and size it was built from.
+ */
+class ThemeCache {
+public:
+    struct Source {
+        std::string path;
+        int64_t mtimeNs;
+        uint64_t size;
+    };
+
+    enum class Lookup : uint8_t {
+        Miss,     // not cached, or the source changed
+        Invalid,  // cached as a file that holds no valid theme
+        Hit
+    };
+
+    // A source and the theme compiled from it, or null if it has none
+    struct Record {
+        Source source;
+        const ThemeConfig* theme;
+    };
+
+    bool open(const std::string& path);
+
+    Lookup lookup(const Source& source, ThemeConfig& theme) const;
+
+    // Whether the cache holds exactly these sources, unchanged
+    bool isCurrent(const std::vector<Source>& sources) const;
+
+    static bool write(const std::string& path, const std::vector<Record>& records);
+    static bool statSource(const std::string& path, Source& source);
+
+private:
+    struct Header;
+    struct StringRef;
+    struct Entry;
+
+    MappedFile file;
+    std::unordered_map<std::string_view, uint32_t> entries;  // source path -> record offset
+
+    bool view(const StringRef& reference, std::string_view& out) const;
+};
+
+#endif // THEME_CACHE_H
@@ -2,44 +2,77 @@
 #define THEME_MANAGER_H
 
 #include <string>
+#include <string_view>
+#include <array>
 #include <map>
+#include <set>
 #include <vector>
 #include <memory>
+#include <thread>
+#include <cstdint>
+#include "theme_cache.h"
+
+class JsonReader;
 
 /**
- * Theme Color Structure
+ * Theme Color Slots
+ * Every color a theme sets, in the order themes list them
  */
-struct ThemeColors {
+enum class ThemeColor : uint8_t {
     // Prompt colors
-    std::string promptPrefix;
-    std::string promptDirectory;
-    std::string promptSuffix;
-    std::string promptInput;
+    PromptPrefix,
+    PromptDirectory,
+    PromptSuffix,
+    PromptInput,
+    PromptUser,
+    PromptHost,
     
     // Output colors
-    std::string outputNormal;
-    std::string outputSuccess;
-    std::string outputWarning;
-    std::string outputError;
-    std::string outputInfo;
-    
-    // Syntax highlighting (for future use)
-    std::string syntaxKeyword;
-    std::string syntaxString;
-    std::string syntaxNumber;
-    std::string syntaxComment;
-    std::string syntaxOperator;
+    OutputNormal,
+    OutputSuccess,
+    OutputWarning,
+    OutputError,
+    OutputInfo,
+    
+    // Syntax highlighting of the input line
+    SyntaxKeyword,
+    SyntaxString,
+    SyntaxNumber,
+    SyntaxComment,
+    SyntaxOperator,
     
     // Special elements
-    std::string highlightBackground;
-    std::string selectionBackground;
-    std::string cursorColor;
+    HighlightBackground,
+    SelectionBackground,
+    CursorColor,
     
     // Reset codes
-    std::string reset;
-    std::string bold;
-    std::string dim;
-    std::string underline;
+    Reset,
+    Bold,
+    Dim,
+    Underline,
+    
+    Count
+};
+
+/**
+ * Theme Color Structure
+ * Escape sequences indexed by ThemeColor, so using a color is one array load
+ */
+struct ThemeColors {
+    static constexpr size_t COUNT = static_cast<size_t>(ThemeColor::Count);
+    
+    std::array<std::string, COUNT> sequences;
+    
+    std::string& operator[](ThemeColor color) { return sequences[static_cast<size_t>(color)]; }
+    const std::string& operator[](ThemeColor color) const { return sequences[static_cast<size_t>(color)]; }
+    
+    // Setting name of a color, e.g. "prompt_prefix"
+    static std::string_view keyName(ThemeColor color);
+    
+    // Finds the color a setting name refers to; also accepts the names used
+    // by the original .theme format, such as "prompt_cwd_color"
+    static bool fromKey(std::string_view key, ThemeColor& color);
 };
 
 /**
@@ -62,19 +95,119 @@ struct ThemeConfig {
     bool showTimestamp;
 };
 
+namespace AnsiColors {
+    enum class ColorDepth : uint8_t {
+        None,       // no escape sequences at all
+        Basic,      // 16 colors
+        Extended,   // 256-color palette
+        TrueColor   // 24-bit
+    };
+}
+
+/**
+ * Prompt Template
+ * A prompt format compiled once into literal spans and typed placeholders,
+ * so rendering is a single pass with no searching or pattern matching
+ */
+class PromptTemplate {
+public:
+    enum class Field : uint8_t {
+        Literal,
+        Prefix,
+        Suffix,
+        Directory,
+        User,
+        Host,
+        ExitCode,
+        Timestamp,
+        Git,
+        Symbol
+    };
+
+    // Escape sequences written around each placeholder
+    struct Style {
+        std::string prefix;
+        std::string suffix;
+        std::string directory;
+        std::string user;
+        std::string host;
+        std::string symbol;
+        std::string error;
+        std::string git;
+        std::string gitDirty;
+        std::string reset;
+        size_t directoryLimit = 0;  // longer paths keep their tail; 0 is no limit
+    };
+
+    struct Values {
+        std::string_view directory;
+        std::string_view user;
+        std::string_view host;
+        std::string_view git;  // branch; the segment is omitted when empty
+        bool gitDirty = false;
+        int exitCode = 0;
+    };
+
+    PromptTemplate() = default;
+    explicit PromptTemplate(const std::string& format);
+
+    void compile(const std::string& format);
+    bool uses(Field field) const { return (fieldMask & (1u << static_cast<unsigned>(field))) != 0; }
+
+    // Appends the rendered prompt to out
+    void render(const Style& style, const Values& values, std::string& out) const;
+
+private:
+    struct Segment {
+        Field field;
+        uint32_t offset;  // literal span in literals
+        uint32_t length;
+    };
+
+    std::string literals;
+    std::vector<Segment> segments;
+    uint32_t fieldMask = 0;
+};
+
 /**
  * External Theme Manager
  * Handles loading themes from external files without recompilation
  */
 class ExternalThemeManager {
 private:
-    std::map<std::string, std::unique_ptr<ThemeConfig>> availableThemes;
+    // Parsed themes; filled lazily from themeIndex, hence mutable
+    mutable std::map<std::string, std::unique_ptr<ThemeConfig>> availableThemes;
+    
+    // Theme files found by discoverThemes, by file name without extension,
+    // in search path order. A file is parsed the first time it is needed.
+    mutable std::map<std::string, std::vector<std::string>> themeIndex;
+    mutable std::set<std::string> parsedFiles;
+    
+    // Themes compiled by an earlier run; rebuilt in the background whenever
+    // the indexed files no longer match it
+    std::string cacheFile;
+    std::unique_ptr<ThemeCache> themeCache;
+    std::thread cacheBuilder;
     std::string currentThemeName;
     ThemeConfig* currentTheme;
     std::vector<std::string> themePaths;
     
     // Default fallback theme
     std::unique_ptr<ThemeConfig> defaultTheme;
+    
+    // Themes compiled in; kept apart from availableThemes, which follows
+    // the theme directories
+    std::map<std::string, std::unique_ptr<ThemeConfig>> builtinThemes;
+    
+    // The selected theme with every color resolved for the terminal
+    AnsiColors::ColorDepth colorDepth;
+    std::unique_ptr<ThemeConfig> resolvedTheme;
+    
+    // Current theme's prompt, compiled when the theme is selected
+    PromptTemplate promptTemplate;
+    PromptTemplate::Style promptStyle;
+    std::string userName;
+    std::string hostName;
 
 public:
     ExternalThemeManager();
@@ -82,11 +215,18 @@ public:
     
     // Theme discovery and loading
     void addThemePath(const std::string& path);
+    void setCacheFile(const std::string& path) { cacheFile = path; }
     void discoverThemes();
+    const std::vector<std::string>& getThemePaths() const { return themePaths; }
+    
+    // Re-reads every theme file into the cache now; safe on any thread
+    void compileThemes() const;
     bool loadTheme(const std::string& themePath);
     bool loadThemeFromFile(const std::string& themeFile);
     
     // Theme management
+    void setColorDepth(AnsiColors::ColorDepth depth);
+    AnsiColors::ColorDepth getColorDepth() const { return colorDepth; }
     bool setTheme(const std::string& themeName);
     const ThemeConfig* getCurrentTheme() const;
     std::string getCurrentThemeName() const;
@@ -101,8 +241,12 @@ public:
     bool exportTheme(const std::string& themeName, const std::string& outputPath) const;
     
     // Color utilities
+    const std::string& getColor(ThemeColor color) const { return currentTheme->colors[color]; }
     std::string applyColor(const std::string& text, const std::string& colorCode) const;
     std::string formatPrompt(const std::string& directory, int exitCode = 0) const;
+    void formatPrompt(const std::string& directory, int exitCode, std::string& out,
+                      std::string_view gitBranch = {}, bool gitDirty = false) const;
+    bool promptUsesGit() const { return promptTemplate.uses(PromptTemplate::Field::Git); }
     
     // File format support
     bool loadThemeFromJSON(const std::string& jsonFile);
@@ -116,7 +260,24 @@ public:
     
 private:
     void initializeDefaultTheme();
-    bool parseThemeFile(const std::string& filePath, ThemeConfig& theme);
+    void initializeBuiltinThemes();
+    void selectTheme(const ThemeConfig& theme);
+    const ThemeConfig* findTheme(const std::string& themeName) const;
+    void parseIndexedFile(const std::string& themeFile) const;
+    void parseAllIndexedFiles() const;
+    void rebuildCache(std::vector<ThemeCache::Source> sources);
+    void writeCache(const std::vector<ThemeCache::Source>& sources) const;
+    static std::vector<ThemeCache::Source> findThemeFiles(const std::vector<std::string>& paths);
+    void compilePrompt();
+    bool registerTheme(std::unique_ptr<ThemeConfig> theme, bool parsed, const std::string& error);
+    bool readThemeFile(const std::string& themeFile, ThemeConfig& theme, std::string& error) const;
+    bool readThemeJSON(const std::string& jsonFile, ThemeConfig& theme, std::string& error) const;
+    bool readThemeINI(const std::string& iniFile, ThemeConfig& theme) const;
+    bool readJSONObject(JsonReader& reader, ThemeConfig& theme, const std::string& section) const;
+    static void initializeThemeDefaults(ThemeConfig& theme);
+    static void completeLegacyTheme(ThemeConfig& theme, const std::string& name);
+    void applyThemeSetting(ThemeConfig& theme, std::string_view section,
+                           std::string_view key, std::string_view value) const;
     std::string resolveColorCode(const std::string& colorName) const;
     bool isValidColorCode(const std::string& colorCode) const;
 };
@@ -168,6 +329,16 @@ namespace AnsiColors {
     std::string rgb256(int colorCode);
     std::string hexToAnsi(const std::string& hexColor);
     bool isTerminalColorSupported();
+    
+    // Colors the terminal can show, from TERM, COLORTERM and NO_COLOR
+    ColorDepth detectColorDepth(bool colorOutput = true);
+    
+    // Rewrites the SGR sequences in an escape string for the given depth,
+    // mapping to the nearest palette color through precomputed tables
+    std::string downsample(const std::string& sequence, ColorDepth depth);
+    uint8_t rgbTo256(int r, int g, int b);
+    uint8_t rgbTo16(int r, int g, int b);
+    uint8_t ansi256To16(int colorCode);
 }
 
 #endif // THEME_MANAGER_H
\ No newline at end of file
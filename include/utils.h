@@ -3,6 +3,9 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
+
+struct stat;
 
 namespace Utils {
     // String utilities
@@ -13,6 +16,7 @@ namespace Utils {
     // File system utilities
     std::string getCurrentDirectory();
     bool changeDirectory(const std::string& path);
+    int64_t getModificationTimeNs(const struct stat& st);
     
     // Environment utilities
     std::string getEnvVar(const std::string& name);
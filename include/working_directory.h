@@ -0,0 +1,46 @@
+#ifndef WORKING_DIRECTORY_H
+#define WORKING_DIRECTORY_H
+
+#include <string>
+#include <vector>
+
+/**
+ * Working Directory
+ * The shell's logical current directory, kept in sync with chdir() so the
+ * prompt, plugins and completion can read it without calling getcwd(). The
+ * logical path keeps the symlinks it was reached through, as in POSIX
+ * `cd -L`; $PWD and $OLDPWD follow every change.
+ */
+class WorkingDirectory {
+public:
+    WorkingDirectory();
+
+    const std::string& get() const { return logical; }
+    const std::string& previous() const { return oldLogical; }
+
+    // Physical path with symlinks resolved (one getcwd call)
+    std::string physical() const;
+
+    // Changes directory. Logical mode applies ".." to the tracked path
+    // before resolving it; physical mode follows symlinks first.
+    bool change(const std::string& target, bool physical, std::string& error);
+
+    // Directory stack for pushd/popd/dirs; entry 0 is the current directory
+    std::vector<std::string> listDirectories() const;
+    size_t stackSize() const { return stack.size() + 1; }
+    bool pushDirectory(const std::string& target, std::string& error);
+    bool exchangeTop(std::string& error);
+    bool rotateTo(size_t index, std::string& error);
+    bool popDirectory(size_t index, std::string& error);
+    void clearStack() { stack.clear(); }
+
+    // Joins path onto base and removes "." and ".." lexically
+    static std::string resolve(const std::string& base, const std::string& path);
+
+private:
+    std::string logical;
+    std::string oldLogical;
+    std::vector<std::string> stack;  // most recently pushed first
+};
+
+#endif // WORKING_DIRECTORY_H
@@ -6,24 +6,30 @@
 #include <algorithm>
 
 AliasManager::AliasManager(ConfigManager* configManager) : config(configManager) {
-    // Initialize with some default aliases
-    setAlias("ll", "ls -la");
-    setAlias("la", "ls -A");
-    setAlias("l", "ls -CF");
-    setAlias("..", "cd ..");
-    setAlias("...", "cd ../..");
-    setAlias("cls", "clear");
-    setAlias("grep", "grep --color=auto");
-    setAlias("egrep", "egrep --color=auto");
-    setAlias("fgrep", "fgrep --color=auto");
+    // Initialize with some default aliases; they are only written out when
+    // the default config is created
+    aliases = {
+        {"ll", "ls -la"},
+        {"la", "ls -A"},
+        {"l", "ls -CF"},
+        {"..", "cd .."},
+        {"...", "cd ../.."},
+        {"cls", "clear"},
+        {"grep", "grep --color=auto"},
+        {"egrep", "egrep --color=auto"},
+        {"fgrep", "fgrep --color=auto"}
+    };
 }
 
 void AliasManager::setAlias(const std::string& name, const std::string& command) {
     aliases[name] = command;
+    config->markDirty(ConfigManager::AliasFile);
 }
 
 void AliasManager::removeAlias(const std::string& name) {
-    aliases.erase(name);
+    if (aliases.erase(name)) {
+        config->markDirty(ConfigManager::AliasFile);
+    }
 }
 
 bool AliasManager::hasAlias(const std::string& name) {
@@ -35,39 +41,32 @@ std::string AliasManager::getAlias(const std::string& name) {
     return (it != aliases.end()) ? it->second : "";
 }
 
-std::string AliasManager::expandAlias(const std::string& command) {
-    std::vector<std::string> tokens = Utils::split(command, ' ');
-    if (tokens.empty()) {
-        return command;
-    }
-    
-    std::string firstWord = tokens[0];
-    
-    // Check if it's an alias
-    if (hasAlias(firstWord)) {
-        std::string aliasCommand = getAlias(firstWord);
-        
-        // Replace the first word with the alias expansion
-        std::string result = aliasCommand;
-        
-        // Append remaining arguments
-        for (size_t i = 1; i < tokens.size(); ++i) {
-            result += " " + tokens[i];
+std::string AliasManager::expandAlias(const std::string& command) const {
+    // Only the first word is replaced, and the rest of the line is kept as
+    // typed. An alias is not expanded again within its own expansion, so
+    // "grep=grep --color=auto" stops after one step.
+    std::string result = command;
+    std::vector<std::string> expanded;
+    while (true) {
+        size_t start = result.find_first_not_of(" \t");
+        if (start == std::string::npos) {
+            return result;
         }
+        size_t end = result.find_first_of(" \t", start);
+        std::string firstWord = result.substr(start, end == std::string::npos ? std::string::npos : end - start);
         
-        // Recursively expand in case alias contains other aliases
-        // Prevent infinite recursion by limiting depth
-        static int expansionDepth = 0;
-        if (expansionDepth < 10) {
-            expansionDepth++;
-            result = expandAlias(result);
-            expansionDepth--;
+        auto it = aliases.find(firstWord);
+        if (it == aliases.end() ||
+            std::find(expanded.begin(), expanded.end(), firstWord) != expanded.end()) {
+            return result;
         }
-        
-        return result;
+        expanded.push_back(firstWord);
+        result = it->second + (end == std::string::npos ? "" : result.substr(end));
     }
-    
-    return command;
+}
+
+void AliasManager::replaceAliases(std::unordered_map<std::string, std::string> newAliases) {
+    aliases = std::move(newAliases);
 }
 
 std::vector<std::pair<std::string, std::string>> AliasManager::getAllAliases() {
@@ -84,10 +83,17 @@ std::vector<std::pair<std::string, std::string>> AliasManager::getAllAliases() {
 
 void AliasManager::setFunction(const std::string& name, const std::string& body) {
     functions[name] = body;
+    config->markDirty(ConfigManager::FunctionFile);
+}
+
+void AliasManager::replaceFunctions(std::unordered_map<std::string, std::string> newFunctions) {
+    functions = std::move(newFunctions);
 }
 
 void AliasManager::removeFunction(const std::string& name) {
-    functions.erase(name);
+    if (functions.erase(name)) {
+        config->markDirty(ConfigManager::FunctionFile);
+    }
 }
 
 bool AliasManager::hasFunction(const std::string& name) {
@@ -100,14 +106,20 @@ std::string AliasManager::getFunction(const std::string& name) {
 }
 
 bool AliasManager::loadAliases() {
-    std::string aliasFile = getAliasFilePath();
-    std::ifstream file(aliasFile);
-    
+    std::unordered_map<std::string, std::string> loaded;
+    if (!readAliasFile(loaded)) {
+        return false;
+    }
+    aliases = std::move(loaded);
+    return true;
+}
+
+bool AliasManager::readAliasFile(std::unordered_map<std::string, std::string>& out) const {
+    std::ifstream file(getAliasFilePath());
     if (!file.is_open()) {
         return false;
     }
     
-    aliases.clear();
     std::string line;
     
     while (std::getline(file, line)) {
@@ -127,43 +139,44 @@ bool AliasManager::loadAliases() {
                 command = command.substr(1, command.length() - 2);
             }
             
-            aliases[name] = command;
+            out[name] = command;
         }
     }
-    
-    file.close();
     return true;
 }
 
 bool AliasManager::saveAliases() {
-    std::string aliasFile = getAliasFilePath();
-    std::ofstream file(aliasFile);
+    config->markDirty(ConfigManager::AliasFile);
+    return config->saveConfig();
+}
+
+std::string AliasManager::renderAliasFile() const {
+    std::vector<std::pair<std::string, std::string>> sorted(aliases.begin(), aliases.end());
+    std::sort(sorted.begin(), sorted.end());
     
-    if (!file.is_open()) {
-        return false;
+    std::string contents = "# Lynx Shell Aliases\n"
+                           "# Format: alias_name=command\n\n";
+    for (const auto& [name, command] : sorted) {
+        contents += name + "=\"" + command + "\"\n";
     }
-    
-    file << "# Lynx Shell Aliases\n";
-    file << "# Format: alias_name=command\n\n";
-    
-    auto allAliases = getAllAliases();
-    for (const auto& pair : allAliases) {
-        file << pair.first << "=\"" << pair.second << "\"\n";
+    return contents;
+}
+
+bool AliasManager::loadFunctions() {
+    std::unordered_map<std::string, std::string> loaded;
+    if (!readFunctionFile(loaded)) {
+        return false;
     }
-    
-    file.close();
+    functions = std::move(loaded);
     return true;
 }
 
-bool AliasManager::loadFunctions() {
-    std::string functionFile = getFunctionFilePath();
-    std::ifstream file(functionFile);
-    
+bool AliasManager::readFunctionFile(std::unordered_map<std::string, std::string>& out) const {
+    std::ifstream file(getFunctionFilePath());
     if (!file.is_open()) {
         return false;
     }
     
-    functions.clear();
     std::string line;
     std::string currentFunction;
     std::string currentBody;
@@ -179,7 +192,7 @@ bool AliasManager::loadFunctions() {
         if (line.find("function ") == 0) {
             // Save previous function if any
             if (inFunction && !currentFunction.empty()) {
-                functions[currentFunction] = currentBody;
+                out[currentFunction] = currentBody;
             }
             
             // Start new function
@@ -192,7 +205,7 @@ bool AliasManager::loadFunctions() {
         } else if (line == "}" && inFunction) {
             // End function
             if (!currentFunction.empty()) {
-                functions[currentFunction] = currentBody;
+                out[currentFunction] = currentBody;
             }
             currentFunction = "";
             currentBody = "";
@@ -205,36 +218,30 @@ bool AliasManager::loadFunctions() {
             currentBody += line;
         }
     }
-    
-    file.close();
     return true;
 }
 
 bool AliasManager::saveFunctions() {
-    std::string functionFile = getFunctionFilePath();
-    std::ofstream file(functionFile);
-    
-    if (!file.is_open()) {
-        return false;
-    }
-    
-    file << "# Lynx Shell Functions\n";
-    file << "# Format: function name { body }\n\n";
+    config->markDirty(ConfigManager::FunctionFile);
+    return config->saveConfig();
+}
+
+std::string AliasManager::renderFunctionFile() const {
+    std::vector<std::pair<std::string, std::string>> sorted(functions.begin(), functions.end());
+    std::sort(sorted.begin(), sorted.end());
     
-    for (const auto& pair : functions) {
-        file << "function " << pair.first << " {\n";
-        file << pair.second << "\n";
-        file << "}\n\n";
+    std::string contents = "# Lynx Shell Functions\n"
+                           "# Format: function name { body }\n\n";
+    for (const auto& [name, body] : sorted) {
+        contents += "function " + name + " {\n" + body + "\n}\n\n";
     }
-    
-    file.close();
-    return true;
+    return contents;
 }
 
-std::string AliasManager::getAliasFilePath() {
+std::string AliasManager::getAliasFilePath() const {
     return config->getConfigDir() + "/aliases";
 }
 
-std::string AliasManager::getFunctionFilePath() {
+std::string AliasManager::getFunctionFilePath() const {
     return config->getConfigDir() + "/functions";
 }
\ No newline at end of file
@@ -3,11 +3,70 @@
 #include "config.h"
 #include "utils.h"
 #include "version.h"
+#include "working_directory.h"
+#include "frecency.h"
+#include "plugin.h"
 #include <iostream>
 #include <sstream>
 #include <unistd.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+namespace {
+    // executeBuiltinCommand may be called without a shell; cd still needs
+    // somewhere to track the directory
+    WorkingDirectory& workingDirectoryOf(Shell* shell) {
+        if (shell) {
+            return shell->getWorkingDirectory();
+        }
+        static WorkingDirectory fallback;
+        return fallback;
+    }
+
+    void recordVisit(Shell* shell) {
+        if (shell && shell->getDirectoryDatabase()) {
+            shell->getDirectoryDatabase()->recordVisit(shell->getCurrentDirectory());
+        }
+    }
+
+    // "~/src" rather than "/home/user/src", as dirs prints by default
+    std::string abbreviateHome(const std::string& path) {
+        std::string home = Utils::getHomeDirectory();
+        if (!home.empty() && home != "/" && path.compare(0, home.size(), home) == 0 &&
+            (path.size() == home.size() || path[home.size()] == '/')) {
+            return "~" + path.substr(home.size());
+        }
+        return path;
+    }
+
+    // Parses a +N / -N stack index into a position from the top
+    bool parseStackIndex(const std::string& arg, size_t stackSize, size_t& index) {
+        if (arg.size() < 2 || (arg[0] != '+' && arg[0] != '-')) {
+            return false;
+        }
+        size_t value = 0;
+        for (size_t i = 1; i < arg.size(); ++i) {
+            if (arg[i] < '0' || arg[i] > '9') return false;
+            value = value * 10 + static_cast<size_t>(arg[i] - '0');
+            if (value >= stackSize) return false;
+        }
+        index = arg[0] == '+' ? value : stackSize - 1 - value;
+        return true;
+    }
+
+    void printDirectoryStack(const WorkingDirectory& directory) {
+        std::vector<std::string> directories = directory.listDirectories();
+        for (size_t i = 0; i < directories.size(); ++i) {
+            std::cout << (i ? " " : "") << abbreviateHome(directories[i]);
+        }
+        std::cout << std::endl;
+    }
+}
 
 Command::Command(const std::string& cmdName, const std::vector<std::string>& cmdArgs)
     : name(cmdName), args(cmdArgs) {}
@@ -39,15 +98,23 @@ std::vector<std::string> CommandParser::tokenize(const std::string& input) {
 
 bool CommandExecutor::executeBuiltinCommand(const Command& cmd, Shell* shell) {
     if (cmd.name == "cd") {
-        return executeCD(cmd.args);
+        return executeCD(cmd.args, shell);
     } else if (cmd.name == "pwd") {
-        return executePWD();
+        return executePWD(cmd.args, shell);
+    } else if (cmd.name == "pushd") {
+        return executePushd(cmd.args, shell);
+    } else if (cmd.name == "popd") {
+        return executePopd(cmd.args, shell);
+    } else if (cmd.name == "dirs") {
+        return executeDirs(cmd.args, shell);
+    } else if (cmd.name == "z" || cmd.name == "j") {
+        return executeJump(cmd.args, shell);
     } else if (cmd.name == "exit") {
-        return executeExit();
+        return executeExit(shell);
     } else if (cmd.name == "help") {
         return executeHelp();
     } else if (cmd.name == "history") {
-        return executeHistory(shell);
+        return executeHistory(cmd.args, shell);
     } else if (cmd.name == "env") {
         return executeEnv();
     } else if (cmd.name == "clear") {
@@ -56,6 +123,10 @@ bool CommandExecutor::executeBuiltinCommand(const Command& cmd, Shell* shell) {
         return true;
     } else if (cmd.name == "version") {
         return executeVersion();
+    } else if (cmd.name == "set") {
+        return executeSet(cmd.args, shell);
+    } else if (cmd.name == "plugins") {
+        return executePlugins(cmd.args, shell);
     }
     return false;
 }
@@ -80,9 +151,17 @@ int CommandExecutor::executeExternalCommand(const Command& cmd) {
         }
     } else if (pid > 0) {
         // Parent process
-        int status;
-        waitpid(pid, &status, 0);
-        return WEXITSTATUS(status);
+        int status = 0;
+        while (waitpid(pid, &status, 0) == -1) {
+            if (errno != EINTR) {
+                std::cerr << "lynx: failed to wait for " << cmd.name << ": " << std::strerror(errno) << std::endl;
+                return 1;
+            }
+        }
+        if (WIFEXITED(status)) {
+            return WEXITSTATUS(status);
+        }
+        return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : 1;
     } else {
         // Fork failed
         std::cerr << "lynx: failed to fork process" << std::endl;
@@ -93,63 +172,267 @@ int CommandExecutor::executeExternalCommand(const Command& cmd) {
 }
 
 bool CommandExecutor::isBuiltinCommand(const std::string& commandName) {
-    return commandName == "cd" || commandName == "pwd" || commandName == "exit" ||
-           commandName == "help" || commandName == "history" || commandName == "env" ||
-           commandName == "clear" || commandName == "version";
+    const auto& builtins = getBuiltinCommands();
+    return std::find(builtins.begin(), builtins.end(), commandName) != builtins.end();
 }
 
-bool CommandExecutor::executeCD(const std::vector<std::string>& args) {
-    std::string path;
+const std::vector<std::string>& CommandExecutor::getBuiltinCommands() {
+    static const std::vector<std::string> builtins = {
+        "cd", "pwd", "pushd", "popd", "dirs", "z", "j", "exit", "help", "history", "env", "clear", "version", "set", "plugins"
+    };
+    return builtins;
+}
+
+bool CommandExecutor::executeCD(const std::vector<std::string>& args, Shell* shell) {
+    WorkingDirectory& directory = workingDirectoryOf(shell);
+    bool physical = false;
+    size_t i = 0;
+    for (; i < args.size() && args[i].size() > 1 && args[i][0] == '-' && args[i] != "--"; ++i) {
+        if (args[i] == "-P") {
+            physical = true;
+        } else if (args[i] == "-L") {
+            physical = false;
+        } else {
+            break;  // "-" is the previous directory, not an option
+        }
+    }
+    if (i < args.size() && args[i] == "--") {
+        ++i;
+    }
     
-    if (args.empty()) {
+    std::string path;
+    bool printPath = false;
+    if (i >= args.size()) {
         // No argument, go to home directory
-        path = Utils::getEnvVar("HOME");
+        path = Utils::getHomeDirectory();
+    } else if (args[i] == "-") {
+        if (directory.previous().empty()) {
+            std::cerr << "lynx: cd: OLDPWD not set" << std::endl;
+            return false;
+        }
+        path = directory.previous();
+        printPath = true;
     } else {
-        path = args[0];
+        path = Utils::expandPath(args[i]);
     }
-    
-    if (Utils::changeDirectory(path)) {
-        Utils::setEnvVar("PWD", Utils::getCurrentDirectory());
+    if (path.empty()) {
         return true;
+    }
+    
+    std::string error;
+    if (!directory.change(path, physical, error)) {
+        std::cerr << "lynx: cd: " << error << std::endl;
+        return false;
+    }
+    if (printPath) {
+        std::cout << directory.get() << std::endl;
+    }
+    recordVisit(shell);
+    return true;
+}
+
+bool CommandExecutor::executePWD(const std::vector<std::string>& args, Shell* shell) {
+    const WorkingDirectory& directory = workingDirectoryOf(shell);
+    bool physical = !args.empty() && args.back() == "-P";
+    std::cout << (physical ? directory.physical() : directory.get()) << std::endl;
+    return true;
+}
+
+bool CommandExecutor::executePushd(const std::vector<std::string>& args, Shell* shell) {
+    WorkingDirectory& directory = workingDirectoryOf(shell);
+    std::string error;
+    size_t index = 0;
+    bool changed;
+    if (args.empty()) {
+        changed = directory.exchangeTop(error);
+    } else if (parseStackIndex(args[0], directory.stackSize(), index)) {
+        changed = directory.rotateTo(index, error);
+    } else if (args[0][0] == '+' || (args[0][0] == '-' && args[0] != "-")) {
+        std::cerr << "lynx: pushd: " << args[0] << ": directory stack index out of range" << std::endl;
+        return false;
     } else {
-        std::cerr << "lynx: cd: " << path << ": No such file or directory" << std::endl;
+        std::string path = args[0] == "-" ? directory.previous() : Utils::expandPath(args[0]);
+        changed = directory.pushDirectory(path, error);
+    }
+    
+    if (!changed) {
+        std::cerr << "lynx: pushd: " << error << std::endl;
         return false;
     }
+    recordVisit(shell);
+    printDirectoryStack(directory);
+    return true;
 }
 
-bool CommandExecutor::executePWD() {
-    std::cout << Utils::getCurrentDirectory() << std::endl;
+bool CommandExecutor::executePopd(const std::vector<std::string>& args, Shell* shell) {
+    WorkingDirectory& directory = workingDirectoryOf(shell);
+    size_t index = 0;
+    if (!args.empty() && !parseStackIndex(args[0], directory.stackSize(), index)) {
+        std::cerr << "lynx: popd: " << args[0] << ": directory stack index out of range" << std::endl;
+        return false;
+    }
+    
+    std::string error;
+    if (!directory.popDirectory(index, error)) {
+        std::cerr << "lynx: popd: " << error << std::endl;
+        return false;
+    }
+    printDirectoryStack(directory);
     return true;
 }
 
-bool CommandExecutor::executeExit() {
+bool CommandExecutor::executeDirs(const std::vector<std::string>& args, Shell* shell) {
+    WorkingDirectory& directory = workingDirectoryOf(shell);
+    bool verbose = false;
+    bool longForm = false;
+    bool perLine = false;
+    for (const auto& arg : args) {
+        if (arg == "-c") {
+            directory.clearStack();
+            return true;
+        } else if (arg == "-v") {
+            verbose = true;
+        } else if (arg == "-l") {
+            longForm = true;
+        } else if (arg == "-p") {
+            perLine = true;
+        } else {
+            std::cerr << "lynx: dirs: usage: dirs [-c] [-l] [-p] [-v]" << std::endl;
+            return false;
+        }
+    }
+    
+    if (!verbose && !perLine && !longForm) {
+        printDirectoryStack(directory);
+        return true;
+    }
+    std::vector<std::string> directories = directory.listDirectories();
+    for (size_t i = 0; i < directories.size(); ++i) {
+        const std::string path = longForm ? directories[i] : abbreviateHome(directories[i]);
+        if (verbose) {
+            std::cout << (i < 10 ? " " : "") << i << "  " << path << std::endl;
+        } else if (perLine) {
+            std::cout << path << std::endl;
+        } else {
+            std::cout << (i ? " " : "") << path;
+        }
+    }
+    if (!verbose && !perLine) {
+        std::cout << std::endl;
+    }
+    return true;
+}
+
+bool CommandExecutor::executeJump(const std::vector<std::string>& args, Shell* shell) {
+    FrecencyDatabase* database = shell ? shell->getDirectoryDatabase() : nullptr;
+    bool listOnly = !args.empty() && args[0] == "-l";
+    std::vector<std::string> terms(args.begin() + (listOnly ? 1 : 0), args.end());
+    
+    if (listOnly) {
+        if (!database) {
+            std::cerr << "lynx: z: directory tracking is disabled (track_directories)" << std::endl;
+            return false;
+        }
+        for (const auto& match : database->list(terms, 20)) {
+            char score[32];
+            std::snprintf(score, sizeof(score), "%10.2f", match.score);
+            std::cout << score << "  " << match.path << std::endl;
+        }
+        return true;
+    }
+    
+    // No terms, "-", or a path that exists behave like cd
+    if (terms.empty() || (terms.size() == 1 && terms[0] == "-")) {
+        return executeCD(terms, shell);
+    }
+    struct stat st;
+    if (terms.size() == 1 && stat(Utils::expandPath(terms[0]).c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+        return executeCD(terms, shell);
+    }
+    if (!database) {
+        std::cerr << "lynx: z: directory tracking is disabled (track_directories)" << std::endl;
+        return false;
+    }
+    
+    std::string target;
+    if (!database->query(terms, workingDirectoryOf(shell).get(), target)) {
+        std::cerr << "lynx: z: no match for " << Utils::join(terms, " ") << std::endl;
+        return false;
+    }
+    std::string error;
+    if (!workingDirectoryOf(shell).change(target, false, error)) {
+        std::cerr << "lynx: z: " << error << std::endl;
+        return false;
+    }
+    recordVisit(shell);
+    return true;
+}
+
+bool CommandExecutor::executeExit(Shell* shell) {
+    // Let the shell unwind normally so history and plugins are persisted
+    if (shell) {
+        shell->exit();
+        return true;
+    }
     exit(0);
     return true;
 }
 
 bool CommandExecutor::executeHelp() {
     std::cout << "Lynx Shell - Available Commands:" << std::endl;
-    std::cout << "  cd <directory>  - Change directory" << std::endl;
-    std::cout << "  pwd             - Print working directory" << std::endl;
+    std::cout << "  cd [-L|-P] <directory> - Change directory (cd - returns to the previous one)" << std::endl;
+    std::cout << "  pwd [-L|-P]     - Print working directory" << std::endl;
+    std::cout << "  pushd <dir|+N>  - Change directory and push the old one on the stack" << std::endl;
+    std::cout << "  popd [+N]       - Return to the directory on top of the stack" << std::endl;
+    std::cout << "  dirs [-c|-l|-p|-v] - Show the directory stack" << std::endl;
+    std::cout << "  z <terms...>    - Jump to the most frecent directory matching terms (alias j)" << std::endl;
+    std::cout << "  z -l [terms...] - List tracked directories with their scores" << std::endl;
     std::cout << "  exit            - Exit the shell" << std::endl;
     std::cout << "  help            - Show this help message" << std::endl;
     std::cout << "  history         - Show command history" << std::endl;
+    std::cout << "  history export <file> - Write history as plain text" << std::endl;
+    std::cout << "  history stats   - Show history storage statistics" << std::endl;
     std::cout << "  env             - Display environment variables" << std::endl;
     std::cout << "  clear           - Clear the screen" << std::endl;
     std::cout << "  version         - Show version information" << std::endl;
+    std::cout << "  set [key [value]] - Show or change settings; changes are saved to ~/.lynx/config" << std::endl;
+    std::cout << "  plugins [list]  - Show loaded plugins" << std::endl;
+    std::cout << "  plugins stats [name] - Show time spent in plugin handlers" << std::endl;
+    std::cout << "  plugins reload <name> - Load a new build of a plugin" << std::endl;
     std::cout << std::endl;
     std::cout << "Configuration is loaded from ~/.lynx/ files at startup." << std::endl;
     std::cout << "You can also run any external command available in your PATH." << std::endl;
     return true;
 }
 
-bool CommandExecutor::executeHistory(Shell* shell) {
+bool CommandExecutor::executeHistory(const std::vector<std::string>& args, Shell* shell) {
     if (!shell) {
         std::cout << "History functionality requires shell context" << std::endl;
         return false;
     }
     
     const auto& history = shell->getHistory();
+    
+    if (!args.empty() && args[0] == "export") {
+        if (args.size() < 2) {
+            std::cerr << "lynx: history: usage: history export <file>" << std::endl;
+            return false;
+        }
+        std::string path = Utils::expandPath(args[1]);
+        if (!history.exportText(path)) {
+            std::cerr << "lynx: history: cannot write " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+    
+    if (!args.empty() && args[0] == "stats") {
+        std::cout << "Entries:        " << history.size() << std::endl;
+        std::cout << "Unique entries: " << history.uniqueCount() << std::endl;
+        std::cout << "Memory (bytes): " << history.memoryUsage() << std::endl;
+        return true;
+    }
+    
     for (size_t i = 0; i < history.size(); ++i) {
         std::cout << i + 1 << ": " << history[i] << std::endl;
     }
@@ -168,3 +451,61 @@ bool CommandExecutor::executeVersion() {
     std::cout << Version::getVersionString() << std::endl;
     return true;
 }
+
+bool CommandExecutor::executeSet(const std::vector<std::string>& args, Shell* shell) {
+    ConfigManager* config = shell ? shell->getConfigManager() : nullptr;
+    if (!config) {
+        std::cerr << "lynx: set: requires shell context" << std::endl;
+        return false;
+    }
+    
+    if (args.empty()) {
+        std::vector<std::pair<std::string, std::string>> sorted(config->getAllSettings().begin(),
+                                                                config->getAllSettings().end());
+        std::sort(sorted.begin(), sorted.end());
+        for (const auto& [key, value] : sorted) {
+            std::cout << key << "=" << value << std::endl;
+        }
+        return true;
+    }
+    if (args.size() == 1) {
+        if (!config->hasSetting(args[0])) {
+            std::cerr << "lynx: set: " << args[0] << " is not set" << std::endl;
+            return false;
+        }
+        std::cout << args[0] << "=" << config->getSetting(args[0]) << std::endl;
+        return true;
+    }
+    
+    // Words after the key are the value, so quotes are optional
+    std::vector<std::string> words(args.begin() + 1, args.end());
+    std::string value = Utils::join(words, " ");
+    std::string error;
+    if (!config->setSetting(args[0], value, error)) {
+        std::cerr << "lynx: set: " << args[0] << ": " << error << std::endl;
+        return false;
+    }
+    shell->applySettings();
+    return true;
+}
+
+bool CommandExecutor::executePlugins(const std::vector<std::string>& args, Shell* shell) {
+    PluginManager* plugins = shell ? shell->getPluginManager() : nullptr;
+    if (!plugins) {
+        std::cerr << "lynx: plugins: requires shell context" << std::endl;
+        return false;
+    }
+    
+    if (args.empty() || (args[0] == "list" && args.size() == 1)) {
+        plugins->listPlugins();
+        return true;
+    }
+    if (args[0] == "stats" && args.size() <= 2) {
+        return plugins->printStats(args.size() == 2 ? args[1] : "");
+    }
+    if (args[0] == "reload" && args.size() == 2) {
+        return plugins->reloadPlugin(args[1]);
+    }
+    std::cerr << "lynx: plugins: usage: plugins [list | stats [name] | reload <name>]" << std::endl;
+    return false;
+}
@@ -0,0 +1,564 @@
+#include "completion.h"
+#include "shell.h"
+#include "command.h"
+#include "plugin.h"
+#include "config.h"
+#include "utils.h"
+#include <algorithm>
+#include <numeric>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace {
+    // Upper bound on candidates gathered for one Tab press
+    const size_t MAX_CANDIDATES = 2000;
+
+    // How often prompts may ask the indexer to re-check PATH
+    const std::chrono::milliseconds REFRESH_INTERVAL(1000);
+
+    // Listings kept in memory at once; the least recently used is dropped
+    const size_t MAX_CACHED_DIRECTORIES = 16;
+
+    unsigned char firstByte(const std::string& text) {
+        return static_cast<unsigned char>(text[0]);
+    }
+
+    // ASCII case folding by table lookup; other bytes map to themselves
+    struct FoldTable {
+        unsigned char map[256];
+        FoldTable() {
+            for (int i = 0; i < 256; ++i) {
+                map[i] = static_cast<unsigned char>((i >= 'A' && i <= 'Z') ? i + ('a' - 'A') : i);
+            }
+        }
+    };
+    const FoldTable FOLD;
+
+    inline unsigned char fold(char c) {
+        return FOLD.map[static_cast<unsigned char>(c)];
+    }
+
+    int compareFolded(std::string_view a, std::string_view b) {
+        size_t length = std::min(a.size(), b.size());
+        for (size_t i = 0; i < length; ++i) {
+            unsigned char x = fold(a[i]);
+            unsigned char y = fold(b[i]);
+            if (x != y) return x < y ? -1 : 1;
+        }
+        return a.size() < b.size() ? -1 : (a.size() > b.size() ? 1 : 0);
+    }
+
+    bool startsWithFolded(std::string_view text, std::string_view prefix) {
+        return text.size() >= prefix.size() && compareFolded(text.substr(0, prefix.size()), prefix) == 0;
+    }
+}
+
+// Radix Tree Implementation
+RadixTree::RadixTree() : count(0) {}
+
+void RadixTree::insert(const std::string& word) {
+    Node* node = &root;
+    size_t pos = 0;
+
+    while (true) {
+        if (pos == word.size()) {
+            if (!node->terminal) {
+                node->terminal = true;
+                count++;
+            }
+            return;
+        }
+
+        unsigned char next = static_cast<unsigned char>(word[pos]);
+        auto it = std::lower_bound(node->children.begin(), node->children.end(), next,
+            [](const std::unique_ptr<Node>& child, unsigned char byte) {
+                return firstByte(child->label) < byte;
+            });
+
+        if (it == node->children.end() || firstByte((*it)->label) != next) {
+            auto leaf = std::make_unique<Node>();
+            leaf->label = word.substr(pos);
+            leaf->terminal = true;
+            node->children.insert(it, std::move(leaf));
+            count++;
+            return;
+        }
+
+        Node* child = it->get();
+        size_t common = 0;
+        while (common < child->label.size() && pos + common < word.size() &&
+               child->label[common] == word[pos + common]) {
+            ++common;
+        }
+
+        if (common < child->label.size()) {
+            // Split the edge at the point where the words diverge
+            auto split = std::make_unique<Node>();
+            split->label = child->label.substr(0, common);
+            child->label.erase(0, common);
+            split->children.push_back(std::move(*it));
+            *it = std::move(split);
+        }
+
+        node = it->get();
+        pos += common;
+    }
+}
+
+bool RadixTree::contains(const std::string& word) const {
+    const Node* node = &root;
+    size_t pos = 0;
+
+    while (pos < word.size()) {
+        unsigned char next = static_cast<unsigned char>(word[pos]);
+        const Node* match = nullptr;
+        for (const auto& child : node->children) {
+            if (firstByte(child->label) == next) {
+                match = child.get();
+                break;
+            }
+        }
+        if (!match || word.compare(pos, match->label.size(), match->label) != 0) {
+            return false;
+        }
+        pos += match->label.size();
+        node = match;
+    }
+    return node->terminal;
+}
+
+void RadixTree::collect(const std::string& prefix, std::vector<std::string>& out, size_t limit) const {
+    const Node* node = &root;
+    std::string word;
+    size_t pos = 0;
+
+    while (pos < prefix.size()) {
+        unsigned char next = static_cast<unsigned char>(prefix[pos]);
+        const Node* match = nullptr;
+        for (const auto& child : node->children) {
+            if (firstByte(child->label) == next) {
+                match = child.get();
+                break;
+            }
+        }
+        if (!match) {
+            return;
+        }
+
+        size_t length = std::min(match->label.size(), prefix.size() - pos);
+        if (match->label.compare(0, length, prefix, pos, length) != 0) {
+            return;
+        }
+        word += match->label;
+        pos += match->label.size();
+        node = match;
+    }
+
+    collectFrom(*node, word, out, limit);
+}
+
+void RadixTree::collectFrom(const Node& node, std::string& word, std::vector<std::string>& out, size_t limit) {
+    if (out.size() >= limit) {
+        return;
+    }
+    if (node.terminal) {
+        out.push_back(word);
+    }
+    for (const auto& child : node.children) {
+        size_t length = word.size();
+        word += child->label;
+        collectFrom(*child, word, out, limit);
+        word.resize(length);
+    }
+}
+
+// Command Completer Implementation
+CommandCompleter::CommandCompleter() : generation(0), stopRequested(false), refreshRequested(false) {}
+
+CommandCompleter::~CommandCompleter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+    }
+    wakeup.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void CommandCompleter::start() {
+    if (worker.joinable()) {
+        return;
+    }
+    requestRefresh();
+    worker = std::thread(&CommandCompleter::workerLoop, this);
+}
+
+void CommandCompleter::requestRefresh() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // The environment is only read here, on the main thread
+        requestedPath = Utils::getEnvVar("PATH");
+        refreshRequested = true;
+    }
+    wakeup.notify_one();
+}
+
+bool CommandCompleter::isReady() const {
+    return std::atomic_load(&snapshot) != nullptr;
+}
+
+void CommandCompleter::complete(const std::string& prefix, std::vector<std::string>& out, size_t limit) const {
+    std::shared_ptr<const RadixTree> tree = std::atomic_load(&snapshot);
+    if (tree) {
+        tree->collect(prefix, out, limit);
+    }
+}
+
+bool CommandCompleter::isExecutable(const std::string& name) const {
+    std::shared_ptr<const RadixTree> tree = std::atomic_load(&snapshot);
+    return tree && tree->contains(name);
+}
+
+void CommandCompleter::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopRequested) {
+        if (refreshRequested) {
+            refreshRequested = false;
+            std::string path = requestedPath;
+            lock.unlock();
+            rescan(path);
+            lock.lock();
+            continue;
+        }
+        wakeup.wait(lock);
+    }
+}
+
+void CommandCompleter::rescan(const std::string& path) {
+    bool changed = path != indexedPath || !std::atomic_load(&snapshot);
+
+    // Only directories whose inode or mtime moved are read again
+    std::map<std::string, DirectoryListing> next;
+    for (std::string directory : Utils::split(path, ':')) {
+        if (directory.empty()) {
+            directory = ".";
+        }
+        if (next.count(directory)) {
+            continue;
+        }
+
+        DirectoryListing listing;
+        auto it = directories.find(directory);
+        if (it != directories.end()) {
+            listing = std::move(it->second);
+        }
+        if (scanDirectory(directory, listing)) {
+            changed = true;
+        }
+        next[directory] = std::move(listing);
+    }
+    directories.swap(next);
+    indexedPath = path;
+
+    if (!changed) {
+        return;
+    }
+
+    auto tree = std::make_shared<RadixTree>();
+    for (const auto& [directory, listing] : directories) {
+        for (const auto& name : listing.executables) {
+            tree->insert(name);
+        }
+    }
+    std::atomic_store(&snapshot, std::shared_ptr<const RadixTree>(std::move(tree)));
+    generation++;
+}
+
+bool CommandCompleter::scanDirectory(const std::string& path, DirectoryListing& listing) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        bool hadEntries = !listing.executables.empty();
+        listing = DirectoryListing();
+        return hadEntries;
+    }
+
+    int64_t mtime = Utils::getModificationTimeNs(st);
+    if (listing.device == st.st_dev && listing.inode == st.st_ino && listing.mtimeNs == mtime) {
+        return false;
+    }
+
+    listing.device = st.st_dev;
+    listing.inode = st.st_ino;
+    listing.mtimeNs = mtime;
+    listing.executables.clear();
+
+    DIR* dir = opendir(path.c_str());
+    if (!dir) {
+        return true;
+    }
+
+    int fd = dirfd(dir);
+    while (struct dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.' ||
+            entry->d_type == DT_DIR) {
+            continue;
+        }
+
+        struct stat entryStat;
+        if (fstatat(fd, entry->d_name, &entryStat, 0) == 0 &&
+            S_ISREG(entryStat.st_mode) && (entryStat.st_mode & 0111)) {
+            listing.executables.emplace_back(entry->d_name);
+        }
+    }
+    closedir(dir);
+    return true;
+}
+
+// Path Completer Implementation
+PathCompleter::PathCompleter(bool caseSensitive) : caseSensitive(caseSensitive), useCounter(0) {}
+
+void PathCompleter::setCaseSensitive(bool enabled) {
+    if (enabled != caseSensitive) {
+        // Cached listings are sorted for the old comparison
+        cache.clear();
+        caseSensitive = enabled;
+    }
+}
+
+void PathCompleter::complete(const std::string& word, const std::string& workingDirectory,
+                             std::vector<std::string>& out, size_t limit, bool directoriesOnly) {
+    size_t slash = word.rfind('/');
+    std::string directoryPart = slash == std::string::npos ? "" : word.substr(0, slash + 1);
+    std::string prefix = slash == std::string::npos ? word : word.substr(slash + 1);
+    std::string directory = WorkingDirectory::resolve(workingDirectory, Utils::expandPath(directoryPart));
+
+    const Listing* listing = getListing(directory);
+    if (!listing) {
+        return;
+    }
+
+    bool showHidden = !prefix.empty() && prefix[0] == '.';
+    auto emit = [&](size_t i) {
+        std::string_view name = listing->name(i);
+        if ((!showHidden && name[0] == '.') || (directoriesOnly && !listing->isDirectory[i])) {
+            return;
+        }
+        std::string candidate = directoryPart;
+        candidate.append(name.data(), name.size());
+        if (listing->isDirectory[i]) {
+            candidate += '/';
+        }
+        out.push_back(std::move(candidate));
+    };
+
+    // Names are stored in the order the search compares in, so a binary
+    // search finds the first match and the rest follow: O(log n + k)
+    auto less = [this](std::string_view name, std::string_view key) {
+        return caseSensitive ? name < key : compareFolded(name, key) < 0;
+    };
+    auto matches = [this](std::string_view name, std::string_view key) {
+        return caseSensitive ? name.compare(0, key.size(), key) == 0 : startsWithFolded(name, key);
+    };
+
+    const size_t count = listing->size();
+    size_t low = 0, high = count;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (less(listing->name(mid), prefix)) low = mid + 1; else high = mid;
+    }
+    for (size_t i = low; i < count && out.size() < limit && matches(listing->name(i), prefix); ++i) {
+        emit(i);
+    }
+}
+
+const PathCompleter::Listing* PathCompleter::getListing(const std::string& directory) {
+    struct stat st;
+    if (stat(directory.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return nullptr;
+    }
+
+    int64_t mtime = Utils::getModificationTimeNs(st);
+    auto key = std::make_pair(st.st_dev, st.st_ino);
+    auto it = cache.find(key);
+    if (it != cache.end() && it->second.mtimeNs == mtime) {
+        it->second.lastUsed = ++useCounter;
+        return &it->second;
+    }
+
+    if (it == cache.end()) {
+        if (cache.size() >= MAX_CACHED_DIRECTORIES) {
+            auto oldest = std::min_element(cache.begin(), cache.end(), [](const auto& a, const auto& b) {
+                return a.second.lastUsed < b.second.lastUsed;
+            });
+            cache.erase(oldest);
+        }
+        it = cache.emplace(key, Listing()).first;
+    }
+
+    Listing& listing = it->second;
+    listing = Listing();
+    listing.device = st.st_dev;
+    listing.inode = st.st_ino;
+    listing.mtimeNs = mtime;
+    if (!readListing(directory, caseSensitive, listing)) {
+        cache.erase(it);
+        return nullptr;
+    }
+    listing.lastUsed = ++useCounter;
+    return &listing;
+}
+
+bool PathCompleter::readListing(const std::string& directory, bool caseSensitive, Listing& listing) {
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) {
+        return false;
+    }
+
+    // Pack names into one buffer first so large directories cost a handful
+    // of allocations rather than one per entry
+    std::string packed;
+    std::vector<uint32_t> starts;
+    std::vector<uint8_t> directoryFlags;
+    int fd = dirfd(dir);
+    while (struct dirent* entry = readdir(dir)) {
+        const char* name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+
+        bool isDirectory = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) {
+            struct stat st;
+            isDirectory = fstatat(fd, name, &st, 0) == 0 && S_ISDIR(st.st_mode);
+        }
+
+        starts.push_back(static_cast<uint32_t>(packed.size()));
+        packed += name;
+        directoryFlags.push_back(isDirectory ? 1 : 0);
+    }
+    closedir(dir);
+    starts.push_back(static_cast<uint32_t>(packed.size()));
+
+    // Sort keys are the raw names, or an ASCII-folded copy so that the
+    // case-insensitive sort still compares with memcmp
+    std::string keys(packed);
+    if (!caseSensitive) {
+        for (char& c : keys) {
+            c = static_cast<char>(fold(c));
+        }
+    }
+    auto key = [&](uint32_t i) {
+        return std::string_view(keys).substr(starts[i], starts[i + 1] - starts[i]);
+    };
+
+    const size_t count = directoryFlags.size();
+    std::vector<uint32_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        int result = key(a).compare(key(b));
+        return result != 0 ? result < 0 : a < b;
+    });
+
+    listing.names.reserve(packed.size());
+    listing.offsets.reserve(count + 1);
+    listing.isDirectory.reserve(count);
+    for (uint32_t i : order) {
+        listing.offsets.push_back(static_cast<uint32_t>(listing.names.size()));
+        listing.names.append(packed, starts[i], starts[i + 1] - starts[i]);
+        listing.isDirectory.push_back(directoryFlags[i]);
+    }
+    listing.offsets.push_back(static_cast<uint32_t>(listing.names.size()));
+    return true;
+}
+
+// Completion Engine Implementation
+CompletionEngine::CompletionEngine(Shell* shell) : shell(shell) {
+    if (shell && shell->getConfigManager()) {
+        pathCompleter.setCaseSensitive(shell->getConfigManager()->getBool(ConfigSetting::CaseSensitive));
+    }
+    commandCompleter.start();
+    lastRefresh = std::chrono::steady_clock::now();
+}
+
+void CompletionEngine::refresh() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastRefresh >= REFRESH_INTERVAL) {
+        lastRefresh = now;
+        commandCompleter.requestRefresh();
+    }
+}
+
+CompletionResult CompletionEngine::complete(const std::string& line, size_t cursor) {
+    CompletionResult result;
+    cursor = std::min(cursor, line.size());
+
+    size_t start = cursor;
+    while (start > 0 && line[start - 1] != ' ' && line[start - 1] != '\t') {
+        --start;
+    }
+    result.start = start;
+    result.end = cursor;
+
+    // The first word of a command (after a separator) names the command
+    size_t previous = start;
+    while (previous > 0 && (line[previous - 1] == ' ' || line[previous - 1] == '\t')) {
+        --previous;
+    }
+    bool commandPosition = previous == 0 || line[previous - 1] == '|' ||
+                           line[previous - 1] == ';' || line[previous - 1] == '&';
+
+    std::string word = line.substr(start, cursor - start);
+    if (commandPosition && word.find('/') == std::string::npos) {
+        completeCommand(word, result.candidates);
+    } else {
+        // cd and pushd only ever want directories
+        size_t commandStart = line.find_first_not_of(" \t");
+        commandStart = commandStart == std::string::npos ? 0 : commandStart;
+        bool directoriesOnly = line.compare(commandStart, 3, "cd ") == 0 || line.compare(commandStart, 6, "pushd ") == 0;
+        const std::string& cwd = shell ? shell->getCurrentDirectory() : std::string(".");
+        pathCompleter.complete(word, cwd, result.candidates, MAX_CANDIDATES, directoriesOnly);
+        result.ignoreCase = !pathCompleter.isCaseSensitive();
+    }
+    return result;
+}
+
+CommandKind CompletionEngine::classifyCommand(const std::string& name) const {
+    if (CommandExecutor::isBuiltinCommand(name)) {
+        return CommandKind::Builtin;
+    }
+    if (shell && shell->getPluginManager() && shell->getPluginManager()->isPluginCommand(name)) {
+        return CommandKind::Plugin;
+    }
+
+    // Paths are checked directly; bare names come from the PATH index
+    if (name.find('/') != std::string::npos) {
+        struct stat st;
+        std::string path = Utils::expandPath(name);
+        bool runnable = stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) && access(path.c_str(), X_OK) == 0;
+        return runnable ? CommandKind::Executable : CommandKind::Unknown;
+    }
+    return commandCompleter.isExecutable(name) ? CommandKind::Executable : CommandKind::Unknown;
+}
+
+void CompletionEngine::completeCommand(const std::string& prefix, std::vector<std::string>& out) {
+    for (const auto& builtin : CommandExecutor::getBuiltinCommands()) {
+        if (builtin.compare(0, prefix.size(), prefix) == 0) {
+            out.push_back(builtin);
+        }
+    }
+
+    if (shell && shell->getPluginManager()) {
+        for (const auto& name : shell->getPluginManager()->getCommandNames()) {
+            if (name.compare(0, prefix.size(), prefix) == 0) {
+                out.push_back(name);
+            }
+        }
+    }
+
+    commandCompleter.complete(prefix, out, MAX_CANDIDATES);
+
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
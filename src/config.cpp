@@ -1,39 +1,25 @@
 #include "config.h"
+#include "config_writer.h"
 #include "utils.h"
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <algorithm>
+#include <iterator>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <pwd.h>
 
-// Color constants
-namespace Colors {
-    const std::string RESET = "\033[0m";
-    const std::string BLACK = "\033[30m";
-    const std::string RED = "\033[31m";
-    const std::string GREEN = "\033[32m";
-    const std::string YELLOW = "\033[33m";
-    const std::string BLUE = "\033[34m";
-    const std::string MAGENTA = "\033[35m";
-    const std::string CYAN = "\033[36m";
-    const std::string WHITE = "\033[37m";
-    const std::string BRIGHT_BLACK = "\033[90m";
-    const std::string BRIGHT_RED = "\033[91m";
-    const std::string BRIGHT_GREEN = "\033[92m";
-    const std::string BRIGHT_YELLOW = "\033[93m";
-    const std::string BRIGHT_BLUE = "\033[94m";
-    const std::string BRIGHT_MAGENTA = "\033[95m";
-    const std::string BRIGHT_CYAN = "\033[96m";
-    const std::string BRIGHT_WHITE = "\033[97m";
-}
-
-ConfigManager::ConfigManager() {
+namespace {
+    // Writes the watcher may still report back; the writer coalesces bursts,
+    // so few of them ever reach the disk
+    const size_t UNCONFIRMED_WRITES = 16;
+}
+
+ConfigManager::ConfigManager() : dirtyFiles(0), writer(std::make_unique<ConfigWriter>()) {
     initializePaths();
     createConfigDirectory();
     
-    themeManager = std::make_unique<ThemeManager>(this);
     aliasManager = std::make_unique<AliasManager>(this);
     
     // Load configuration or create defaults
@@ -43,7 +29,10 @@ ConfigManager::ConfigManager() {
     }
 }
 
-ConfigManager::~ConfigManager() = default;
+ConfigManager::~ConfigManager() {
+    // The writer finishes anything still pending as it goes away
+    persistChanges();
+}
 
 void ConfigManager::initializePaths() {
     const char* home = getenv("HOME");
@@ -52,7 +41,8 @@ void ConfigManager::initializePaths() {
         home = pw ? pw->pw_dir : "/tmp";
     }
     
-    configDirPath = std::string(home) + "/.lynx";
+    homeDirPath = home;
+    configDirPath = homeDirPath + "/.lynx";
     configFilePath = configDirPath + "/config";
 }
 
@@ -66,14 +56,28 @@ void ConfigManager::createConfigDirectory() {
 }
 
 bool ConfigManager::loadConfig() {
+    std::unordered_map<std::string, std::string> loaded;
+    if (!readConfigFile(loaded)) {
+        return false;
+    }
+    settings = std::move(loaded);
+    unconfirmedSettings.assign(1, settings);
+    parseSettings();
+    
+    // Load aliases
+    aliasManager->loadAliases();
+    aliasManager->loadFunctions();
+    
+    return true;
+}
+
+bool ConfigManager::readConfigFile(std::unordered_map<std::string, std::string>& out) const {
     std::ifstream file(configFilePath);
     if (!file.is_open()) {
         return false;
     }
     
-    settings.clear();
     std::string line;
-    
     while (std::getline(file, line)) {
         line = Utils::trim(line);
         
@@ -84,63 +88,116 @@ bool ConfigManager::loadConfig() {
         
         auto pair = parseLine(line);
         if (!pair.first.empty()) {
-            settings[pair.first] = pair.second;
+            out[pair.first] = pair.second;
         }
     }
-    
-    file.close();
-    
-    // Load theme and aliases
-    themeManager->loadTheme(getSetting("theme", "default"));
-    aliasManager->loadAliases();
-    aliasManager->loadFunctions();
-    
     return true;
 }
 
+void ConfigManager::replaceSettings(std::unordered_map<std::string, std::string> newSettings) {
+    settings = std::move(newSettings);
+    unconfirmedSettings.assign(1, settings);
+    dirtyFiles &= ~SettingsFile;
+    parseSettings();
+}
+
+void ConfigManager::parseSettings() {
+    // A value the schema rejects is left in the file but not used
+    for (size_t i = 0; i < ConfigSchema::COUNT; ++i) {
+        ConfigSetting setting = static_cast<ConfigSetting>(i);
+        const ConfigSchema::Spec& spec = ConfigSchema::spec(setting);
+        auto it = settings.find(spec.key);
+        std::string error;
+        if (it == settings.end() || !ConfigSchema::parse(setting, it->second, values[i], error)) {
+            if (!error.empty()) {
+                std::cerr << "lynx: config: " << spec.key << ": " << error
+                          << "; using " << spec.defaultValue << std::endl;
+            }
+            values[i] = ConfigSchema::defaultValue(setting);
+        }
+    }
+}
+
 bool ConfigManager::saveConfig() {
-    std::ofstream file(configFilePath);
-    if (!file.is_open()) {
+    persistChanges();
+    return writer->flush();
+}
+
+void ConfigManager::persistChanges() {
+    if (!dirtyFiles) {
+        return;
+    }
+    if (dirtyFiles & SettingsFile) {
+        writer->submit(configFilePath, renderConfigFile());
+        unconfirmedSettings.push_back(settings);
+        if (unconfirmedSettings.size() > UNCONFIRMED_WRITES) {
+            unconfirmedSettings.pop_front();
+        }
+    }
+    if (dirtyFiles & AliasFile) {
+        writer->submit(aliasManager->getAliasFilePath(), aliasManager->renderAliasFile());
+    }
+    if (dirtyFiles & FunctionFile) {
+        writer->submit(aliasManager->getFunctionFilePath(), aliasManager->renderFunctionFile());
+    }
+    dirtyFiles = 0;
+}
+
+bool ConfigManager::isOwnWrite(const std::unordered_map<std::string, std::string>& fileSettings) {
+    auto match = std::find(unconfirmedSettings.rbegin(), unconfirmedSettings.rend(), fileSettings);
+    if (match == unconfirmedSettings.rend()) {
         return false;
     }
     
-    file << "# Lynx Shell Configuration File\n";
-    file << "# Generated automatically - you can edit this file\n\n";
+    // Writes submitted before this one are already overwritten on disk
+    unconfirmedSettings.erase(unconfirmedSettings.begin(), std::prev(match.base()));
+    return true;
+}
+
+std::string ConfigManager::renderConfigFile() const {
+    std::vector<std::pair<std::string, std::string>> sorted(settings.begin(), settings.end());
+    std::sort(sorted.begin(), sorted.end());
     
-    // Write all settings
-    for (const auto& pair : settings) {
-        file << pair.first << "=" << pair.second << "\n";
+    std::string contents = "# Lynx Shell Configuration File\n"
+                           "# Generated automatically - you can edit this file\n\n";
+    for (const auto& [key, value] : sorted) {
+        // Quoted when the value would not survive trimming on the way back in
+        contents += key;
+        contents += '=';
+        bool quote = !value.empty() && (value != Utils::trim(value) || value.front() == '"' || value.front() == '\'');
+        if (quote) contents += '"';
+        contents += value;
+        if (quote) contents += '"';
+        contents += '\n';
     }
-    
-    file.close();
-    
-    // Save theme and aliases
-    aliasManager->saveAliases();
-    aliasManager->saveFunctions();
-    
-    return true;
+    return contents;
 }
 
 bool ConfigManager::createDefaultConfig() {
-    // Default settings
-    setSetting("theme", "default");
-    setSetting("prompt_format", "{user}@{host}:{cwd}$ ");
-    setSetting("history_size", "1000");
-    setSetting("auto_cd", "true");
-    setSetting("case_sensitive", "false");
-    setSetting("tab_completion", "true");
-    setSetting("color_output", "true");
-    setSetting("welcome_message", "Welcome to Lynx Shell! Type 'help' for commands.");
-    setSetting("exit_on_eof", "true");
-    setSetting("command_timeout", "30");
+    for (size_t i = 0; i < ConfigSchema::COUNT; ++i) {
+        const ConfigSchema::Spec& spec = ConfigSchema::spec(static_cast<ConfigSetting>(i));
+        setSetting(spec.key, spec.defaultValue);
+    }
     
+    markDirty(SettingsFile | AliasFile | FunctionFile);
     return saveConfig();
 }
 
-void ConfigManager::setSetting(const std::string& key, const std::string& value) {
-    if (validateSetting(key, value)) {
-        settings[key] = value;
+bool ConfigManager::setSetting(const std::string& key, const std::string& value, std::string& error) {
+    ConfigSetting setting;
+    if (ConfigSchema::find(key, setting)) {
+        ConfigSchema::Value parsed;
+        if (!ConfigSchema::parse(setting, value, parsed, error)) {
+            return false;
+        }
+        values[static_cast<size_t>(setting)] = std::move(parsed);
     }
+    auto [it, inserted] = settings.try_emplace(key, value);
+    if (inserted || it->second != value) {
+        it->second = value;
+        dirtyFiles |= SettingsFile;
+    }
+    return true;
 }
 
 std::string ConfigManager::getSetting(const std::string& key, const std::string& defaultValue) {
@@ -153,10 +210,21 @@ bool ConfigManager::hasSetting(const std::string& key) {
 }
 
 void ConfigManager::removeSetting(const std::string& key) {
-    settings.erase(key);
+    if (settings.erase(key)) {
+        dirtyFiles |= SettingsFile;
+    }
+    ConfigSetting setting;
+    if (ConfigSchema::find(key, setting)) {
+        values[static_cast<size_t>(setting)] = ConfigSchema::defaultValue(setting);
+    }
 }
 
 int ConfigManager::getIntSetting(const std::string& key, int defaultValue) {
+    ConfigSetting setting;
+    if (ConfigSchema::find(key, setting) && ConfigSchema::spec(setting).type == ConfigSchema::Type::Int) {
+        return getInt(setting);
+    }
+    
     std::string value = getSetting(key);
     if (value.empty()) return defaultValue;
     
@@ -168,6 +236,11 @@ int ConfigManager::getIntSetting(const std::string& key, int defaultValue) {
 }
 
 bool ConfigManager::getBoolSetting(const std::string& key, bool defaultValue) {
+    ConfigSetting setting;
+    if (ConfigSchema::find(key, setting) && ConfigSchema::spec(setting).type == ConfigSchema::Type::Bool) {
+        return getBool(setting);
+    }
+    
     std::string value = getSetting(key);
     if (value.empty()) return defaultValue;
     
@@ -182,62 +255,22 @@ std::vector<std::string> ConfigManager::getListSetting(const std::string& key) {
     return Utils::split(value, ',');
 }
 
-bool ConfigManager::validateSetting(const std::string& key, const std::string& value) {
-    // Add validation rules here
-    if (key == "history_size") {
-        try {
-            int size = std::stoi(value);
-            return size >= 0 && size <= 10000;
-        } catch (const std::exception&) {
-            return false;
-        }
-    }
-    
-    if (key == "command_timeout") {
-        try {
-            int timeout = std::stoi(value);
-            return timeout >= 0 && timeout <= 3600;
-        } catch (const std::exception&) {
-            return false;
-        }
-    }
-    
-    // Most settings are valid by default
-    return true;
-}
-
-std::pair<std::string, std::string> ConfigManager::parseLine(const std::string& line) {
-    size_t pos = line.find('=');
-    if (pos == std::string::npos) {
+std::pair<std::string, std::string> ConfigManager::parseLine(const std::string& line) const {
+    std::string key;
+    std::string value;
+    if (!ConfigSchema::splitLine(line, key, value)) {
         return {"", ""};
     }
     
-    std::string key = Utils::trim(line.substr(0, pos));
-    std::string value = Utils::trim(line.substr(pos + 1));
-    
-    // Remove quotes if present
-    if (value.length() >= 2 && 
-        ((value.front() == '"' && value.back() == '"') ||
-         (value.front() == '\'' && value.back() == '\''))) {
-        value = value.substr(1, value.length() - 2);
-    }
-    
     // Expand environment variables
-    value = expandPath(value);
-    
-    return {key, value};
+    return {key, expandPath(value)};
 }
 
-std::string ConfigManager::expandPath(const std::string& path) {
-    std::string result = path;
-    
-    // Replace ~ with home directory
-    if (result.front() == '~') {
-        const char* home = getenv("HOME");
-        if (home) {
-            result = std::string(home) + result.substr(1);
-        }
+std::string ConfigManager::expandPath(const std::string& path) const {
+    // Replace ~ with the home directory found at startup; the environment
+    // is not read here since the config may be parsed off the main thread
+    if (!path.empty() && path.front() == '~') {
+        return homeDirPath + path.substr(1);
     }
-    
-    return result;
+    return path;
 }
\ No newline at end of file
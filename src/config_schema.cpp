@@ -0,0 +1,171 @@
+#include "config_schema.h"
+#include "utils.h"
+#include <fstream>
+#include <unordered_map>
+#include <charconv>
+#include <strings.h>
+
+namespace {
+    using ConfigSchema::Type;
+
+    // In ConfigSetting order
+    const ConfigSchema::Spec SPECS[ConfigSchema::COUNT] = {
+        {"theme", Type::String, "default", 0, 0, "Color theme"},
+        {"prompt_format", Type::String, "{user}@{host}:{cwd}$ ", 0, 0, "Prompt layout for themes in the original format"},
+        {"history_size", Type::Int, "1000", 0, 10000, "Number of commands to remember"},
+        {"auto_cd", Type::Bool, "true", 0, 0, "Change directory without typing 'cd'"},
+        {"case_sensitive", Type::Bool, "false", 0, 0, "Case-sensitive completion"},
+        {"tab_completion", Type::Bool, "true", 0, 0, "Enable tab completion"},
+        {"syntax_highlighting", Type::Bool, "true", 0, 0, "Highlight the input line"},
+        {"autosuggestions", Type::Bool, "true", 0, 0, "Suggest the rest of the line from history"},
+        {"autosuggest_budget_ms", Type::Int, "2", 1, 1000, "Time a suggestion may take"},
+        {"track_directories", Type::Bool, "true", 0, 0, "Record directories for z/j jumping"},
+        {"auto_reload", Type::Bool, "true", 0, 0, "Apply edits to the config files without restarting"},
+        {"color_output", Type::Bool, "true", 0, 0, "Colorize output"},
+        {"show_welcome", Type::Bool, "true", 0, 0, "Show the welcome message at startup"},
+        {"welcome_message", Type::String, "Welcome to Lynx Shell! Type 'help' for commands.", 0, 0, "Message shown at startup"},
+        {"exit_on_eof", Type::Bool, "true", 0, 0, "Exit on Ctrl+D"},
+        {"command_timeout", Type::Int, "30", 0, 3600, "Timeout for commands in seconds"},
+        {"plugin_budget_ms", Type::Int, "50", 0, 60000, "Warn when a plugin event handler takes longer (0 = off)"},
+        {"plugin_auto_reload", Type::Bool, "false", 0, 0, "Reload a plugin when its library is rebuilt"}
+    };
+
+    const char* typeName(Type type) {
+        switch (type) {
+            case Type::Bool: return "bool";
+            case Type::Int: return "int";
+            case Type::String: return "string";
+        }
+        return "";
+    }
+}
+
+// Config Schema Implementation
+namespace ConfigSchema {
+    const Spec& spec(ConfigSetting setting) {
+        return SPECS[static_cast<size_t>(setting)];
+    }
+
+    bool find(std::string_view key, ConfigSetting& setting) {
+        for (size_t i = 0; i < COUNT; ++i) {
+            if (key == SPECS[i].key) {
+                setting = static_cast<ConfigSetting>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool parse(ConfigSetting setting, std::string_view text, Value& value, std::string& error) {
+        const Spec& info = spec(setting);
+        switch (info.type) {
+            case Type::Bool: {
+                std::string word(text);
+                if (strcasecmp(word.c_str(), "true") == 0 || strcasecmp(word.c_str(), "yes") == 0 ||
+                    strcasecmp(word.c_str(), "on") == 0 || word == "1") {
+                    value.enabled = true;
+                } else if (strcasecmp(word.c_str(), "false") == 0 || strcasecmp(word.c_str(), "no") == 0 ||
+                           strcasecmp(word.c_str(), "off") == 0 || word == "0") {
+                    value.enabled = false;
+                } else {
+                    error = "expected true or false, got '" + word + "'";
+                    return false;
+                }
+                break;
+            }
+            case Type::Int: {
+                int number = 0;
+                auto [end, result] = std::from_chars(text.data(), text.data() + text.size(), number);
+                if (text.empty() || result != std::errc() || end != text.data() + text.size() ||
+                    number < info.minimum || number > info.maximum) {
+                    error = "expected a whole number from " + std::to_string(info.minimum) + " to " +
+                            std::to_string(info.maximum) + ", got '" + std::string(text) + "'";
+                    return false;
+                }
+                value.number = number;
+                break;
+            }
+            case Type::String:
+                break;
+        }
+        value.text = text;
+        return true;
+    }
+
+    Value defaultValue(ConfigSetting setting) {
+        Value value;
+        std::string error;
+        parse(setting, spec(setting).defaultValue, value, error);
+        return value;
+    }
+
+    bool splitLine(const std::string& line, std::string& key, std::string& value) {
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            return false;
+        }
+        key = Utils::trim(line.substr(0, equals));
+        value = Utils::trim(line.substr(equals + 1));
+        if (value.size() >= 2 && (value.front() == '"' || value.front() == '\'') && value.back() == value.front()) {
+            value = value.substr(1, value.size() - 2);
+        }
+        return true;
+    }
+
+    int checkFile(const std::string& path, std::ostream& out) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            out << path << ": cannot be read" << std::endl;
+            return 1;
+        }
+
+        int errors = 0;
+        std::unordered_map<std::string, size_t> seen;
+        std::string line;
+        for (size_t number = 1; std::getline(file, line); ++number) {
+            line = Utils::trim(line);
+            if (line.empty() || line[0] == '#' || line[0] == ';') {
+                continue;
+            }
+            std::string where = path + ":" + std::to_string(number) + ": ";
+
+            std::string key;
+            std::string text;
+            if (!splitLine(line, key, text)) {
+                out << where << "warning: not a key=value line, ignored" << std::endl;
+                continue;
+            }
+
+            auto [previous, first] = seen.emplace(key, number);
+            if (!first) {
+                out << where << "warning: " << key << " was already set on line " << previous->second
+                    << "; this value wins" << std::endl;
+                previous->second = number;
+            }
+
+            ConfigSetting setting;
+            if (!find(key, setting)) {
+                out << where << "note: unknown key " << key << ", kept for plugins" << std::endl;
+                continue;
+            }
+            Value value;
+            std::string error;
+            if (!parse(setting, text, value, error)) {
+                out << where << "error: " << key << ": " << error << std::endl;
+                ++errors;
+            }
+        }
+        return errors;
+    }
+
+    void describe(std::ostream& out) {
+        for (const auto& info : SPECS) {
+            out << info.key << " (" << typeName(info.type);
+            if (info.type == Type::Int) {
+                out << ", " << info.minimum << "-" << info.maximum;
+            }
+            out << ", default " << info.defaultValue << ")" << std::endl;
+            out << "    " << info.description << std::endl;
+        }
+    }
+}
@@ -0,0 +1,172 @@
+#include "config_watcher.h"
+#include "config.h"
+#include "theme_manager.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <strings.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+
+namespace {
+    // Editors save in several steps; events closer together than this are
+    // handled as one change
+    const int SETTLE_MS = 50;
+
+    const uint32_t WATCH_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE;
+
+    bool openPipe(int fds[2]) {
+        if (pipe(fds) != 0) {
+            return false;
+        }
+        for (int i = 0; i < 2; ++i) {
+            fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+        }
+        return true;
+    }
+
+    bool isThemeFile(const char* name) {
+        const char* dot = std::strrchr(name, '.');
+        return dot && (strcasecmp(dot, ".theme") == 0 || strcasecmp(dot, ".json") == 0 ||
+                       strcasecmp(dot, ".ini") == 0);
+    }
+}
+#endif
+
+// Config Watcher Implementation
+ConfigWatcher::ConfigWatcher(const ConfigManager* config, const AliasManager* aliases,
+                             const ExternalThemeManager* themes)
+    : config(config), aliases(aliases), themes(themes), inotifyFd(-1), stopPipe{-1, -1},
+      configWatch(-1), ready(false) {}
+
+ConfigWatcher::~ConfigWatcher() {
+    if (worker.joinable()) {
+        char byte = 0;
+        ssize_t ignored = write(stopPipe[1], &byte, 1);
+        (void)ignored;
+        worker.join();
+    }
+    for (int fd : {inotifyFd, stopPipe[0], stopPipe[1]}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+// Only Linux has a backend; elsewhere the shell runs without auto-reload
+bool ConfigWatcher::start() {
+#ifdef __linux__
+    inotifyFd = inotify_init1(IN_CLOEXEC);
+    if (inotifyFd < 0 || !openPipe(stopPipe)) {
+        return false;
+    }
+
+    configWatch = inotify_add_watch(inotifyFd, config->getConfigDir().c_str(), WATCH_EVENTS);
+    for (const auto& path : themes->getThemePaths()) {
+        int watch = inotify_add_watch(inotifyFd, path.c_str(), WATCH_EVENTS);
+        if (watch >= 0) {
+            themeWatches.push_back(watch);
+        }
+    }
+    if (configWatch < 0 && themeWatches.empty()) {
+        return false;
+    }
+
+    worker = std::thread(&ConfigWatcher::run, this);
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::unique_ptr<ConfigWatcher::Snapshot> ConfigWatcher::takeChanges() {
+    if (!ready.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    ready.store(false, std::memory_order_relaxed);
+    return std::move(pending);
+}
+
+void ConfigWatcher::run() {
+#ifdef __linux__
+    alignas(inotify_event) char buffer[4096];
+    while (true) {
+        pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {stopPipe[0], POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (fds[1].revents) {
+            return;
+        }
+
+        bool settings = false, aliasFile = false, functionFile = false, themeFiles = false;
+        do {
+            ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+            if (length <= 0) {
+                if (length < 0 && errno == EINTR) continue;
+                return;
+            }
+            for (ssize_t offset = 0; offset < length;) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                offset += sizeof(inotify_event) + event->len;
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                    settings = aliasFile = functionFile = themeFiles = true;
+                } else if (event->len == 0) {
+                    continue;
+                } else if (event->wd == configWatch) {
+                    settings |= std::strcmp(event->name, "config") == 0;
+                    aliasFile |= std::strcmp(event->name, "aliases") == 0;
+                    functionFile |= std::strcmp(event->name, "functions") == 0;
+                }
+                if (std::find(themeWatches.begin(), themeWatches.end(), event->wd) != themeWatches.end() &&
+                    event->len > 0 && isThemeFile(event->name)) {
+                    themeFiles = true;
+                }
+            }
+            fds[0].revents = 0;
+        } while (poll(fds, 1, SETTLE_MS) > 0);
+
+        if (settings || aliasFile || functionFile || themeFiles) {
+            reload(settings, aliasFile, functionFile, themeFiles);
+        }
+    }
+#endif
+}
+
+void ConfigWatcher::reload(bool settings, bool aliasFile, bool functionFile, bool themeFiles) {
+    // A file that cannot be read, such as one deleted mid-save, leaves the
+    // current values alone
+    Snapshot changes;
+    changes.settingsChanged = settings && config->readConfigFile(changes.settings);
+    changes.aliasesChanged = aliasFile && aliases->readAliasFile(changes.aliases);
+    changes.functionsChanged = functionFile && aliases->readFunctionFile(changes.functions);
+    if (themeFiles) {
+        themes->compileThemes();
+        changes.themesChanged = true;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!pending) {
+        pending = std::make_unique<Snapshot>();
+    }
+    if (changes.settingsChanged) {
+        pending->settingsChanged = true;
+        pending->settings = std::move(changes.settings);
+    }
+    if (changes.aliasesChanged) {
+        pending->aliasesChanged = true;
+        pending->aliases = std::move(changes.aliases);
+    }
+    if (changes.functionsChanged) {
+        pending->functionsChanged = true;
+        pending->functions = std::move(changes.functions);
+    }
+    pending->themesChanged |= changes.themesChanged;
+    ready.store(true, std::memory_order_release);
+}
@@ -0,0 +1,140 @@
+#include "config_writer.h"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Config Writer Implementation
+ConfigWriter::ConfigWriter(std::chrono::milliseconds window) : window(window), longest(window * 4), stopping(false) {}
+
+ConfigWriter::~ConfigWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    flush();
+}
+
+void ConfigWriter::submit(const std::string& path, std::string contents) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto now = std::chrono::steady_clock::now();
+        auto [it, inserted] = pending.try_emplace(path);
+        Pending& entry = it->second;
+        if (inserted) {
+            entry.first = now;
+        }
+        entry.contents = std::move(contents);
+        entry.due = std::min(now + window, entry.first + longest);
+
+        // Started on first use; most sessions never change a setting
+        if (!worker.joinable() && !stopping) {
+            worker = std::thread(&ConfigWriter::run, this);
+        }
+    }
+    wake.notify_one();
+}
+
+bool ConfigWriter::flush() {
+    std::lock_guard<std::mutex> writing(writeMutex);
+    std::map<std::string, Pending> batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batch.swap(pending);
+    }
+    bool written = true;
+    for (const auto& [path, entry] : batch) {
+        written = writeAtomically(path, entry.contents) && written;
+    }
+    return written;
+}
+
+void ConfigWriter::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        if (pending.empty()) {
+            wake.wait(lock);
+            continue;
+        }
+
+        auto next = std::chrono::steady_clock::now() + window;
+        for (const auto& [path, entry] : pending) {
+            next = std::min(next, entry.due);
+        }
+        if (wake.wait_until(lock, next) == std::cv_status::no_timeout) {
+            // A submission pushed a deadline back, or we are stopping
+            continue;
+        }
+
+        lock.unlock();
+        {
+            std::lock_guard<std::mutex> writing(writeMutex);
+            std::vector<std::pair<std::string, std::string>> batch;
+            {
+                std::lock_guard<std::mutex> relock(mutex);
+                auto now = std::chrono::steady_clock::now();
+                for (auto it = pending.begin(); it != pending.end();) {
+                    if (it->second.due <= now) {
+                        batch.emplace_back(it->first, std::move(it->second.contents));
+                        it = pending.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
+            for (const auto& [path, contents] : batch) {
+                if (!writeAtomically(path, contents)) {
+                    std::cerr << "lynx: cannot save " << path << std::endl;
+                }
+            }
+        }
+        lock.lock();
+    }
+}
+
+bool ConfigWriter::writeAtomically(const std::string& path, const std::string& contents) {
+    std::string temporary = path + ".XXXXXX";
+    int fd = mkstemp(temporary.data());
+    if (fd < 0) {
+        return false;
+    }
+
+    // Keep the permissions of the file being replaced
+    struct stat st;
+    fchmod(fd, stat(path.c_str(), &st) == 0 ? (st.st_mode & 07777) : 0644);
+
+    bool written = true;
+    for (size_t offset = 0; offset < contents.size();) {
+        ssize_t count = ::write(fd, contents.data() + offset, contents.size() - offset);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            written = false;
+            break;
+        }
+        offset += static_cast<size_t>(count);
+    }
+    written = written && fsync(fd) == 0;
+    written = ::close(fd) == 0 && written;
+    if (!written || rename(temporary.c_str(), path.c_str()) != 0) {
+        unlink(temporary.c_str());
+        return false;
+    }
+
+    // The rename itself is only durable once the directory is synced
+    std::string directory = std::filesystem::path(path).parent_path().string();
+    int directoryFd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directoryFd >= 0) {
+        fsync(directoryFd);
+        close(directoryFd);
+    }
+    return true;
+}
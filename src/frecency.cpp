@@ -0,0 +1,458 @@
+#include "frecency.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// On-disk layout (host byte order; the file is mapped, not parsed):
+//   Header (64 bytes)
+//   Entry, Entry, ...    each followed by its path and padded to 8 bytes
+//
+// An entry's score is log(sum of 2^((visit - epoch) / half-life)) over its
+// visits. Adding a visit is one log-add on that entry, and since every entry
+// decays at the same rate, comparing stored scores compares current ones.
+struct FrecencyDatabase::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    int64_t epoch;         // time the scores are relative to
+    int64_t lastAged;      // last compaction
+    uint32_t entryBytes;   // bytes of entries after the header
+    uint32_t entryCount;
+    uint32_t updates;      // bumped on every write, so other shells re-sort
+    uint32_t reserved[5];
+};
+
+struct FrecencyDatabase::Entry {
+    double logScore;
+    int64_t lastVisit;
+    uint32_t visits;
+    uint16_t length;
+    uint16_t flags;
+
+    const char* text() const { return reinterpret_cast<const char*>(this + 1); }
+    char* text() { return reinterpret_cast<char*>(this + 1); }
+    std::string_view view() const { return std::string_view(text(), length); }
+};
+
+namespace {
+    const char FRECENCY_MAGIC[8] = {'L', 'Y', 'N', 'X', 'D', 'I', 'R', '\0'};
+    const uint32_t FRECENCY_FORMAT_VERSION = 1;
+
+    // A visit counts half as much after a week
+    const double HALF_LIFE_SECONDS = 7.0 * 24 * 60 * 60;
+    const double DECAY_RATE = std::log(2.0) / HALF_LIFE_SECONDS;
+
+    // Aging drops directories whose decayed score fell below MIN_SCORE, and
+    // the lowest ranked ones beyond MAX_ENTRIES
+    const double MIN_SCORE = 0.01;
+    const size_t MAX_ENTRIES = 50000;
+    const int64_t AGING_INTERVAL_SECONDS = 24 * 60 * 60;
+
+    // The whole reservation is mapped once; the file grows underneath it,
+    // so pointers into the mapping stay valid as entries are appended
+    const size_t RESERVED_BYTES = 64u << 20;
+    const size_t GROW_BYTES = 64u << 10;
+
+    size_t entrySize(size_t length) {
+        return (24 + length + 7) & ~size_t(7);
+    }
+
+    double logAdd(double a, double b) {
+        return a > b ? a + std::log1p(std::exp(b - a)) : b + std::log1p(std::exp(a - b));
+    }
+
+    bool isLowercase(const std::string& term) {
+        return std::none_of(term.begin(), term.end(), [](unsigned char c) { return std::isupper(c); });
+    }
+
+    inline char foldAscii(char c) {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+    }
+
+    size_t findTerm(std::string_view text, const std::string& term, size_t from, bool ignoreCase) {
+        if (!ignoreCase || term.empty()) {
+            return text.find(term, from);
+        }
+        if (term.size() > text.size()) {
+            return std::string_view::npos;
+        }
+        const char first = term[0];
+        for (size_t i = from; i + term.size() <= text.size(); ++i) {
+            if (foldAscii(text[i]) != first) {
+                continue;
+            }
+            size_t j = 1;
+            while (j < term.size() && foldAscii(text[i + j]) == term[j]) {
+                ++j;
+            }
+            if (j == term.size()) {
+                return i;
+            }
+        }
+        return std::string_view::npos;
+    }
+
+    // Set on entries whose directory no longer exists, so queries skip them
+    // without a stat(); a new visit clears it and aging drops them
+    const uint16_t FLAG_MISSING = 0x1;
+}
+
+// Frecency Database Implementation
+FrecencyDatabase::FrecencyDatabase(const std::string& path)
+    : path(path), fd(-1), inode(0), mapping(nullptr), mappedBytes(0), indexedBytes(0), seenUpdates(0) {
+    static_assert(sizeof(Header) == 64, "header layout is part of the file format");
+    static_assert(sizeof(Entry) == 24, "entry layout is part of the file format");
+}
+
+FrecencyDatabase::~FrecencyDatabase() {
+    close();
+}
+
+FrecencyDatabase::Header* FrecencyDatabase::header() const {
+    return reinterpret_cast<Header*>(mapping);
+}
+
+FrecencyDatabase::Entry* FrecencyDatabase::entryAt(uint32_t offset) const {
+    return reinterpret_cast<Entry*>(mapping + sizeof(Header) + offset);
+}
+
+bool FrecencyDatabase::open(bool allowReset) {
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close();
+        return false;
+    }
+    if (static_cast<size_t>(st.st_size) < sizeof(Header)) {
+        // New file: the first shell to get the lock writes the header
+        flock(fd, LOCK_EX);
+        if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) < sizeof(Header)) {
+            Header fresh = {};
+            std::memcpy(fresh.magic, FRECENCY_MAGIC, sizeof(FRECENCY_MAGIC));
+            fresh.version = FRECENCY_FORMAT_VERSION;
+            fresh.headerSize = sizeof(Header);
+            fresh.epoch = std::time(nullptr);
+            fresh.lastAged = fresh.epoch;
+            if (ftruncate(fd, static_cast<off_t>(GROW_BYTES)) != 0 ||
+                pwrite(fd, &fresh, sizeof(fresh), 0) != static_cast<ssize_t>(sizeof(fresh))) {
+                flock(fd, LOCK_UN);
+                close();
+                return false;
+            }
+            fstat(fd, &st);
+        }
+        flock(fd, LOCK_UN);
+    }
+    inode = st.st_ino;
+
+    void* address = mmap(nullptr, RESERVED_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+        close();
+        return false;
+    }
+    mapping = static_cast<unsigned char*>(address);
+    mappedBytes = RESERVED_BYTES;
+
+    const Header* h = header();
+    if (std::memcmp(h->magic, FRECENCY_MAGIC, sizeof(FRECENCY_MAGIC)) != 0 ||
+        h->version != FRECENCY_FORMAT_VERSION || h->headerSize != sizeof(Header) ||
+        sizeof(Header) + h->entryBytes > static_cast<size_t>(st.st_size)) {
+        // Unreadable or from another format version: start over rather
+        // than leave jumping disabled
+        bool reset = allowReset && flock(fd, LOCK_EX) == 0 && ftruncate(fd, 0) == 0;
+        close();
+        return reset && open(false);
+    }
+
+    indexedBytes = 0;
+    seenUpdates = h->updates;
+    indexNewEntries();
+    sortOrder();
+    return true;
+}
+
+void FrecencyDatabase::close() {
+    if (mapping) {
+        munmap(mapping, mappedBytes);
+        mapping = nullptr;
+        mappedBytes = 0;
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    order.clear();
+    index.clear();
+    indexedBytes = 0;
+}
+
+bool FrecencyDatabase::refresh() {
+    // Another shell compacting replaces the file; follow it
+    struct stat st;
+    if (fd >= 0 && (stat(path.c_str(), &st) != 0 || st.st_ino != inode)) {
+        close();
+    }
+    if (fd < 0) {
+        return open();
+    }
+
+    bool resort = header()->updates != seenUpdates;
+    if (header()->entryBytes != indexedBytes) {
+        indexNewEntries();
+        resort = true;
+    }
+    if (resort) {
+        sortOrder();
+        seenUpdates = header()->updates;
+    }
+    return true;
+}
+
+bool FrecencyDatabase::indexNewEntries() {
+    const uint32_t end = header()->entryBytes;
+    while (indexedBytes < end) {
+        if (end - indexedBytes < sizeof(Entry)) {
+            return false;
+        }
+        const Entry* entry = entryAt(indexedBytes);
+        size_t size = entrySize(entry->length);
+        if (size > end - indexedBytes) {
+            return false;
+        }
+        index.emplace(entry->view(), indexedBytes);
+        order.push_back(indexedBytes);
+        indexedBytes += static_cast<uint32_t>(size);
+    }
+    return true;
+}
+
+void FrecencyDatabase::sortOrder() {
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        return entryAt(a)->logScore > entryAt(b)->logScore;
+    });
+}
+
+void FrecencyDatabase::recordVisit(const std::string& directory) {
+    recordVisit(directory, static_cast<int64_t>(std::time(nullptr)));
+}
+
+void FrecencyDatabase::recordVisit(const std::string& directory, int64_t timestamp) {
+    if (directory.empty() || directory.size() > UINT16_MAX) {
+        return;
+    }
+
+    // Lock the file we have mapped, making sure it was not replaced while we
+    // waited for the lock
+    for (int attempt = 0;; ++attempt) {
+        if (attempt == 3 || !refresh()) {
+            return;
+        }
+        flock(fd, LOCK_EX);
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0 && st.st_ino == inode) {
+            break;
+        }
+        flock(fd, LOCK_UN);
+        close();
+    }
+    refresh();
+
+    Header* h = header();
+    double visitScore = DECAY_RATE * static_cast<double>(timestamp - h->epoch);
+    auto found = index.find(directory);
+    if (found != index.end()) {
+        // Only this entry's score moves, and only upwards
+        Entry* entry = entryAt(found->second);
+        entry->logScore = logAdd(entry->logScore, visitScore);
+        entry->lastVisit = std::max(entry->lastVisit, timestamp);
+        entry->visits++;
+        entry->flags &= static_cast<uint16_t>(~FLAG_MISSING);
+
+        auto position = std::find(order.begin(), order.end(), found->second);
+        auto target = std::upper_bound(order.begin(), position, entry->logScore,
+                                       [this](double score, uint32_t offset) {
+                                           return score > entryAt(offset)->logScore;
+                                       });
+        std::rotate(target, position, position + 1);
+    } else {
+        appendEntry(directory, visitScore, timestamp);
+    }
+    h->updates++;
+    seenUpdates = h->updates;
+
+    if (order.size() > MAX_ENTRIES || timestamp - h->lastAged >= AGING_INTERVAL_SECONDS) {
+        compact(timestamp);
+    }
+    if (fd >= 0) {
+        flock(fd, LOCK_UN);
+    }
+}
+
+bool FrecencyDatabase::appendEntry(const std::string& directory, double logScore, int64_t timestamp) {
+    Header* h = header();
+    size_t size = entrySize(directory.size());
+    size_t needed = sizeof(Header) + h->entryBytes + size;
+    if (needed > mappedBytes) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return false;
+    }
+    if (needed > static_cast<size_t>(st.st_size)) {
+        size_t grown = (needed + GROW_BYTES - 1) / GROW_BYTES * GROW_BYTES;
+        if (ftruncate(fd, static_cast<off_t>(grown)) != 0) {
+            return false;
+        }
+    }
+
+    // Fill the entry before publishing it through entryBytes
+    uint32_t offset = h->entryBytes;
+    Entry* entry = entryAt(offset);
+    std::memset(static_cast<void*>(entry), 0, size);
+    entry->logScore = logScore;
+    entry->lastVisit = timestamp;
+    entry->visits = 1;
+    entry->length = static_cast<uint16_t>(directory.size());
+    std::memcpy(entry->text(), directory.data(), directory.size());
+    h->entryBytes = offset + static_cast<uint32_t>(size);
+    h->entryCount++;
+
+    index.emplace(entry->view(), offset);
+    auto target = std::upper_bound(order.begin(), order.end(), logScore, [this](double score, uint32_t other) {
+        return score > entryAt(other)->logScore;
+    });
+    order.insert(target, offset);
+    indexedBytes = h->entryBytes;
+    return true;
+}
+
+bool FrecencyDatabase::compact(int64_t now) {
+    // Rebase scores on the current time, drop what has decayed away, and
+    // write the survivors in rank order to a new file
+    const Header* h = header();
+    double shift = DECAY_RATE * static_cast<double>(now - h->epoch);
+    double minLogScore = std::log(MIN_SCORE);
+    size_t keep = order.size() > MAX_ENTRIES ? MAX_ENTRIES * 9 / 10 : order.size();
+
+    Header fresh = {};
+    std::memcpy(fresh.magic, FRECENCY_MAGIC, sizeof(FRECENCY_MAGIC));
+    fresh.version = FRECENCY_FORMAT_VERSION;
+    fresh.headerSize = sizeof(Header);
+    fresh.epoch = now;
+    fresh.lastAged = now;
+
+    std::string data;
+    data.resize(sizeof(Header));
+    for (size_t i = 0; i < order.size() && fresh.entryCount < keep; ++i) {
+        const Entry* entry = entryAt(order[i]);
+        double logScore = entry->logScore - shift;
+        if (logScore < minLogScore) {
+            break;  // everything after ranks lower still
+        }
+        if (entry->flags & FLAG_MISSING) {
+            continue;
+        }
+        size_t size = entrySize(entry->length);
+        size_t at = data.size();
+        data.resize(at + size);
+        std::memcpy(&data[at], entry, size);
+        reinterpret_cast<Entry*>(&data[at])->logScore = logScore;
+        fresh.entryCount++;
+    }
+    fresh.entryBytes = static_cast<uint32_t>(data.size() - sizeof(Header));
+    std::memcpy(&data[0], &fresh, sizeof(fresh));
+    data.resize((data.size() + GROW_BYTES - 1) / GROW_BYTES * GROW_BYTES);
+
+    std::string tempPath = path + ".tmp";
+    int out = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) {
+        return false;
+    }
+    bool written = write(out, data.data(), data.size()) == static_cast<ssize_t>(data.size());
+    written = fsync(out) == 0 && written;
+    ::close(out);
+    if (!written || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        unlink(tempPath.c_str());
+        return false;
+    }
+
+    // Shells waiting on the old file's lock notice the new inode and reopen
+    flock(fd, LOCK_UN);
+    close();
+    return open();
+}
+
+bool FrecencyDatabase::matches(const Entry& entry, const std::vector<std::string>& terms, bool ignoreCase) const {
+    std::string_view text = entry.view();
+    size_t lastComponent = text.rfind('/');
+    lastComponent = lastComponent == std::string_view::npos ? 0 : lastComponent + 1;
+
+    size_t pos = 0;
+    for (size_t i = 0; i < terms.size(); ++i) {
+        size_t from = i + 1 == terms.size() ? std::max(pos, lastComponent) : pos;
+        size_t found = findTerm(text, terms[i], from, ignoreCase);
+        if (found == std::string_view::npos) {
+            return false;
+        }
+        pos = found + terms[i].size();
+    }
+    return true;
+}
+
+bool FrecencyDatabase::query(const std::vector<std::string>& terms, const std::string& exclude, std::string& result) {
+    if (!refresh()) {
+        return false;
+    }
+    bool ignoreCase = std::all_of(terms.begin(), terms.end(), isLowercase);
+
+    // Rank order means the first usable match is the answer
+    for (uint32_t offset : order) {
+        Entry* entry = entryAt(offset);
+        if ((entry->flags & FLAG_MISSING) || entry->view() == exclude || !matches(*entry, terms, ignoreCase)) {
+            continue;
+        }
+        std::string candidate(entry->view());
+        struct stat st;
+        bool exists = stat(candidate.c_str(), &st) == 0;
+        if (exists && S_ISDIR(st.st_mode)) {
+            result = std::move(candidate);
+            return true;
+        }
+        if (exists || errno == ENOENT || errno == ENOTDIR) {
+            entry->flags |= FLAG_MISSING;
+        }
+    }
+    return false;
+}
+
+std::vector<FrecencyDatabase::Match> FrecencyDatabase::list(const std::vector<std::string>& terms, size_t limit) {
+    std::vector<Match> results;
+    if (!refresh()) {
+        return results;
+    }
+    bool ignoreCase = std::all_of(terms.begin(), terms.end(), isLowercase);
+    double shift = DECAY_RATE * static_cast<double>(std::time(nullptr) - header()->epoch);
+
+    for (uint32_t offset : order) {
+        if (results.size() >= limit) break;
+        const Entry* entry = entryAt(offset);
+        if (!(entry->flags & FLAG_MISSING) && matches(*entry, terms, ignoreCase)) {
+            results.push_back({std::string(entry->view()), std::exp(entry->logScore - shift), entry->lastVisit});
+        }
+    }
+    return results;
+}
@@ -0,0 +1,485 @@
+#include "git_status.h"
+#include "utils.h"
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+    // Discovery results kept before the cache is dropped and rebuilt
+    const size_t MAX_CACHED_DIRECTORIES = 256;
+
+    const size_t SHA1_SIZE = 20;
+
+    // Index entry flags
+    const uint16_t FLAG_ASSUME_VALID = 0x8000;
+    const uint16_t FLAG_EXTENDED = 0x4000;
+    const uint16_t FLAG_STAGE_MASK = 0x3000;
+    const uint16_t EXTENDED_SKIP_WORKTREE = 0x4000;
+
+    const uint32_t MODE_TYPE_MASK = 0170000;
+    const uint32_t MODE_GITLINK = 0160000;
+    const uint32_t MODE_SYMLINK = 0120000;
+
+    /**
+     * Minimal SHA-1, used only to hash work tree files the way git hashes
+     * blobs so touched-but-unchanged files are not reported as dirty
+     */
+    class Sha1 {
+    public:
+        Sha1() : length(0), buffered(0) {
+            state[0] = 0x67452301;
+            state[1] = 0xEFCDAB89;
+            state[2] = 0x98BADCFE;
+            state[3] = 0x10325476;
+            state[4] = 0xC3D2E1F0;
+        }
+
+        void update(const unsigned char* data, size_t size) {
+            length += size;
+            while (size > 0) {
+                size_t take = std::min(size, sizeof(block) - buffered);
+                std::memcpy(block + buffered, data, take);
+                buffered += take;
+                data += take;
+                size -= take;
+                if (buffered == sizeof(block)) {
+                    transform();
+                    buffered = 0;
+                }
+            }
+        }
+
+        void finish(unsigned char digest[SHA1_SIZE]) {
+            uint64_t bits = length * 8;
+            unsigned char padding = 0x80;
+            update(&padding, 1);
+            padding = 0;
+            while (buffered != 56) {
+                update(&padding, 1);
+            }
+            unsigned char lengthBytes[8];
+            for (int i = 0; i < 8; ++i) {
+                lengthBytes[i] = static_cast<unsigned char>(bits >> (56 - 8 * i));
+            }
+            update(lengthBytes, 8);
+            for (int i = 0; i < 5; ++i) {
+                for (int j = 0; j < 4; ++j) {
+                    digest[i * 4 + j] = static_cast<unsigned char>(state[i] >> (24 - 8 * j));
+                }
+            }
+        }
+
+    private:
+        uint32_t state[5];
+        uint64_t length;
+        unsigned char block[64];
+        size_t buffered;
+
+        static uint32_t rotate(uint32_t value, int bits) {
+            return (value << bits) | (value >> (32 - bits));
+        }
+
+        void transform() {
+            uint32_t w[80];
+            for (int i = 0; i < 16; ++i) {
+                w[i] = (uint32_t(block[i * 4]) << 24) | (uint32_t(block[i * 4 + 1]) << 16) |
+                       (uint32_t(block[i * 4 + 2]) << 8) | uint32_t(block[i * 4 + 3]);
+            }
+            for (int i = 16; i < 80; ++i) {
+                w[i] = rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+            }
+
+            uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+            for (int i = 0; i < 80; ++i) {
+                uint32_t f, k;
+                if (i < 20) {
+                    f = (b & c) | (~b & d);
+                    k = 0x5A827999;
+                } else if (i < 40) {
+                    f = b ^ c ^ d;
+                    k = 0x6ED9EBA1;
+                } else if (i < 60) {
+                    f = (b & c) | (b & d) | (c & d);
+                    k = 0x8F1BBCDC;
+                } else {
+                    f = b ^ c ^ d;
+                    k = 0xCA62C1D6;
+                }
+                uint32_t next = rotate(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = rotate(b, 30);
+                b = a;
+                a = next;
+            }
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+        }
+    };
+
+    uint32_t readBigEndian32(const unsigned char* p) {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+
+    uint16_t readBigEndian16(const unsigned char* p) {
+        return static_cast<uint16_t>((p[0] << 8) | p[1]);
+    }
+
+    bool readSmallFile(const std::string& path, std::string& contents) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        char buffer[4096];
+        ssize_t count = read(fd, buffer, sizeof(buffer));
+        close(fd);
+        if (count < 0) {
+            return false;
+        }
+        contents.assign(buffer, static_cast<size_t>(count));
+        while (!contents.empty() && (contents.back() == '\n' || contents.back() == '\r' || contents.back() == ' ')) {
+            contents.pop_back();
+        }
+        return true;
+    }
+
+    int64_t modificationTime(const std::string& path, int64_t* size = nullptr) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) {
+            return -1;
+        }
+        if (size) {
+            *size = static_cast<int64_t>(st.st_size);
+        }
+        return Utils::getModificationTimeNs(st);
+    }
+
+    // Hashes a work tree file as a git blob and compares it with the index
+    bool blobMatches(const std::string& path, const struct stat& st, const unsigned char* expected) {
+        std::string header = "blob " + std::to_string(static_cast<long long>(st.st_size));
+        header.push_back('\0');
+        Sha1 sha;
+        sha.update(reinterpret_cast<const unsigned char*>(header.data()), header.size());
+
+        if (S_ISLNK(st.st_mode)) {
+            std::string target(static_cast<size_t>(st.st_size), '\0');
+            if (readlink(path.c_str(), &target[0], target.size()) != static_cast<ssize_t>(target.size())) {
+                return false;
+            }
+            sha.update(reinterpret_cast<const unsigned char*>(target.data()), target.size());
+        } else {
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                return false;
+            }
+            unsigned char buffer[65536];
+            ssize_t count;
+            off_t total = 0;
+            while ((count = read(fd, buffer, sizeof(buffer))) > 0) {
+                sha.update(buffer, static_cast<size_t>(count));
+                total += count;
+            }
+            close(fd);
+            if (count < 0 || total != st.st_size) {
+                return false;
+            }
+        }
+
+        unsigned char digest[SHA1_SIZE];
+        sha.finish(digest);
+        return std::memcmp(digest, expected, SHA1_SIZE) == 0;
+    }
+}
+
+// Git Status Provider Implementation
+GitStatusProvider::GitStatusProvider() : jobQueued(false), stopRequested(false) {
+    if (pipe(notifyPipe) == 0) {
+        for (int fd : notifyPipe) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    } else {
+        notifyPipe[0] = notifyPipe[1] = -1;
+    }
+    worker = std::thread(&GitStatusProvider::workerLoop, this);
+}
+
+GitStatusProvider::~GitStatusProvider() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopRequested = true;
+    }
+    wakeup.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    for (int fd : notifyPipe) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+GitInfo GitStatusProvider::query(const std::string& directory, uint64_t writes) {
+    const Repository& repository = findRepository(directory);
+    if (repository.gitDir.empty()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentGitDir.clear();
+        shown = GitInfo();
+        return shown;
+    }
+
+    int64_t headMtime = modificationTime(repository.gitDir + "/HEAD");
+    int64_t indexSize = -1;
+    int64_t indexMtime = modificationTime(repository.gitDir + "/index", &indexSize);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    currentGitDir = repository.gitDir;
+    RepositoryState& state = states[repository.gitDir];
+    if (state.headMtimeNs != headMtime || state.branch.empty()) {
+        state.branch = readBranch(repository.gitDir);
+        state.headMtimeNs = headMtime;
+        state.dirtyKnown = false;
+    }
+    if (state.indexMtimeNs != indexMtime || state.indexSize != indexSize) {
+        state.indexMtimeNs = indexMtime;
+        state.indexSize = indexSize;
+        state.dirtyKnown = false;
+    }
+
+    // The work tree can change without touching HEAD or the index, so the
+    // cached answer is shown now and checked again in the background. A
+    // clean tree takes a full pass to confirm and nothing has run that could
+    // have changed it; a dirty one usually stops at the first changed file.
+    if (!state.dirtyKnown || state.dirty || state.checkedWrites != writes) {
+        pendingJob = {repository.gitDir, repository.workTree, indexMtime, indexSize, writes};
+        jobQueued = true;
+        wakeup.notify_one();
+    }
+
+    shown.inRepository = true;
+    shown.branch = state.branch;
+    shown.dirtyKnown = state.dirtyKnown;
+    shown.dirty = state.dirty;
+    return shown;
+}
+
+GitInfo GitStatusProvider::current() {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = currentGitDir.empty() ? states.end() : states.find(currentGitDir);
+    if (it != states.end()) {
+        shown.branch = it->second.branch;
+        shown.dirtyKnown = it->second.dirtyKnown;
+        shown.dirty = it->second.dirty;
+    }
+    return shown;
+}
+
+const GitStatusProvider::Repository& GitStatusProvider::findRepository(const std::string& directory) {
+    auto cached = repositories.find(directory);
+    if (cached != repositories.end()) {
+        // A negative answer goes stale if the directory itself becomes a repository
+        struct stat st;
+        if (!cached->second.gitDir.empty() || stat((directory + "/.git").c_str(), &st) != 0) {
+            return cached->second;
+        }
+    }
+    if (repositories.size() >= MAX_CACHED_DIRECTORIES) {
+        repositories.clear();
+    }
+
+    Repository repository;
+    std::string current = directory;
+    while (!current.empty()) {
+        std::string candidate = current == "/" ? "/.git" : current + "/.git";
+        struct stat st;
+        if (stat(candidate.c_str(), &st) == 0) {
+            if (S_ISDIR(st.st_mode)) {
+                repository.gitDir = candidate;
+                repository.workTree = current;
+                break;
+            }
+
+            // Worktrees and submodules use a file pointing at the real git dir
+            std::string contents;
+            if (S_ISREG(st.st_mode) && readSmallFile(candidate, contents) && contents.compare(0, 8, "gitdir: ") == 0) {
+                std::string gitDir = contents.substr(8);
+                repository.gitDir = gitDir[0] == '/' ? gitDir : current + "/" + gitDir;
+                repository.workTree = current;
+                break;
+            }
+        }
+
+        if (current == "/") break;
+        size_t slash = current.rfind('/');
+        current = slash == 0 ? "/" : current.substr(0, slash);
+    }
+
+    return repositories[directory] = repository;
+}
+
+std::string GitStatusProvider::readBranch(const std::string& gitDir) {
+    std::string head;
+    if (!readSmallFile(gitDir + "/HEAD", head)) {
+        return "";
+    }
+    if (head.compare(0, 5, "ref: ") == 0) {
+        std::string ref = head.substr(5);
+        return ref.compare(0, 11, "refs/heads/") == 0 ? ref.substr(11) : ref;
+    }
+
+    // Detached HEAD holds the commit id itself
+    return head.substr(0, 7);
+}
+
+void GitStatusProvider::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wakeup.wait(lock, [this] { return stopRequested || jobQueued; });
+        if (stopRequested) {
+            return;
+        }
+        Job job = pendingJob;
+        jobQueued = false;
+
+        lock.unlock();
+        bool dirty = isWorkTreeDirty(job.gitDir, job.workTree, job.indexMtimeNs, stopRequested);
+        lock.lock();
+        if (stopRequested) {
+            return;
+        }
+
+        // Drop the answer if the index moved while we were reading it
+        RepositoryState& state = states[job.gitDir];
+        if (state.indexMtimeNs != job.indexMtimeNs || state.indexSize != job.indexSize) {
+            continue;
+        }
+        state.dirtyKnown = true;
+        state.dirty = dirty;
+        state.checkedWrites = job.writes;
+
+        // An unknown state is drawn as clean, so only a dirty tree needs a redraw
+        bool shownDirty = shown.dirtyKnown && shown.dirty;
+        if (job.gitDir == currentGitDir && shownDirty != dirty && notifyPipe[1] >= 0) {
+            char byte = 1;
+            ssize_t ignored = write(notifyPipe[1], &byte, 1);
+            (void)ignored;
+        }
+    }
+}
+
+bool GitStatusProvider::isWorkTreeDirty(const std::string& gitDir, const std::string& workTree,
+                                        int64_t indexMtimeNs, const std::atomic<bool>& stop) {
+    int fd = open((gitDir + "/index").c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        // No index yet: a fresh repository is clean until something is added
+        return false;
+    }
+    struct stat indexStat;
+    if (fstat(fd, &indexStat) != 0 || indexStat.st_size < 12) {
+        close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(indexStat.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    const unsigned char* data = static_cast<const unsigned char*>(mapping);
+    const unsigned char* end = data + size;
+
+    uint32_t version = readBigEndian32(data + 4);
+    uint32_t count = readBigEndian32(data + 8);
+    bool dirty = false;
+    if (std::memcmp(data, "DIRC", 4) != 0 || version < 2 || version > 4) {
+        munmap(mapping, size);
+        return false;
+    }
+
+    const unsigned char* p = data + 12;
+    std::string path;
+    std::string fullPath = workTree + "/";
+    const size_t rootLength = fullPath.size();
+    for (uint32_t i = 0; i < count && !dirty && !stop.load(std::memory_order_relaxed); ++i) {
+        const unsigned char* entry = p;
+        if (end - p < 62) break;
+        int64_t mtimeSeconds = readBigEndian32(entry + 8);
+        int64_t mtimeNanos = readBigEndian32(entry + 12);
+        uint32_t inode = readBigEndian32(entry + 20);
+        uint32_t mode = readBigEndian32(entry + 24);
+        uint32_t fileSize = readBigEndian32(entry + 36);
+        const unsigned char* sha = entry + 40;
+        uint16_t flags = readBigEndian16(entry + 60);
+        p += 62;
+
+        uint16_t extended = 0;
+        if ((flags & FLAG_EXTENDED) && version >= 3) {
+            if (end - p < 2) break;
+            extended = readBigEndian16(p);
+            p += 2;
+        }
+
+        // Version 4 prefix-compresses paths against the previous entry
+        if (version == 4) {
+            size_t strip = *p & 0x7F;
+            while (*p++ & 0x80) {
+                if (p >= end) break;
+                strip = ((strip + 1) << 7) | (*p & 0x7F);
+            }
+            path.resize(path.size() - std::min(strip, path.size()));
+        } else {
+            path.clear();
+        }
+        const unsigned char* nul = static_cast<const unsigned char*>(std::memchr(p, 0, static_cast<size_t>(end - p)));
+        if (!nul) break;
+        path.append(reinterpret_cast<const char*>(p), static_cast<size_t>(nul - p));
+        p = nul + 1;
+        if (version < 4) {
+            // Entries are NUL padded to a multiple of eight bytes
+            size_t entryLength = static_cast<size_t>(p - entry);
+            p = entry + ((entryLength + 7) & ~size_t(7));
+        }
+
+        if (flags & FLAG_STAGE_MASK) {
+            dirty = true;  // unresolved merge
+            break;
+        }
+        if ((flags & FLAG_ASSUME_VALID) || (extended & EXTENDED_SKIP_WORKTREE) ||
+            (mode & MODE_TYPE_MASK) == MODE_GITLINK) {
+            continue;
+        }
+
+        fullPath.resize(rootLength);
+        fullPath += path;
+        struct stat st;
+        if (lstat(fullPath.c_str(), &st) != 0) {
+            dirty = true;  // deleted
+            break;
+        }
+
+        bool isSymlink = (mode & MODE_TYPE_MASK) == MODE_SYMLINK;
+        if (isSymlink != S_ISLNK(st.st_mode) || static_cast<uint32_t>(st.st_size) != fileSize ||
+            (!isSymlink && ((mode & 0100) != 0) != ((st.st_mode & S_IXUSR) != 0))) {
+            dirty = true;
+            break;
+        }
+
+        // Same stat data as when it was staged means unchanged, unless the file
+        // was written in the same instant as the index ("racily clean")
+        int64_t fileMtime = Utils::getModificationTimeNs(st);
+        int64_t stagedMtime = mtimeSeconds * 1000000000 + mtimeNanos;
+        if (fileMtime == stagedMtime && static_cast<uint32_t>(st.st_ino) == inode && fileMtime < indexMtimeNs) {
+            continue;
+        }
+        if (!blobMatches(fullPath, st, sha)) {
+            dirty = true;
+        }
+    }
+
+    munmap(mapping, size);
+    return dirty;
+}
@@ -0,0 +1,207 @@
+#include "highlighter.h"
+#include "completion.h"
+#include <algorithm>
+
+namespace {
+    inline uint8_t styleIndex(EditorStyle style) {
+        return static_cast<uint8_t>(style);
+    }
+
+    bool isBlank(char c) {
+        return c == ' ' || c == '\t' || c == '\n';
+    }
+
+    // Characters that end a word and start a command separator
+    bool isSeparator(char c) {
+        return c == '|' || c == '&' || c == ';' || c == '(' || c == ')';
+    }
+
+    bool isRedirection(char c) {
+        return c == '<' || c == '>';
+    }
+
+    bool isNumber(const std::string& line, size_t start, size_t end) {
+        bool digits = false;
+        for (size_t i = start; i < end; ++i) {
+            if (line[i] >= '0' && line[i] <= '9') {
+                digits = true;
+            } else if (line[i] != '.') {
+                return false;
+            }
+        }
+        return digits;
+    }
+}
+
+SyntaxHighlighter::SyntaxHighlighter(CompletionEngine* completion)
+    : completion(completion), commandGeneration(0) {}
+
+void SyntaxHighlighter::invalidate() {
+    commandStyles.clear();
+    text.clear();
+    styles.clear();
+    checkpoints.clear();
+}
+
+void SyntaxHighlighter::update(const std::string& line) {
+    // The PATH index finishing or changing can recolor every command
+    if (completion && completion->getCommandCompleter().getGeneration() != commandGeneration) {
+        commandGeneration = completion->getCommandCompleter().getGeneration();
+        invalidate();
+    }
+    if (line == text && styles.size() == line.size()) {
+        return;
+    }
+
+    const size_t oldSize = text.size();
+    const size_t newSize = line.size();
+    size_t prefix = 0;
+    size_t common = std::min(oldSize, newSize);
+    while (prefix < common && text[prefix] == line[prefix]) {
+        ++prefix;
+    }
+    size_t suffix = 0;
+    while (suffix < common - prefix && text[oldSize - 1 - suffix] == line[newSize - 1 - suffix]) {
+        ++suffix;
+    }
+    const size_t editEnd = newSize - suffix;
+
+    // Restart at the token holding the byte before the edit; an edit right
+    // after a token can extend it
+    size_t kept = static_cast<size_t>(
+        std::lower_bound(checkpoints.begin(), checkpoints.end(), prefix,
+                         [](const Checkpoint& checkpoint, size_t position) { return checkpoint.position < position; }) -
+        checkpoints.begin());
+    if (kept > 0) {
+        --kept;
+    }
+    size_t pos = kept < checkpoints.size() ? checkpoints[kept].position : 0;
+    bool commandPosition = kept < checkpoints.size() ? checkpoints[kept].commandPosition : true;
+
+    previousStyles.swap(styles);
+    previousCheckpoints.swap(checkpoints);
+    checkpoints.assign(previousCheckpoints.begin(), previousCheckpoints.begin() + static_cast<std::ptrdiff_t>(kept));
+    styles.assign(previousStyles.begin(), previousStyles.begin() + static_cast<std::ptrdiff_t>(pos));
+    styles.resize(newSize, 0);
+
+    while (pos < newSize) {
+        // Past the edit, a token start the old lexer also reached in the same
+        // state means everything after it is unchanged apart from the shift
+        if (pos >= editEnd) {
+            size_t oldPos = pos + oldSize - newSize;
+            auto match = std::lower_bound(previousCheckpoints.begin(), previousCheckpoints.end(), oldPos,
+                                          [](const Checkpoint& checkpoint, size_t position) {
+                                              return checkpoint.position < position;
+                                          });
+            if (match != previousCheckpoints.end() && match->position == oldPos &&
+                match->commandPosition == commandPosition) {
+                std::copy(previousStyles.begin() + static_cast<std::ptrdiff_t>(oldPos), previousStyles.end(),
+                          styles.begin() + static_cast<std::ptrdiff_t>(pos));
+                for (; match != previousCheckpoints.end(); ++match) {
+                    checkpoints.push_back({static_cast<uint32_t>(match->position + newSize - oldSize),
+                                           match->commandPosition});
+                }
+                break;
+            }
+        }
+
+        checkpoints.push_back({static_cast<uint32_t>(pos), commandPosition});
+        pos = lexToken(line, pos, commandPosition);
+    }
+    text = line;
+}
+
+size_t SyntaxHighlighter::lexToken(const std::string& line, size_t pos, bool& commandPosition) {
+    const size_t size = line.size();
+    size_t start = pos;
+    char c = line[pos];
+
+    if (isBlank(c)) {
+        while (pos < size && isBlank(line[pos])) {
+            if (line[pos] == '\n') commandPosition = true;
+            styles[pos++] = styleIndex(EditorStyle::Plain);
+        }
+        return pos;
+    }
+
+    if (c == '#') {
+        while (pos < size && line[pos] != '\n') {
+            styles[pos++] = styleIndex(EditorStyle::Comment);
+        }
+        return pos;
+    }
+
+    if (isSeparator(c) || isRedirection(c)) {
+        // Doubled forms (||, &&, ;;, >>, <<) and >& / <& are one operator
+        ++pos;
+        if (pos < size && (line[pos] == c || (isRedirection(c) && line[pos] == '&')) && c != '(' && c != ')') {
+            ++pos;
+        }
+        std::fill(styles.begin() + static_cast<std::ptrdiff_t>(start),
+                  styles.begin() + static_cast<std::ptrdiff_t>(pos), styleIndex(EditorStyle::Operator));
+        if (isSeparator(c)) {
+            commandPosition = true;
+        }
+        return pos;
+    }
+
+    // A word runs to the next blank or operator outside quotes; quoted parts
+    // are styled as strings once the word's own style is known
+    bool plainText = true;
+    std::vector<std::pair<size_t, size_t>> quoted;
+    while (pos < size && !isBlank(line[pos]) && !isSeparator(line[pos]) && !isRedirection(line[pos])) {
+        char ch = line[pos];
+        if (ch == '\\') {
+            plainText = false;
+            pos = std::min(pos + 2, size);
+        } else if (ch == '\'' || ch == '"') {
+            plainText = false;
+            size_t quoteStart = pos++;
+            while (pos < size && line[pos] != ch) {
+                if (ch == '"' && line[pos] == '\\' && pos + 1 < size) ++pos;
+                ++pos;
+            }
+            pos = std::min(pos + 1, size);
+            quoted.emplace_back(quoteStart, pos);
+        } else {
+            if (ch == '$') plainText = false;
+            ++pos;
+        }
+    }
+
+    uint8_t style = styleIndex(EditorStyle::Plain);
+    if (commandPosition) {
+        if (plainText) {
+            style = commandStyle(line.substr(start, pos - start));
+        }
+        commandPosition = false;
+    } else if (plainText && isNumber(line, start, pos)) {
+        style = styleIndex(EditorStyle::Number);
+    }
+    std::fill(styles.begin() + static_cast<std::ptrdiff_t>(start),
+              styles.begin() + static_cast<std::ptrdiff_t>(pos), style);
+    for (const auto& [from, to] : quoted) {
+        std::fill(styles.begin() + static_cast<std::ptrdiff_t>(from),
+                  styles.begin() + static_cast<std::ptrdiff_t>(to), styleIndex(EditorStyle::String));
+    }
+    return pos;
+}
+
+uint8_t SyntaxHighlighter::commandStyle(const std::string& name) {
+    auto it = commandStyles.find(name);
+    if (it != commandStyles.end()) {
+        return it->second;
+    }
+
+    EditorStyle style = EditorStyle::Plain;
+    if (completion) {
+        switch (completion->classifyCommand(name)) {
+            case CommandKind::Builtin:    style = EditorStyle::Builtin; break;
+            case CommandKind::Plugin:     style = EditorStyle::PluginCommand; break;
+            case CommandKind::Executable: style = EditorStyle::Command; break;
+            case CommandKind::Unknown:    style = EditorStyle::UnknownCommand; break;
+        }
+    }
+    commandStyles.emplace(name, styleIndex(style));
+    return styleIndex(style);
+}
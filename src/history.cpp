@@ -0,0 +1,528 @@
+#include "history.h"
+#include "config_writer.h"
+#include <fstream>
+#include <algorithm>
+#include <ctime>
+
+// On-disk layout (all integers little-endian):
+//   magic[8] "LYNXHST\0" | u32 version | u32 blockSize
+//   u32 stringCount | u32 entryCount | u32 blockCount | u32 stringDataSize
+//   u32 blockOffsets[blockCount]      offsets into the string data
+//   string data                       front-coded, sorted, blockSize per block
+//   entries                           varint sortedId, varint zigzag(ts delta)
+//   directories (version 2)           varint count, then (varint len, bytes)
+//   string directories (version 2)    varint directory id per sorted string
+//
+// Inside a block the first string is stored whole (varint len, bytes); every
+// following string stores the length it shares with its predecessor and the
+// remaining suffix. The block index lets a reader seek to any block without
+// decoding the ones before it.
+namespace {
+    const char HISTORY_MAGIC[8] = {'L', 'Y', 'N', 'X', 'H', 'S', 'T', '\0'};
+    const uint32_t HISTORY_FORMAT_VERSION = 2;
+    const uint32_t HISTORY_BLOCK_SIZE = 16;
+
+    void putU32(std::string& out, uint32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            out.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+        }
+    }
+
+    void putVarint(std::string& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    uint64_t zigzag(int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    int64_t unzigzag(uint64_t value) {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    class ByteReader {
+    public:
+        ByteReader(const std::string& data) : data(data), pos(0), failed(false) {}
+
+        bool getU32(uint32_t& value) {
+            if (pos + 4 > data.size()) return fail();
+            value = 0;
+            for (int i = 0; i < 4; ++i) {
+                value |= static_cast<uint32_t>(static_cast<unsigned char>(data[pos++])) << (i * 8);
+            }
+            return true;
+        }
+
+        bool getVarint(uint64_t& value) {
+            value = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                if (pos >= data.size()) return fail();
+                unsigned char byte = static_cast<unsigned char>(data[pos++]);
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0) return true;
+            }
+            return fail();
+        }
+
+        bool getBytes(size_t count, std::string& out) {
+            if (pos + count > data.size()) return fail();
+            out.append(data, pos, count);
+            pos += count;
+            return true;
+        }
+
+        bool skip(size_t count) {
+            if (pos + count > data.size()) return fail();
+            pos += count;
+            return true;
+        }
+
+        size_t position() const { return pos; }
+        size_t remaining() const { return data.size() - pos; }
+
+    private:
+        bool fail() { failed = true; return false; }
+
+        const std::string& data;
+        size_t pos;
+        bool failed;
+    };
+
+    size_t sharedPrefix(const std::string& a, const std::string& b) {
+        size_t limit = std::min(a.size(), b.size());
+        size_t i = 0;
+        while (i < limit && a[i] == b[i]) {
+            ++i;
+        }
+        return i;
+    }
+}
+
+HistoryStore::HistoryStore()
+    : maxEntries(1000), recencyCounter(0), generation(0), directories(1), flatViewDirty(true) {}
+
+void HistoryStore::add(const std::string& command) {
+    add(command, static_cast<int64_t>(std::time(nullptr)), std::string());
+}
+
+void HistoryStore::add(const std::string& command, int64_t timestamp) {
+    add(command, timestamp, std::string());
+}
+
+void HistoryStore::add(const std::string& command, const std::string& directory) {
+    add(command, static_cast<int64_t>(std::time(nullptr)), directory);
+}
+
+void HistoryStore::add(const std::string& command, int64_t timestamp, const std::string& directory) {
+    entries.push_back({intern(command, internDirectory(directory)), static_cast<uint32_t>(timestamp)});
+    trimToLimit();
+    flatViewDirty = true;
+    generation++;
+}
+
+void HistoryStore::clear() {
+    strings.clear();
+    freeIds.clear();
+    index.clear();
+    entries.clear();
+    sortedIds.clear();
+    directories.assign(1, std::string());
+    directoryIndex.clear();
+    flatView.clear();
+    flatViewDirty = true;
+    generation++;
+}
+
+void HistoryStore::setMaxEntries(size_t max) {
+    maxEntries = max;
+    trimToLimit();
+}
+
+const std::string& HistoryStore::operator[](size_t position) const {
+    return strings[entries[position].textId].text;
+}
+
+int64_t HistoryStore::timestampAt(size_t position) const {
+    return entries[position].timestamp;
+}
+
+size_t HistoryStore::memoryUsage() const {
+    size_t bytes = sizeof(*this);
+    for (const auto& interned : strings) {
+        bytes += sizeof(InternedString);
+        if (interned.text.capacity() > 15) {
+            bytes += interned.text.capacity() + 1;
+        }
+    }
+    bytes += entries.size() * sizeof(Entry);
+    bytes += index.size() * (sizeof(std::string_view) + sizeof(uint32_t) + 2 * sizeof(void*));
+    bytes += index.bucket_count() * sizeof(void*);
+    bytes += freeIds.capacity() * sizeof(uint32_t);
+    bytes += sortedIds.capacity() * sizeof(uint32_t);
+    for (const auto& directory : directories) {
+        bytes += sizeof(std::string) + directory.capacity();
+    }
+    return bytes;
+}
+
+const std::vector<std::string>& HistoryStore::asVector() const {
+    if (flatViewDirty) {
+        flatView.clear();
+        flatView.reserve(entries.size());
+        for (const auto& entry : entries) {
+            flatView.push_back(strings[entry.textId].text);
+        }
+        flatViewDirty = false;
+    }
+    return flatView;
+}
+
+size_t HistoryStore::lowerBound(std::string_view prefix) const {
+    auto it = std::lower_bound(sortedIds.begin(), sortedIds.end(), prefix,
+                               [this](uint32_t id, std::string_view key) { return strings[id].text < key; });
+    return static_cast<size_t>(it - sortedIds.begin());
+}
+
+HistoryStore::Match HistoryStore::sortedAt(size_t position) const {
+    const InternedString& interned = strings[sortedIds[position]];
+    return {&interned.text, interned.recency, interned.directoryId};
+}
+
+uint32_t HistoryStore::findDirectory(const std::string& directory) const {
+    auto it = directoryIndex.find(directory);
+    return it != directoryIndex.end() ? it->second : 0;
+}
+
+uint32_t HistoryStore::intern(const std::string& text, uint32_t directoryId) {
+    auto it = index.find(std::string_view(text));
+    if (it != index.end()) {
+        InternedString& interned = strings[it->second];
+        interned.refCount++;
+        interned.recency = ++recencyCounter;
+        if (directoryId != 0) {
+            interned.directoryId = directoryId;
+        }
+        return it->second;
+    }
+
+    uint32_t id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+        strings[id] = {text, 1, directoryId, ++recencyCounter};
+    } else {
+        id = static_cast<uint32_t>(strings.size());
+        strings.push_back({text, 1, directoryId, ++recencyCounter});
+    }
+    index.emplace(std::string_view(strings[id].text), id);
+    sortedIds.insert(sortedIds.begin() + static_cast<std::ptrdiff_t>(lowerBound(text)), id);
+    return id;
+}
+
+uint32_t HistoryStore::internDirectory(const std::string& directory) {
+    if (directory.empty()) {
+        return 0;
+    }
+    auto it = directoryIndex.find(directory);
+    if (it != directoryIndex.end()) {
+        return it->second;
+    }
+    uint32_t id = static_cast<uint32_t>(directories.size());
+    directories.push_back(directory);
+    directoryIndex.emplace(directory, id);
+    return id;
+}
+
+void HistoryStore::release(uint32_t id) {
+    InternedString& interned = strings[id];
+    if (--interned.refCount > 0) {
+        return;
+    }
+    sortedIds.erase(sortedIds.begin() + static_cast<std::ptrdiff_t>(lowerBound(interned.text)));
+    index.erase(std::string_view(interned.text));
+    std::string().swap(interned.text);
+    freeIds.push_back(id);
+}
+
+void HistoryStore::trimToLimit() {
+    while (entries.size() > maxEntries) {
+        release(entries.front().textId);
+        entries.pop_front();
+        flatViewDirty = true;
+    }
+}
+
+bool HistoryStore::save(const std::string& path) const {
+    // Live strings are already sorted, so neighbours share prefixes
+    const std::vector<uint32_t>& order = sortedIds;
+
+    std::vector<uint32_t> sortedIdOf(strings.size(), 0);
+    for (size_t i = 0; i < order.size(); ++i) {
+        sortedIdOf[order[i]] = static_cast<uint32_t>(i);
+    }
+
+    std::string stringData;
+    std::vector<uint32_t> blockOffsets;
+    for (size_t i = 0; i < order.size(); ++i) {
+        const std::string& text = strings[order[i]].text;
+        if (i % HISTORY_BLOCK_SIZE == 0) {
+            blockOffsets.push_back(static_cast<uint32_t>(stringData.size()));
+            putVarint(stringData, text.size());
+            stringData += text;
+        } else {
+            const std::string& previous = strings[order[i - 1]].text;
+            size_t shared = sharedPrefix(previous, text);
+            putVarint(stringData, shared);
+            putVarint(stringData, text.size() - shared);
+            stringData.append(text, shared, std::string::npos);
+        }
+    }
+
+    std::string out;
+    out.append(HISTORY_MAGIC, sizeof(HISTORY_MAGIC));
+    putU32(out, HISTORY_FORMAT_VERSION);
+    putU32(out, HISTORY_BLOCK_SIZE);
+    putU32(out, static_cast<uint32_t>(order.size()));
+    putU32(out, static_cast<uint32_t>(entries.size()));
+    putU32(out, static_cast<uint32_t>(blockOffsets.size()));
+    putU32(out, static_cast<uint32_t>(stringData.size()));
+    for (uint32_t offset : blockOffsets) {
+        putU32(out, offset);
+    }
+    out += stringData;
+
+    int64_t previousTimestamp = 0;
+    for (const auto& entry : entries) {
+        putVarint(out, sortedIdOf[entry.textId]);
+        putVarint(out, zigzag(static_cast<int64_t>(entry.timestamp) - previousTimestamp));
+        previousTimestamp = entry.timestamp;
+    }
+
+    // Only directories still referenced by a live string are written
+    std::vector<uint32_t> directoryRemap(directories.size(), 0);
+    std::vector<uint32_t> liveDirectories;
+    for (uint32_t id : order) {
+        uint32_t directoryId = strings[id].directoryId;
+        if (directoryId != 0 && directoryRemap[directoryId] == 0) {
+            liveDirectories.push_back(directoryId);
+            directoryRemap[directoryId] = static_cast<uint32_t>(liveDirectories.size());
+        }
+    }
+    putVarint(out, liveDirectories.size());
+    for (uint32_t directoryId : liveDirectories) {
+        putVarint(out, directories[directoryId].size());
+        out += directories[directoryId];
+    }
+    for (uint32_t id : order) {
+        putVarint(out, directoryRemap[strings[id].directoryId]);
+    }
+
+    // Synced to a sibling file and renamed, so a crash never truncates history
+    return ConfigWriter::writeAtomically(path, out);
+}
+
+bool HistoryStore::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    if (data.size() < sizeof(HISTORY_MAGIC) ||
+        !std::equal(HISTORY_MAGIC, HISTORY_MAGIC + sizeof(HISTORY_MAGIC), data.begin())) {
+        return false;
+    }
+
+    ByteReader reader(data);
+    reader.skip(sizeof(HISTORY_MAGIC));
+
+    uint32_t version, blockSize, stringCount, entryCount, blockCount, stringDataSize;
+    if (!reader.getU32(version) || version == 0 || version > HISTORY_FORMAT_VERSION ||
+        !reader.getU32(blockSize) || blockSize == 0 ||
+        !reader.getU32(stringCount) || !reader.getU32(entryCount) ||
+        !reader.getU32(blockCount) || !reader.getU32(stringDataSize)) {
+        return false;
+    }
+    if (blockCount != (uint64_t(stringCount) + blockSize - 1) / blockSize) {
+        return false;
+    }
+
+    // Nothing is allocated from the header until the file could hold it:
+    // four bytes per block offset, at least one per string and two per entry
+    if (uint64_t(blockCount) * 4 + stringDataSize > reader.remaining() ||
+        stringCount > stringDataSize ||
+        uint64_t(entryCount) * 2 > reader.remaining() - uint64_t(blockCount) * 4 - stringDataSize) {
+        return false;
+    }
+
+    std::vector<uint32_t> blockOffsets(blockCount);
+    for (auto& offset : blockOffsets) {
+        if (!reader.getU32(offset)) return false;
+    }
+
+    // Decode every block in order, checking each lands where the index says
+    std::vector<std::string> sorted;
+    sorted.reserve(stringCount);
+    size_t dataStart = reader.position();
+    for (uint32_t i = 0; i < stringCount; ++i) {
+        std::string text;
+        uint64_t length;
+        if (i % blockSize == 0) {
+            if (reader.position() - dataStart != blockOffsets[i / blockSize]) return false;
+            if (!reader.getVarint(length) || !reader.getBytes(length, text)) return false;
+        } else {
+            uint64_t shared;
+            if (!reader.getVarint(shared) || !reader.getVarint(length)) return false;
+            if (shared > sorted.back().size()) return false;
+            text.assign(sorted.back(), 0, shared);
+            if (!reader.getBytes(length, text)) return false;
+        }
+        sorted.push_back(std::move(text));
+    }
+    if (reader.position() - dataStart != stringDataSize) {
+        return false;
+    }
+
+    std::vector<std::pair<uint32_t, int64_t>> decoded;
+    decoded.reserve(entryCount);
+    int64_t timestamp = 0;
+    for (uint32_t i = 0; i < entryCount; ++i) {
+        uint64_t sortedId, delta;
+        if (!reader.getVarint(sortedId) || !reader.getVarint(delta) || sortedId >= stringCount) {
+            return false;
+        }
+        timestamp += unzigzag(delta);
+        decoded.emplace_back(static_cast<uint32_t>(sortedId), timestamp);
+    }
+
+    // Version 1 files predate directory tracking
+    std::vector<std::string> fileDirectories(1);
+    std::vector<uint32_t> stringDirectories(stringCount, 0);
+    if (version >= 2) {
+        uint64_t directoryCount;
+        if (!reader.getVarint(directoryCount) || directoryCount > data.size()) return false;
+        for (uint64_t i = 0; i < directoryCount; ++i) {
+            uint64_t length;
+            std::string directory;
+            if (!reader.getVarint(length) || !reader.getBytes(length, directory)) return false;
+            fileDirectories.push_back(std::move(directory));
+        }
+        for (auto& directoryId : stringDirectories) {
+            uint64_t value;
+            if (!reader.getVarint(value) || value > directoryCount) return false;
+            directoryId = static_cast<uint32_t>(value);
+        }
+    }
+
+    clear();
+    std::vector<uint32_t> directoryIds(fileDirectories.size(), 0);
+    for (size_t i = 1; i < fileDirectories.size(); ++i) {
+        directoryIds[i] = internDirectory(fileDirectories[i]);
+    }
+    for (const auto& [sortedId, entryTimestamp] : decoded) {
+        uint32_t id = intern(sorted[sortedId], directoryIds[stringDirectories[sortedId]]);
+        entries.push_back({id, static_cast<uint32_t>(entryTimestamp)});
+    }
+    trimToLimit();
+    return true;
+}
+
+bool HistoryStore::exportText(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    for (const auto& entry : entries) {
+        file << strings[entry.textId].text << "\n";
+    }
+    return file.good();
+}
+
+// History Suggester Implementation
+HistorySuggester::HistorySuggester(const HistoryStore& history)
+    : history(history), budget(std::chrono::milliseconds(2)), directoryId(0), pending(false),
+      generation(0), position(0), bestInDirectory(false), bestRecency(0) {}
+
+void HistorySuggester::setDirectory(const std::string& path) {
+    if (path != directory) {
+        directory = path;
+        prefix.clear();
+        suggestion.clear();
+        pending = false;
+    }
+}
+
+bool HistorySuggester::begin(const std::string& text) {
+    // Typing along the current suggestion keeps it: the best match for a
+    // shorter prefix is also the best among the entries a longer one allows
+    if (!pending && generation == history.getGeneration() && !prefix.empty() &&
+        text.size() > prefix.size() && text.compare(0, prefix.size(), prefix) == 0 &&
+        suggestion.size() > text.size() && suggestion.compare(0, text.size(), text) == 0) {
+        prefix = text;
+        return true;
+    }
+
+    prefix = text;
+    suggestion.clear();
+    pending = false;
+    if (prefix.empty()) {
+        return true;
+    }
+
+    generation = history.getGeneration();
+    directoryId = history.findDirectory(directory);
+    position = history.lowerBound(prefix);
+    bestInDirectory = false;
+    bestRecency = 0;
+    pending = true;
+    return scan();
+}
+
+bool HistorySuggester::resume() {
+    if (!pending) {
+        return true;
+    }
+    if (generation != history.getGeneration()) {
+        pending = false;
+        std::string text;
+        text.swap(prefix);
+        return begin(text);
+    }
+    return scan();
+}
+
+bool HistorySuggester::scan() {
+    // Matches are contiguous in sorted order; walk them until the prefix no
+    // longer matches, checking the clock every few dozen entries
+    auto start = std::chrono::steady_clock::now();
+    const size_t count = history.sortedCount();
+    size_t checked = 0;
+    while (position < count) {
+        HistoryStore::Match match = history.sortedAt(position);
+        if (match.text->compare(0, prefix.size(), prefix) != 0) {
+            break;
+        }
+        ++position;
+
+        if (match.text->size() > prefix.size()) {
+            bool inDirectory = directoryId != 0 && match.directoryId == directoryId;
+            if (suggestion.empty() || inDirectory > bestInDirectory ||
+                (inDirectory == bestInDirectory && match.recency > bestRecency)) {
+                suggestion = *match.text;
+                bestInDirectory = inDirectory;
+                bestRecency = match.recency;
+            }
+        }
+
+        if ((++checked & 63) == 0 && std::chrono::steady_clock::now() - start >= budget) {
+            return false;
+        }
+    }
+    pending = false;
+    return true;
+}
@@ -0,0 +1,353 @@
+#include "json_reader.h"
+#include <cstring>
+
+namespace {
+    const size_t MAX_NESTING = 256;
+
+    int hexDigit(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    bool isDigit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    void appendUtf8(std::string& out, uint32_t codepoint) {
+        if (codepoint < 0x80) {
+            out += static_cast<char>(codepoint);
+        } else if (codepoint < 0x800) {
+            out += static_cast<char>(0xC0 | (codepoint >> 6));
+            out += static_cast<char>(0x80 | (codepoint & 0x3F));
+        } else if (codepoint < 0x10000) {
+            out += static_cast<char>(0xE0 | (codepoint >> 12));
+            out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (codepoint & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (codepoint >> 18));
+            out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (codepoint & 0x3F));
+        }
+    }
+}
+
+// JSON Reader Implementation
+JsonReader::JsonReader(const char* data, size_t size)
+    : begin(data), cursor(data), end(data + size), expect(Expect::Value), line(0), column(0) {
+    // A UTF-8 byte order mark is tolerated at the start
+    if (size >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        cursor += 3;
+    }
+}
+
+JsonReader::Token JsonReader::next() {
+    if (failed()) {
+        return Token::Error;
+    }
+    skipWhitespace();
+
+    switch (expect) {
+        case Expect::Value:
+            return readValue();
+
+        case Expect::KeyOrEnd:
+            if (cursor < end && *cursor == '}') {
+                ++cursor;
+                return closeContainer(true);
+            }
+            return readKey();
+
+        case Expect::Key:
+            return readKey();
+
+        case Expect::ValueOrEnd:
+            if (cursor < end && *cursor == ']') {
+                ++cursor;
+                return closeContainer(false);
+            }
+            return readValue();
+
+        case Expect::CommaOrEnd: {
+            bool object = nesting.back();
+            if (cursor >= end) {
+                return fail(cursor, "unexpected end of input");
+            }
+            if (*cursor == ',') {
+                ++cursor;
+                expect = object ? Expect::Key : Expect::Value;
+                return next();
+            }
+            if (*cursor == (object ? '}' : ']')) {
+                ++cursor;
+                return closeContainer(object);
+            }
+            return fail(cursor, object ? "expected ',' or '}'" : "expected ',' or ']'");
+        }
+
+        case Expect::Done:
+            if (cursor < end) {
+                return fail(cursor, "unexpected data after the top-level value");
+            }
+            return Token::End;
+    }
+    return Token::Error;
+}
+
+bool JsonReader::skip(Token token) {
+    if (token != Token::BeginObject && token != Token::BeginArray) {
+        return token != Token::Error;
+    }
+    size_t depth = 1;
+    while (depth > 0) {
+        switch (next()) {
+            case Token::BeginObject:
+            case Token::BeginArray:
+                ++depth;
+                break;
+            case Token::EndObject:
+            case Token::EndArray:
+                --depth;
+                break;
+            case Token::Error:
+            case Token::End:
+                return false;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+JsonReader::Token JsonReader::readValue() {
+    if (cursor >= end) {
+        return fail(cursor, "unexpected end of input");
+    }
+    const char* start = cursor;
+    switch (*cursor) {
+        case '{':
+        case '[': {
+            if (nesting.size() >= MAX_NESTING) {
+                return fail(cursor, "nesting too deep");
+            }
+            bool object = *cursor == '{';
+            ++cursor;
+            nesting.push_back(object);
+            expect = object ? Expect::KeyOrEnd : Expect::ValueOrEnd;
+            return object ? Token::BeginObject : Token::BeginArray;
+        }
+        case '"':
+            if (!readString()) {
+                return Token::Error;
+            }
+            afterValue();
+            return Token::String;
+        case 't':
+            if (!readLiteral("true")) return Token::Error;
+            afterValue();
+            return Token::True;
+        case 'f':
+            if (!readLiteral("false")) return Token::Error;
+            afterValue();
+            return Token::False;
+        case 'n':
+            if (!readLiteral("null")) return Token::Error;
+            afterValue();
+            return Token::Null;
+        default:
+            if (*cursor == '-' || isDigit(*cursor)) {
+                if (!readNumber()) return Token::Error;
+                afterValue();
+                return Token::Number;
+            }
+            return fail(start, std::string("unexpected character '") + *cursor + "'");
+    }
+}
+
+JsonReader::Token JsonReader::readKey() {
+    if (cursor >= end || *cursor != '"') {
+        return fail(cursor, cursor >= end ? "unexpected end of input" : "expected a string key");
+    }
+    if (!readString()) {
+        return Token::Error;
+    }
+    skipWhitespace();
+    if (cursor >= end || *cursor != ':') {
+        return fail(cursor, "expected ':' after key");
+    }
+    ++cursor;
+    expect = Expect::Value;
+    return Token::Key;
+}
+
+JsonReader::Token JsonReader::closeContainer(bool object) {
+    nesting.pop_back();
+    afterValue();
+    return object ? Token::EndObject : Token::EndArray;
+}
+
+void JsonReader::afterValue() {
+    expect = nesting.empty() ? Expect::Done : Expect::CommaOrEnd;
+}
+
+bool JsonReader::readString() {
+    const char* quote = cursor++;
+    const char* start = cursor;
+
+    // Fast path: no escapes, the value is a view of the buffer
+    while (cursor < end && *cursor != '"' && *cursor != '\\') {
+        if (static_cast<unsigned char>(*cursor) < 0x20) {
+            fail(cursor, "control character in string");
+            return false;
+        }
+        ++cursor;
+    }
+    if (cursor >= end) {
+        fail(quote, "unterminated string");
+        return false;
+    }
+    if (*cursor == '"') {
+        value = std::string_view(start, cursor - start);
+        ++cursor;
+        return true;
+    }
+
+    scratch.assign(start, cursor);
+    while (cursor < end && *cursor != '"') {
+        char c = *cursor;
+        if (static_cast<unsigned char>(c) < 0x20) {
+            fail(cursor, "control character in string");
+            return false;
+        }
+        if (c != '\\') {
+            scratch += c;
+            ++cursor;
+            continue;
+        }
+
+        const char* escape = cursor++;
+        if (cursor >= end) {
+            break;
+        }
+        switch (*cursor++) {
+            case '"': scratch += '"'; break;
+            case '\\': scratch += '\\'; break;
+            case '/': scratch += '/'; break;
+            case 'b': scratch += '\b'; break;
+            case 'f': scratch += '\f'; break;
+            case 'n': scratch += '\n'; break;
+            case 'r': scratch += '\r'; break;
+            case 't': scratch += '\t'; break;
+            case 'u': {
+                auto readHex = [&](uint32_t& out) {
+                    if (end - cursor < 4) return false;
+                    out = 0;
+                    for (int i = 0; i < 4; ++i) {
+                        int digit = hexDigit(cursor[i]);
+                        if (digit < 0) return false;
+                        out = (out << 4) | static_cast<uint32_t>(digit);
+                    }
+                    cursor += 4;
+                    return true;
+                };
+                uint32_t codepoint;
+                if (!readHex(codepoint)) {
+                    fail(escape, "invalid \\u escape");
+                    return false;
+                }
+                if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+                    uint32_t low;
+                    if (end - cursor < 2 || cursor[0] != '\\' || cursor[1] != 'u' ||
+                        (cursor += 2, !readHex(low)) || low < 0xDC00 || low > 0xDFFF) {
+                        fail(escape, "unpaired surrogate in \\u escape");
+                        return false;
+                    }
+                    codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                } else if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+                    fail(escape, "unpaired surrogate in \\u escape");
+                    return false;
+                }
+                appendUtf8(scratch, codepoint);
+                break;
+            }
+            default:
+                fail(escape, "invalid escape sequence");
+                return false;
+        }
+    }
+    if (cursor >= end) {
+        fail(quote, "unterminated string");
+        return false;
+    }
+    ++cursor;
+    value = scratch;
+    return true;
+}
+
+bool JsonReader::readNumber() {
+    const char* start = cursor;
+    if (*cursor == '-') {
+        ++cursor;
+    }
+    if (cursor < end && *cursor == '0') {
+        ++cursor;
+    } else if (cursor < end && isDigit(*cursor)) {
+        while (cursor < end && isDigit(*cursor)) ++cursor;
+    } else {
+        fail(cursor, "invalid number");
+        return false;
+    }
+    if (cursor < end && *cursor == '.') {
+        ++cursor;
+        if (cursor >= end || !isDigit(*cursor)) {
+            fail(cursor, "expected digits after '.'");
+            return false;
+        }
+        while (cursor < end && isDigit(*cursor)) ++cursor;
+    }
+    if (cursor < end && (*cursor == 'e' || *cursor == 'E')) {
+        ++cursor;
+        if (cursor < end && (*cursor == '+' || *cursor == '-')) ++cursor;
+        if (cursor >= end || !isDigit(*cursor)) {
+            fail(cursor, "expected digits in exponent");
+            return false;
+        }
+        while (cursor < end && isDigit(*cursor)) ++cursor;
+    }
+    value = std::string_view(start, cursor - start);
+    return true;
+}
+
+bool JsonReader::readLiteral(std::string_view literal) {
+    if (static_cast<size_t>(end - cursor) < literal.size() ||
+        std::memcmp(cursor, literal.data(), literal.size()) != 0) {
+        fail(cursor, "invalid literal");
+        return false;
+    }
+    cursor += literal.size();
+    return true;
+}
+
+void JsonReader::skipWhitespace() {
+    while (cursor < end && (*cursor == ' ' || *cursor == '\n' || *cursor == '\t' || *cursor == '\r')) {
+        ++cursor;
+    }
+}
+
+JsonReader::Token JsonReader::fail(const char* position, const std::string& message) {
+    // Line and column are only worked out when something goes wrong
+    line = 1;
+    column = 1;
+    for (const char* p = begin; p < position && p < end; ++p) {
+        if (*p == '\n') {
+            ++line;
+            column = 1;
+        } else if ((static_cast<unsigned char>(*p) & 0xC0) != 0x80) {
+            ++column;
+        }
+    }
+    error = message;
+    return Token::Error;
+}
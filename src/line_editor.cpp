@@ -0,0 +1,914 @@
+#include "line_editor.h"
+#include "history.h"
+#include "highlighter.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace {
+    // How long to wait for the rest of an escape sequence before treating a
+    // lone ESC as a key of its own
+    const int ESCAPE_TIMEOUT_MS = 50;
+
+    volatile sig_atomic_t windowResized = 0;
+
+    void onWindowResize(int) {
+        windowResized = 1;
+    }
+
+    size_t utf8Length(unsigned char lead) {
+        if (lead < 0x80) return 1;
+        if ((lead & 0xE0) == 0xC0) return 2;
+        if ((lead & 0xF0) == 0xE0) return 3;
+        if ((lead & 0xF8) == 0xF0) return 4;
+        return 1;
+    }
+
+    bool isContinuation(unsigned char byte) {
+        return (byte & 0xC0) == 0x80;
+    }
+
+    // Invalid bytes decode to U+DC80..U+DCFF so they are echoed back unchanged
+    char32_t decodeCodepoint(const std::string& text, size_t& pos) {
+        unsigned char lead = static_cast<unsigned char>(text[pos]);
+        size_t length = utf8Length(lead);
+        if (length == 1 || pos + length > text.size()) {
+            pos++;
+            return lead < 0x80 ? lead : static_cast<char32_t>(0xDC00 + lead);
+        }
+
+        char32_t ch = lead & (0x7F >> length);
+        for (size_t i = 1; i < length; ++i) {
+            unsigned char byte = static_cast<unsigned char>(text[pos + i]);
+            if (!isContinuation(byte)) {
+                pos++;
+                return static_cast<char32_t>(0xDC00 + lead);
+            }
+            ch = (ch << 6) | (byte & 0x3F);
+        }
+        pos += length;
+        return ch;
+    }
+
+    void appendUtf8(std::string& out, char32_t ch) {
+        if (ch >= 0xDC80 && ch <= 0xDCFF) {
+            out.push_back(static_cast<char>(ch - 0xDC00));
+        } else if (ch < 0x80) {
+            out.push_back(static_cast<char>(ch));
+        } else if (ch < 0x800) {
+            out.push_back(static_cast<char>(0xC0 | (ch >> 6)));
+            out.push_back(static_cast<char>(0x80 | (ch & 0x3F)));
+        } else if (ch < 0x10000) {
+            out.push_back(static_cast<char>(0xE0 | (ch >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((ch >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (ch & 0x3F)));
+        } else {
+            out.push_back(static_cast<char>(0xF0 | (ch >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((ch >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((ch >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (ch & 0x3F)));
+        }
+    }
+
+    void appendSequence(std::string& out, size_t count, char command) {
+        out += "\033[";
+        if (count != 1) {
+            out += std::to_string(count);
+        }
+        out.push_back(command);
+    }
+
+    bool isWordByte(char c) {
+        return c != ' ' && c != '\t' && c != '/';
+    }
+}
+
+// Key Trie Implementation
+KeyTrie::KeyTrie() {
+    nodes.emplace_back();
+
+    // Single-byte control keys
+    add("\x01", EditorKey::Home);
+    add("\x02", EditorKey::Left);
+    add("\x03", EditorKey::Interrupt);
+    add("\x04", EditorKey::EndOfFile);
+    add("\x05", EditorKey::End);
+    add("\x06", EditorKey::Right);
+    add("\x08", EditorKey::Backspace);
+    add("\t", EditorKey::Tab);
+    add("\r", EditorKey::Enter);
+    add("\n", EditorKey::Enter);
+    add("\x0b", EditorKey::KillToEnd);
+    add("\x0c", EditorKey::ClearScreen);
+    add("\x0e", EditorKey::Down);
+    add("\x10", EditorKey::Up);
+    add("\x15", EditorKey::KillToStart);
+    add("\x17", EditorKey::DeleteWordLeft);
+    add("\x7f", EditorKey::Backspace);
+    add("\x1b", EditorKey::Escape);
+
+    // ANSI / xterm sequences, in both normal and application cursor modes
+    add("\x1b[A", EditorKey::Up);
+    add("\x1b[B", EditorKey::Down);
+    add("\x1b[C", EditorKey::Right);
+    add("\x1b[D", EditorKey::Left);
+    add("\x1b[H", EditorKey::Home);
+    add("\x1b[F", EditorKey::End);
+    add("\x1bOA", EditorKey::Up);
+    add("\x1bOB", EditorKey::Down);
+    add("\x1bOC", EditorKey::Right);
+    add("\x1bOD", EditorKey::Left);
+    add("\x1bOH", EditorKey::Home);
+    add("\x1bOF", EditorKey::End);
+    add("\x1b[1~", EditorKey::Home);
+    add("\x1b[7~", EditorKey::Home);
+    add("\x1b[4~", EditorKey::End);
+    add("\x1b[8~", EditorKey::End);
+    add("\x1b[3~", EditorKey::Delete);
+    add("\x1b[1;5C", EditorKey::WordRight);
+    add("\x1b[1;5D", EditorKey::WordLeft);
+    add("\x1b[1;3C", EditorKey::WordRight);
+    add("\x1b[1;3D", EditorKey::WordLeft);
+    add("\x1b" "b", EditorKey::WordLeft);
+    add("\x1b" "f", EditorKey::WordRight);
+    add("\x1b\x7f", EditorKey::DeleteWordLeft);
+}
+
+void KeyTrie::add(const std::string& sequence, EditorKey key) {
+    uint32_t node = 0;
+    for (char c : sequence) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        int child = findChild(node, byte);
+        if (child < 0) {
+            child = static_cast<int>(nodes.size());
+            nodes[node].children.emplace_back(byte, static_cast<uint32_t>(child));
+            nodes.emplace_back();
+        }
+        node = static_cast<uint32_t>(child);
+    }
+    nodes[node].key = key;
+}
+
+int KeyTrie::findChild(uint32_t node, unsigned char byte) const {
+    for (const auto& [childByte, child] : nodes[node].children) {
+        if (childByte == byte) {
+            return static_cast<int>(child);
+        }
+    }
+    return -1;
+}
+
+size_t KeyTrie::decode(const std::string& input, size_t pos, bool final, KeyEvent& event) const {
+    event = KeyEvent();
+    unsigned char lead = static_cast<unsigned char>(input[pos]);
+
+    // Printable text, including multi-byte UTF-8 sequences
+    if (lead >= 0x20 && lead != 0x7f) {
+        size_t length = utf8Length(lead);
+        if (pos + length > input.size()) {
+            if (!final) return 0;
+            length = input.size() - pos;
+        }
+        event.key = EditorKey::Char;
+        event.text.assign(input, pos, length);
+        return length;
+    }
+
+    // Longest match through the trie
+    uint32_t node = 0;
+    EditorKey best = EditorKey::None;
+    size_t bestLength = 0;
+    size_t i = pos;
+    while (i < input.size()) {
+        int child = findChild(node, static_cast<unsigned char>(input[i]));
+        if (child < 0) break;
+        node = static_cast<uint32_t>(child);
+        ++i;
+        if (nodes[node].key != EditorKey::None) {
+            best = nodes[node].key;
+            bestLength = i - pos;
+        }
+        if (nodes[node].children.empty()) break;
+    }
+
+    if (i == input.size() && !nodes[node].children.empty() && !final) {
+        return 0;
+    }
+
+    // Swallow unbound CSI / SS3 sequences (function keys, modifiers) whole
+    if (bestLength <= 1 && lead == 0x1b && pos + 1 < input.size()) {
+        char introducer = input[pos + 1];
+        if (introducer == 'O') {
+            if (pos + 2 >= input.size()) return final ? input.size() - pos : 0;
+            return 3;
+        }
+        if (introducer == '[') {
+            size_t j = pos + 2;
+            while (j < input.size()) {
+                unsigned char byte = static_cast<unsigned char>(input[j]);
+                if (byte >= 0x40 && byte <= 0x7E) {
+                    return j - pos + 1;
+                }
+                ++j;
+            }
+            return final ? input.size() - pos : 0;
+        }
+    }
+
+    if (bestLength > 0) {
+        event.key = best;
+        return bestLength;
+    }
+    return 1;
+}
+
+// Line Editor Implementation
+LineEditor::LineEditor(int inputFd, int outputFd)
+    : inputFd(inputFd), outputFd(outputFd), interactive(false), rawMode(false),
+      inputClosed(false), history(nullptr), suggester(nullptr), highlighter(nullptr),
+      promptFd(-1), promptUpdate(false), cursor(0), historyIndex(0),
+      lastKey(EditorKey::None), interrupted(false), suggestionPending(false), promptColumns(0), terminalColumns(80), cursorRow(0), cursorColumn(0) {
+    const char* term = getenv("TERM");
+    interactive = isatty(inputFd) && isatty(outputFd) &&
+                  !(term && std::string(term) == "dumb");
+
+    if (interactive) {
+        struct sigaction action = {};
+        action.sa_handler = onWindowResize;
+        sigemptyset(&action.sa_mask);
+        // Only poll() needs to wake for it; a child being waited on must not
+        action.sa_flags = SA_RESTART;
+        sigaction(SIGWINCH, &action, nullptr);
+    }
+}
+
+LineEditor::~LineEditor() {
+    disableRawMode();
+}
+
+bool LineEditor::enableRawMode() {
+    if (rawMode) return true;
+    if (tcgetattr(inputFd, &originalTermios) == -1) {
+        return false;
+    }
+
+    struct termios raw = originalTermios;
+    raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    raw.c_oflag &= ~(OPOST);
+    raw.c_cflag |= CS8;
+    raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+
+    // TCSADRAIN keeps anything typed while the previous command was running
+    if (tcsetattr(inputFd, TCSADRAIN, &raw) == -1) {
+        return false;
+    }
+    rawMode = true;
+    return true;
+}
+
+void LineEditor::disableRawMode() {
+    if (rawMode) {
+        tcsetattr(inputFd, TCSADRAIN, &originalTermios);
+        rawMode = false;
+    }
+}
+
+bool LineEditor::readPending(int timeoutMs) {
+    struct pollfd pfds[2] = {{inputFd, POLLIN, 0}, {promptFd, POLLIN, 0}};
+    int ready = poll(pfds, promptFd >= 0 ? 2 : 1, timeoutMs);
+    if (ready == 0) {
+        return false;
+    }
+    if (ready < 0) {
+        if (errno == EINTR) {
+            return true;
+        }
+        // Nothing more can be read; treat it like end of input
+        inputClosed = true;
+        return false;
+    }
+
+    if (promptFd >= 0 && (pfds[1].revents & POLLIN)) {
+        char drain[64];
+        while (read(promptFd, drain, sizeof(drain)) > 0) {
+        }
+        promptUpdate = true;
+        if (!(pfds[0].revents & (POLLIN | POLLHUP))) {
+            return true;
+        }
+    }
+
+    char chunk[4096];
+    ssize_t count = read(inputFd, chunk, sizeof(chunk));
+    if (count > 0) {
+        pending.append(chunk, static_cast<size_t>(count));
+        return true;
+    }
+    if (count < 0 && (errno == EINTR || errno == EAGAIN)) {
+        return true;
+    }
+    inputClosed = true;
+    return false;
+}
+
+size_t LineEditor::queryTerminalColumns() const {
+    struct winsize ws;
+    if (ioctl(outputFd, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) {
+        return ws.ws_col;
+    }
+    return 80;
+}
+
+bool LineEditor::readLine(const std::string& promptText, std::string& line) {
+    if (!interactive || !enableRawMode()) {
+        return false;
+    }
+
+    prompt = promptText;
+    buffer.clear();
+    cursor = 0;
+    historyIndex = history ? history->size() : 0;
+    savedLine.clear();
+    lastKey = EditorKey::None;
+    interrupted = false;
+    suggestion.clear();
+    suggestedFor.clear();
+    suggestionPending = false;
+    promptUpdate = false;
+
+    // The caller has already printed the prompt, so the cursor sits after it
+    drawnCells.clear();
+    windowResized = 0;
+    terminalColumns = queryTerminalColumns();
+    promptColumns = visibleWidth(prompt.substr(prompt.rfind('\n') + 1)) % terminalColumns;
+    cursorRow = 0;
+    cursorColumn = promptColumns;
+
+    bool done = false;
+    bool accepted = false;
+    while (!done) {
+        // Apply every key already buffered before drawing, so a paste or a
+        // burst of typing over a slow link costs one refresh, not one per byte
+        size_t pos = 0;
+        while (!done && pos < pending.size()) {
+            KeyEvent event;
+            size_t used = keyTrie.decode(pending, pos, false, event);
+            if (used == 0) {
+                if (readPending(ESCAPE_TIMEOUT_MS)) continue;
+                used = keyTrie.decode(pending, pos, true, event);
+            }
+            pos += used;
+            handleKey(event, done, accepted);
+        }
+        pending.erase(0, pos);
+        if (done) break;
+
+        if (readPending(0)) continue;
+
+        if (windowResized) {
+            windowResized = 0;
+            redrawAll(false);
+        }
+        if (promptUpdate) {
+            promptUpdate = false;
+            std::string newPrompt = prompt;
+            if (promptCallback && promptCallback(newPrompt) && newPrompt != prompt) {
+                replacePrompt(newPrompt);
+            }
+        }
+        updateSuggestion();
+        refresh();
+
+        // An unfinished suggestion search continues as soon as input is idle
+        if (!readPending(suggestionPending ? 0 : -1) && inputClosed) {
+            done = true;
+            accepted = false;
+        }
+    }
+
+    // Draw the final line without its suggestion, then leave the cursor on a
+    // fresh line below the input
+    suggestion.clear();
+    refresh();
+    size_t end = promptColumns + drawnCells.size();
+    moveTo(end / terminalColumns, end % terminalColumns);
+    if (interrupted) {
+        output += "^C";
+        buffer.clear();
+    }
+    output += "\r\n";
+    flush();
+    disableRawMode();
+
+    line = buffer;
+    return accepted;
+}
+
+void LineEditor::handleKey(const KeyEvent& event, bool& done, bool& accepted) {
+    switch (event.key) {
+        case EditorKey::Char:
+            buffer.insert(cursor, event.text);
+            cursor += event.text.size();
+            break;
+        case EditorKey::Enter:
+            done = true;
+            accepted = true;
+            break;
+        case EditorKey::Backspace:
+            if (cursor > 0) {
+                size_t start = cursor - 1;
+                while (start > 0 && isContinuation(static_cast<unsigned char>(buffer[start]))) {
+                    --start;
+                }
+                buffer.erase(start, cursor - start);
+                cursor = start;
+            }
+            break;
+        case EditorKey::EndOfFile:
+            if (buffer.empty()) {
+                done = true;
+                accepted = false;
+                break;
+            }
+            // Ctrl+D on a non-empty line deletes forward
+            [[fallthrough]];
+        case EditorKey::Delete:
+            if (cursor < buffer.size()) {
+                size_t end = cursor;
+                decodeCodepoint(buffer, end);
+                buffer.erase(cursor, end - cursor);
+            }
+            break;
+        case EditorKey::Left:
+            while (cursor > 0) {
+                --cursor;
+                if (!isContinuation(static_cast<unsigned char>(buffer[cursor]))) break;
+            }
+            break;
+        case EditorKey::Right:
+            if (cursor < buffer.size()) {
+                decodeCodepoint(buffer, cursor);
+            } else if (hasSuggestion()) {
+                acceptSuggestion(true);
+            }
+            break;
+        case EditorKey::Home:
+            cursor = 0;
+            break;
+        case EditorKey::End:
+            if (cursor == buffer.size() && hasSuggestion()) {
+                acceptSuggestion(true);
+            }
+            cursor = buffer.size();
+            break;
+        case EditorKey::WordLeft:
+            moveWordLeft();
+            break;
+        case EditorKey::WordRight:
+            if (cursor == buffer.size() && hasSuggestion()) {
+                acceptSuggestion(false);
+            } else {
+                moveWordRight();
+            }
+            break;
+        case EditorKey::DeleteWordLeft: {
+            size_t end = cursor;
+            moveWordLeft();
+            buffer.erase(cursor, end - cursor);
+            break;
+        }
+        case EditorKey::KillToEnd:
+            buffer.erase(cursor);
+            break;
+        case EditorKey::KillToStart:
+            buffer.erase(0, cursor);
+            cursor = 0;
+            break;
+        case EditorKey::ClearScreen:
+            redrawAll(true);
+            break;
+        case EditorKey::Interrupt:
+            // readLine echoes ^C after the line and hands back an empty command
+            interrupted = true;
+            done = true;
+            accepted = true;
+            break;
+        case EditorKey::Up:
+            recallHistory(true);
+            break;
+        case EditorKey::Down:
+            recallHistory(false);
+            break;
+        case EditorKey::Tab:
+            completeWord();
+            break;
+        case EditorKey::Escape:
+        case EditorKey::None:
+            break;
+    }
+    lastKey = event.key;
+}
+
+void LineEditor::moveWordLeft() {
+    while (cursor > 0 && !isWordByte(buffer[cursor - 1])) --cursor;
+    while (cursor > 0 && isWordByte(buffer[cursor - 1])) --cursor;
+}
+
+void LineEditor::moveWordRight() {
+    while (cursor < buffer.size() && !isWordByte(buffer[cursor])) ++cursor;
+    while (cursor < buffer.size() && isWordByte(buffer[cursor])) ++cursor;
+}
+
+void LineEditor::updateSuggestion() {
+    suggestionPending = false;
+    if (!suggester || buffer.empty() || cursor != buffer.size()) {
+        suggestion.clear();
+        suggestedFor.clear();
+        return;
+    }
+
+    bool finished = buffer == suggestedFor ? suggester->resume() : suggester->begin(buffer);
+    suggestedFor = buffer;
+    if (finished) {
+        suggestion = suggester->getSuggestion();
+    } else {
+        // Keep showing the previous suggestion while it still fits
+        suggestionPending = true;
+    }
+}
+
+bool LineEditor::hasSuggestion() const {
+    return suggestion.size() > buffer.size() && suggestion.compare(0, buffer.size(), buffer) == 0;
+}
+
+void LineEditor::acceptSuggestion(bool wholeLine) {
+    size_t end = suggestion.size();
+    if (!wholeLine) {
+        // Take the next word, like moveWordRight() over the suggested text
+        end = buffer.size();
+        while (end < suggestion.size() && !isWordByte(suggestion[end])) ++end;
+        while (end < suggestion.size() && isWordByte(suggestion[end])) ++end;
+    }
+    buffer.append(suggestion, buffer.size(), end - buffer.size());
+    cursor = buffer.size();
+}
+
+void LineEditor::recallHistory(bool older) {
+    if (!history || history->empty()) {
+        return;
+    }
+
+    if (historyIndex == history->size()) {
+        savedLine = buffer;
+    }
+
+    if (older) {
+        // Skip entries identical to what is already shown
+        size_t index = historyIndex;
+        while (index > 0) {
+            --index;
+            if ((*history)[index] != buffer) {
+                historyIndex = index;
+                buffer = (*history)[index];
+                break;
+            }
+        }
+    } else {
+        while (historyIndex < history->size()) {
+            ++historyIndex;
+            const std::string& candidate =
+                historyIndex == history->size() ? savedLine : (*history)[historyIndex];
+            if (candidate != buffer || historyIndex == history->size()) {
+                buffer = candidate;
+                break;
+            }
+        }
+    }
+    cursor = buffer.size();
+}
+
+void LineEditor::completeWord() {
+    if (!completionCallback) {
+        return;
+    }
+
+    CompletionResult result = completionCallback(buffer, cursor);
+    const auto& candidates = result.candidates;
+    if (candidates.empty()) {
+        output += "\a";
+        flush();
+        return;
+    }
+
+    std::string replacement;
+    if (candidates.size() == 1) {
+        replacement = candidates[0];
+        if (replacement.back() != '/') {
+            replacement += ' ';
+        }
+    } else {
+        // Extend the word to the longest prefix every candidate shares
+        auto sameByte = [&result](char a, char b) {
+            return result.ignoreCase ? std::tolower(static_cast<unsigned char>(a)) ==
+                                       std::tolower(static_cast<unsigned char>(b))
+                                     : a == b;
+        };
+        replacement = candidates[0];
+        for (size_t i = 1; i < candidates.size() && !replacement.empty(); ++i) {
+            size_t shared = 0;
+            while (shared < replacement.size() && shared < candidates[i].size() &&
+                   sameByte(replacement[shared], candidates[i][shared])) {
+                ++shared;
+            }
+            replacement.resize(shared);
+        }
+
+        if (replacement.size() <= result.end - result.start) {
+            if (lastKey == EditorKey::Tab) {
+                listCandidates(candidates);
+            } else {
+                output += "\a";
+                flush();
+            }
+            return;
+        }
+    }
+
+    buffer.replace(result.start, result.end - result.start, replacement);
+    cursor = result.start + replacement.size();
+}
+
+void LineEditor::listCandidates(const std::vector<std::string>& candidates) {
+    const size_t MAX_LISTED = 200;
+
+    // Show only the last path component of each candidate
+    std::vector<std::string> labels;
+    size_t width = 0;
+    for (size_t i = 0; i < candidates.size() && i < MAX_LISTED; ++i) {
+        const std::string& candidate = candidates[i];
+        size_t slash = candidate.find_last_of('/', candidate.size() >= 2 ? candidate.size() - 2 : 0);
+        labels.push_back(slash == std::string::npos ? candidate : candidate.substr(slash + 1));
+        width = std::max(width, visibleWidth(labels.back()) + 2);
+    }
+    size_t perRow = std::max<size_t>(1, terminalColumns / width);
+
+    output.clear();
+    size_t end = promptColumns + drawnCells.size();
+    moveTo(end / terminalColumns, end % terminalColumns);
+    output += "\r\n";
+    for (size_t i = 0; i < labels.size(); ++i) {
+        output += labels[i];
+        if ((i + 1) % perRow == 0 || i + 1 == labels.size()) {
+            output += "\r\n";
+        } else {
+            output.append(width - visibleWidth(labels[i]), ' ');
+        }
+    }
+    if (candidates.size() > labels.size()) {
+        output += "... and " + std::to_string(candidates.size() - labels.size()) + " more\r\n";
+    }
+    flush();
+
+    // Redraw the prompt and the line below the list
+    writePrompt();
+    flush();
+    drawnCells.clear();
+    cursorRow = 0;
+    cursorColumn = promptColumns;
+}
+
+void LineEditor::renderCells(std::vector<Cell>& cells, size_t& cursorCell) const {
+    cells.clear();
+    cursorCell = 0;
+
+    auto append = [&cells](const std::string& text, size_t& pos, uint8_t index) {
+        char32_t ch = decodeCodepoint(text, pos);
+        if (ch < 0x20 || ch == 0x7f) {
+            // Control characters are shown in caret notation
+            cells.push_back({U'^', index});
+            cells.push_back({static_cast<char32_t>(ch ^ 0x40), index});
+        } else {
+            cells.push_back({ch, index});
+        }
+    };
+
+    size_t pos = 0;
+    while (pos < buffer.size()) {
+        if (pos == cursor) {
+            cursorCell = cells.size();
+        }
+        uint8_t style = highlighter ? highlighter->getStyles()[pos] : 0;
+        append(buffer, pos, style);
+    }
+    if (cursor >= buffer.size()) {
+        cursorCell = cells.size();
+    }
+
+    // The suggestion trails the cursor and is only offered at end of line
+    if (cursor == buffer.size() && hasSuggestion()) {
+        pos = buffer.size();
+        while (pos < suggestion.size()) {
+            append(suggestion, pos, static_cast<uint8_t>(EditorStyle::Suggestion));
+        }
+    }
+}
+
+void LineEditor::refresh() {
+    if (highlighter) {
+        highlighter->update(buffer);
+    }
+
+    size_t cursorCell;
+    renderCells(nextCells, cursorCell);
+
+    output.clear();
+    const size_t oldSize = drawnCells.size();
+    const size_t newSize = nextCells.size();
+
+    size_t first = 0;
+    size_t common = std::min(oldSize, newSize);
+    while (first < common && drawnCells[first] == nextCells[first]) {
+        ++first;
+    }
+
+    if (first < oldSize || first < newSize) {
+        bool fitsOnOneRow = promptColumns + std::max(oldSize, newSize) < terminalColumns;
+        size_t delta = newSize > oldSize ? newSize - oldSize : oldSize - newSize;
+
+        // A pure insertion or deletion on a single row is sent as ICH/DCH
+        // plus the inserted characters instead of repainting the tail
+        bool tailShifted = false;
+        if (fitsOnOneRow && delta > 0 && first < std::min(oldSize, newSize)) {
+            const std::vector<Cell>& longer = newSize > oldSize ? nextCells : drawnCells;
+            const std::vector<Cell>& shorter = newSize > oldSize ? drawnCells : nextCells;
+            tailShifted = std::equal(shorter.begin() + first, shorter.end(),
+                                     longer.begin() + first + delta);
+        }
+
+        if (tailShifted) {
+            moveTo(0, promptColumns + first);
+            if (newSize > oldSize) {
+                appendSequence(output, delta, '@');
+                writeCells(nextCells, first, first + delta);
+            } else {
+                appendSequence(output, delta, 'P');
+            }
+        } else {
+            size_t last = newSize;
+            if (oldSize == newSize) {
+                while (last > first && drawnCells[last - 1] == nextCells[last - 1]) {
+                    --last;
+                }
+            }
+            size_t start = promptColumns + first;
+            moveTo(start / terminalColumns, start % terminalColumns);
+            writeCells(nextCells, first, last);
+
+            if (newSize < oldSize) {
+                size_t oldEndRow = (promptColumns + oldSize - 1) / terminalColumns;
+                output += oldEndRow > cursorRow ? "\033[J" : "\033[K";
+            }
+        }
+    }
+
+    size_t target = promptColumns + cursorCell;
+    moveTo(target / terminalColumns, target % terminalColumns);
+    drawnCells.swap(nextCells);
+    flush();
+}
+
+void LineEditor::redrawAll(bool clearScreen) {
+    output.clear();
+    if (clearScreen) {
+        output += "\033[H\033[2J";
+    } else {
+        // After a resize the old layout is meaningless; start on a new line
+        output += "\r\n";
+    }
+    writePrompt();
+    flush();
+
+    terminalColumns = queryTerminalColumns();
+    promptColumns = visibleWidth(prompt.substr(prompt.rfind('\n') + 1)) % terminalColumns;
+    drawnCells.clear();
+    cursorRow = 0;
+    cursorColumn = promptColumns;
+}
+
+void LineEditor::replacePrompt(const std::string& newPrompt) {
+    // Back to the first row of the old prompt, then clear and redraw from there
+    output.clear();
+    moveTo(0, 0);
+    size_t promptRows = static_cast<size_t>(std::count(prompt.begin(), prompt.end(), '\n'));
+    if (promptRows > 0) {
+        appendSequence(output, promptRows, 'A');
+    }
+    output += "\033[J";
+    prompt = newPrompt;
+    writePrompt();
+    flush();
+
+    promptColumns = visibleWidth(prompt.substr(prompt.rfind('\n') + 1)) % terminalColumns;
+    drawnCells.clear();
+    cursorRow = 0;
+    cursorColumn = promptColumns;
+}
+
+void LineEditor::writePrompt() {
+    // Output post-processing is off in raw mode, so expand newlines here
+    for (char c : prompt) {
+        if (c == '\n') output.push_back('\r');
+        output.push_back(c);
+    }
+}
+
+void LineEditor::moveTo(size_t row, size_t column) {
+    if (row < cursorRow) {
+        appendSequence(output, cursorRow - row, 'A');
+    } else if (row > cursorRow) {
+        appendSequence(output, row - cursorRow, 'B');
+    }
+
+    if (column != cursorColumn) {
+        if (column == 0) {
+            output.push_back('\r');
+        } else if (column + 1 == cursorColumn) {
+            output.push_back('\b');
+        } else if (column < cursorColumn) {
+            appendSequence(output, cursorColumn - column, 'D');
+        } else {
+            appendSequence(output, column - cursorColumn, 'C');
+        }
+    }
+
+    cursorRow = row;
+    cursorColumn = column;
+}
+
+void LineEditor::writeCells(const std::vector<Cell>& cells, size_t from, size_t to) {
+    uint8_t currentStyle = 0;
+    for (size_t i = from; i < to; ++i) {
+        uint8_t style = cells[i].style;
+        if (style != currentStyle) {
+            if (currentStyle != 0) {
+                output += "\033[0m";
+            }
+            if (style < styles.size()) {
+                output += styles[style];
+            }
+            currentStyle = style;
+        }
+
+        appendUtf8(output, cells[i].ch);
+
+        // Wrap explicitly so the tracked position never depends on the
+        // terminal's deferred-wrap behaviour at the right margin
+        if (++cursorColumn == terminalColumns) {
+            output += "\r\n";
+            cursorRow++;
+            cursorColumn = 0;
+        }
+    }
+    if (currentStyle != 0) {
+        output += "\033[0m";
+    }
+}
+
+void LineEditor::flush() {
+    size_t written = 0;
+    while (written < output.size()) {
+        ssize_t count = write(outputFd, output.data() + written, output.size() - written);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        written += static_cast<size_t>(count);
+    }
+    output.clear();
+}
+
+size_t LineEditor::visibleWidth(const std::string& text) {
+    size_t width = 0;
+    size_t i = 0;
+    while (i < text.size()) {
+        unsigned char byte = static_cast<unsigned char>(text[i]);
+        if (byte == 0x1b && i + 1 < text.size() && text[i + 1] == '[') {
+            // Skip SGR and other CSI sequences
+            i += 2;
+            while (i < text.size() && !(text[i] >= 0x40 && text[i] <= 0x7E)) ++i;
+            ++i;
+            continue;
+        }
+        if (byte >= 0x20 && !isContinuation(byte) && byte != 0x7f) {
+            width++;
+        }
+        ++i;
+    }
+    return width;
+}
@@ -1,14 +1,57 @@
 #include "shell.h"
+#include "config_schema.h"
+#include "startup_profiler.h"
+#include "utils.h"
 #include <iostream>
+#include <cstring>
+
+namespace {
+    // lynx config check [file] | lynx config schema
+    int runConfigCommand(int argc, char* argv[]) {
+        if (argc >= 3 && std::strcmp(argv[2], "check") == 0 && argc <= 4) {
+            std::string path = argc == 4 ? argv[3] : Utils::getHomeDirectory() + "/.lynx/config";
+            int errors = ConfigSchema::checkFile(path, std::cout);
+            if (errors == 0) {
+                std::cout << path << ": ok" << std::endl;
+            }
+            return errors == 0 ? 0 : 1;
+        }
+        if (argc == 3 && std::strcmp(argv[2], "schema") == 0) {
+            ConfigSchema::describe(std::cout);
+            return 0;
+        }
+        std::cerr << "usage: lynx config check [file]" << std::endl;
+        std::cerr << "       lynx config schema" << std::endl;
+        return 2;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 2 && std::strcmp(argv[1], "config") == 0) {
+        return runConfigCommand(argc, argv);
+    }
+
+    // --profile-startup prints a table to stderr; =<file> writes JSON
+    for (int i = 1; i < argc; ++i) {
+        const char* option = "--profile-startup";
+        size_t length = std::strlen(option);
+        if (std::strncmp(argv[i], option, length) == 0 && (argv[i][length] == '\0' || argv[i][length] == '=')) {
+            StartupProfiler::instance().start(argv[i][length] == '=' ? argv[i] + length + 1 : "");
+        } else {
+            std::cerr << "lynx: unknown option " << argv[i] << std::endl;
+            std::cerr << "usage: lynx [--profile-startup[=file.json]]" << std::endl;
+            std::cerr << "       lynx config check [file] | lynx config schema" << std::endl;
+            return 2;
+        }
+    }
 
-int main() {
     std::cout << "Welcome to Lynx Shell!" << std::endl;
     std::cout << "Type 'help' for available commands or 'exit' to quit." << std::endl;
     std::cout << std::endl;
-    
+
     Shell shell;
     shell.run();
-    
+
     std::cout << "Goodbye!" << std::endl;
     return 0;
 }
@@ -3,10 +3,172 @@
 #include "command.h"
 #include "config.h"
 #include "utils.h"
+#include "startup_profiler.h"
+#include "plugin_event_bus.h"
+#include "plugin_stats.h"
 #include <iostream>
 #include <filesystem>
 #include <dlfcn.h>
 #include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+namespace {
+    // Enough that one stuck plugin does not hold up the others
+    const size_t EVENT_WORKERS = 2;
+    
+    // How long async plugins get to see the shutdown event
+    const auto SHUTDOWN_DRAIN = std::chrono::milliseconds(500);
+    
+    // Loading is mostly waiting on disk and on plugins' own I/O, so this
+    // may exceed the core count
+    const size_t LOADER_THREADS = 8;
+    
+    // A library last written longer ago than this is taken to be a finished
+    // build, not one the linker is still writing
+    const int64_t RELOAD_SETTLE_NS = 300 * 1000000LL;
+    
+    // Handlers are timed one by one on this share of broadcasts; a clock
+    // read costs about as much as a typed handler call
+    const uint32_t SAMPLE_EVERY = 32;
+    
+    // Good to a few milliseconds, which is plenty for the budget, and a
+    // fraction of the cost of the precise clock
+    int64_t coarseNow() {
+#ifdef CLOCK_MONOTONIC_COARSE
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#else
+        return StartupProfiler::now();
+#endif
+    }
+    
+    double toMs(int64_t ns) {
+        return static_cast<double>(ns) / 1e6;
+    }
+    
+    // Handler times span nanoseconds to seconds; keep three or four digits
+    std::string formatDuration(int64_t ns) {
+        char text[32];
+        if (ns < 1000) {
+            std::snprintf(text, sizeof(text), "%lld ns", static_cast<long long>(ns));
+        } else if (ns < 1000000) {
+            std::snprintf(text, sizeof(text), "%.1f us", ns / 1e3);
+        } else if (ns < 1000000000) {
+            std::snprintf(text, sizeof(text), "%.1f ms", ns / 1e6);
+        } else {
+            std::snprintf(text, sizeof(text), "%.2f s", ns / 1e9);
+        }
+        return text;
+    }
+    
+    const char* const EVENT_NAMES[] = {
+        "SHELL_STARTUP", "SHELL_SHUTDOWN", "COMMAND_BEFORE",
+        "COMMAND_AFTER", "PROMPT_DISPLAY", "INPUT_RECEIVED"
+    };
+    static_assert(sizeof(EVENT_NAMES) / sizeof(EVENT_NAMES[0]) == static_cast<size_t>(PluginEvent::COUNT),
+                  "every plugin event needs a manifest name");
+    
+    // 0 when the file is gone
+    int64_t modifiedTime(const std::string& path) {
+        struct stat info;
+        return stat(path.c_str(), &info) == 0 ? Utils::getModificationTimeNs(info) : 0;
+    }
+    
+    bool isPluginLibrary(const std::filesystem::path& path) {
+        std::string extension = path.extension().string();
+        return extension == ".so" || extension == ".dylib" || extension == ".dll";
+    }
+    
+    // Manifest lists may be separated by commas, spaces or both
+    std::vector<std::string> splitList(const std::string& value) {
+        std::vector<std::string> items;
+        std::string item;
+        for (char c : value + ",") {
+            if (c == ',' || c == ' ' || c == '\t') {
+                if (!item.empty()) {
+                    items.push_back(item);
+                    item.clear();
+                }
+            } else {
+                item += c;
+            }
+        }
+        return items;
+    }
+}
+
+// Plugin Manifest Implementation
+std::string PluginManifest::pathFor(const std::string& libraryPath) {
+    return std::filesystem::path(libraryPath).replace_extension(".manifest").string();
+}
+
+bool PluginManifest::read(const std::string& path, PluginManifest& manifest, std::string& error) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        error = "cannot read file";
+        return false;
+    }
+    
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        line = Utils::trim(line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            error = "line " + std::to_string(lineNumber) + ": expected key = value";
+            return false;
+        }
+        std::string key = Utils::trim(line.substr(0, equals));
+        std::string value = Utils::trim(line.substr(equals + 1));
+        
+        if (key == "name") {
+            manifest.name = value;
+        } else if (key == "version") {
+            manifest.version = value;
+        } else if (key == "author") {
+            manifest.author = value;
+        } else if (key == "description") {
+            manifest.description = value;
+        } else if (key == "commands") {
+            manifest.commands = splitList(value);
+        } else if (key == "events") {
+            manifest.events = 0;
+            for (const auto& name : splitList(value)) {
+                auto match = std::find_if(std::begin(EVENT_NAMES), std::end(EVENT_NAMES), [&](const char* known) {
+                    return strcasecmp(known, name.c_str()) == 0;
+                });
+                if (match == std::end(EVENT_NAMES)) {
+                    error = "line " + std::to_string(lineNumber) + ": unknown event " + name;
+                    return false;
+                }
+                manifest.events |= pluginEventBit(static_cast<PluginEvent>(match - std::begin(EVENT_NAMES)));
+            }
+        } else if (key == "lazy") {
+            manifest.lazy = !(value == "false" || value == "no" || value == "off" || value == "0");
+        }
+        // Unknown keys are left for newer versions of the format
+    }
+    
+    if (manifest.name.empty()) {
+        error = "no plugin name";
+        return false;
+    }
+    return true;
+}
 
 // Plugin Manager Implementation
 PluginManager::PluginManager(Shell* shell) : shell(shell) {
@@ -37,14 +199,9 @@ std::vector<std::string> PluginManager::discoverPlugins() {
         
         try {
             for (const auto& entry : std::filesystem::directory_iterator(path)) {
-                if (entry.is_regular_file()) {
-                    std::string filename = entry.path().filename().string();
-                    // Look for shared library files (.so, .dylib, .dll)
-                    if (filename.find(".so") != std::string::npos || 
-                        filename.find(".dylib") != std::string::npos || 
-                        filename.find(".dll") != std::string::npos) {
-                        pluginFiles.push_back(entry.path().string());
-                    }
+                // Shared libraries only; libfoo.so.bak is not one
+                if (entry.is_regular_file() && isPluginLibrary(entry.path())) {
+                    pluginFiles.push_back(entry.path().string());
                 }
             }
         } catch (const std::filesystem::filesystem_error& e) {
@@ -56,10 +213,62 @@ std::vector<std::string> PluginManager::discoverPlugins() {
 }
 
 bool PluginManager::loadPlugin(const std::string& pluginPath) {
-    // Load the shared library
-    void* handle = dlopen(pluginPath.c_str(), RTLD_LAZY);
+    return openPlugin(pluginPath, true);
+}
+
+bool PluginManager::openPlugin(const std::string& pluginPath, bool announce, bool privateCopy) {
+    ProfileScope scope("plugin", std::filesystem::path(pluginPath).filename().string());
+    
+    OpenedPlugin opened;
+    bool openedLibrary;
+    {
+        ProfileScope loading("dlopen");
+        openedLibrary = openLibrary(pluginPath, opened, privateCopy);
+    }
+    if (!openedLibrary) {
+        std::cerr << opened.error << std::endl;
+        return false;
+    }
+    
+    std::string name = opened.plugin->getInfo().name;
+    double dlopenMs = toMs(opened.openedNs - opened.startNs);
+    if (!startPlugin(opened.plugin, opened.legacy, pluginPath, announce, dlopenMs)) {
+        discardLibrary(opened);
+        return false;
+    }
+    trackLibrary(name, opened);
+    return true;
+}
+
+// A private copy is a new file to the loader, so it is loaded fresh even
+// when the old build cannot be unmapped, and the build can be overwritten
+// in place without touching the running code
+bool PluginManager::openLibrary(const std::string& pluginPath, OpenedPlugin& opened, bool privateCopy) {
+    opened.path = pluginPath;
+    opened.startNs = StartupProfiler::now();
+    opened.modifiedNs = modifiedTime(pluginPath);
+    
+    std::string loadPath = pluginPath;
+    if (privateCopy) {
+        static std::atomic<unsigned> copies{0};
+        std::filesystem::path copy = std::filesystem::temp_directory_path() /
+            ("lynx-" + std::to_string(getpid()) + "-" + std::to_string(copies++) + "-" +
+             std::filesystem::path(pluginPath).filename().string());
+        std::error_code error;
+        if (!std::filesystem::copy_file(pluginPath, copy, std::filesystem::copy_options::overwrite_existing, error)) {
+            opened.error = "Cannot copy plugin " + pluginPath + ": " + error.message();
+            return false;
+        }
+        loadPath = copy.string();
+    }
+    
+    // Load the shared library; the mapping outlives a private copy's name
+    void* handle = dlopen(loadPath.c_str(), RTLD_LAZY);
+    if (privateCopy) {
+        unlink(loadPath.c_str());
+    }
     if (!handle) {
-        std::cerr << "Cannot load plugin " << pluginPath << ": " << dlerror() << std::endl;
+        opened.error = "Cannot load plugin " + pluginPath + ": " + dlerror();
         return false;
     }
     
@@ -72,7 +281,7 @@ bool PluginManager::loadPlugin(const std::string& pluginPath) {
     
     const char* dlsym_error = dlerror();
     if (dlsym_error) {
-        std::cerr << "Cannot load symbol createPlugin: " << dlsym_error << std::endl;
+        opened.error = std::string("Cannot load symbol createPlugin: ") + dlsym_error;
         dlclose(handle);
         return false;
     }
@@ -81,11 +290,14 @@ bool PluginManager::loadPlugin(const std::string& pluginPath) {
     typedef const char* (*get_api_version_t)();
     get_api_version_t getApiVersion = (get_api_version_t) dlsym(handle, "getPluginApiVersion");
     
+    // Without a version we cannot trust the vtable past onEvent()
+    bool legacy = true;
     if (getApiVersion) {
         std::string apiVersion = getApiVersion();
-        if (apiVersion != LYNX_PLUGIN_API_VERSION) {
-            std::cerr << "Plugin " << pluginPath << " has incompatible API version: " 
-                      << apiVersion << " (expected: " << LYNX_PLUGIN_API_VERSION << ")" << std::endl;
+        legacy = apiVersion == LYNX_PLUGIN_API_VERSION_LEGACY;
+        if (apiVersion != LYNX_PLUGIN_API_VERSION && !legacy) {
+            opened.error = "Plugin " + pluginPath + " has incompatible API version: " + apiVersion
+                         + " (expected: " + LYNX_PLUGIN_API_VERSION + ")";
             dlclose(handle);
             return false;
         }
@@ -94,73 +306,571 @@ bool PluginManager::loadPlugin(const std::string& pluginPath) {
     // Create the plugin instance
     std::unique_ptr<IPlugin> plugin(createPlugin());
     if (!plugin) {
-        std::cerr << "Failed to create plugin instance from " << pluginPath << std::endl;
+        opened.error = "Failed to create plugin instance from " + pluginPath;
         dlclose(handle);
         return false;
     }
     
-    // Initialize the plugin
-    if (!plugin->initialize(shell)) {
-        std::cerr << "Failed to initialize plugin from " << pluginPath << std::endl;
-        dlclose(handle);
+    opened.handle = handle;
+    opened.destroy = (void (*)(IPlugin*)) dlsym(handle, "destroyPlugin");
+    opened.plugin = std::move(plugin);
+    opened.legacy = legacy;
+    opened.openedNs = StartupProfiler::now();
+    return true;
+}
+
+// Deletes a plugin that never went into service with its library's own
+// destroyPlugin(), then closes the library
+void PluginManager::discardLibrary(OpenedPlugin& opened) {
+    if (opened.destroy) {
+        opened.destroy(opened.plugin.release());
+    } else {
+        opened.plugin.reset();
+    }
+    dlclose(opened.handle);
+    opened.handle = nullptr;
+}
+
+void PluginManager::trackLibrary(const std::string& pluginName, const OpenedPlugin& opened) {
+    libraries[pluginName] = {opened.path, opened.handle, opened.destroy, opened.modifiedNs, true};
+}
+
+bool PluginManager::addPlugin(std::unique_ptr<IPlugin> plugin) {
+    return plugin && startPlugin(plugin, false, "", false, 0);
+}
+
+// An empty path means an in-process plugin. The plugin is taken only once it
+// is in service; on failure it is left for the caller to delete.
+bool PluginManager::startPlugin(std::unique_ptr<IPlugin>& plugin, bool legacy, const std::string& pluginPath,
+                                bool announce, double dlopenMs) {
+    std::string name = plugin->getInfo().name;
+    
+    // Check if plugin with same name is already loaded
+    if (isPluginLoaded(name)) {
+        std::cerr << "Plugin " << name << " is already loaded" << std::endl;
+        return false;
+    }
+    if (!resolveDependencies(plugin->getInfo())) {
+        return false;
+    }
+    
+    int64_t startNs = StartupProfiler::now();
+    bool initialized;
+    {
+        ProfileScope initializing("initialize");
+        initialized = initializePlugin(*plugin, pluginPath.empty() ? name : pluginPath);
+    }
+    if (!initialized) {
         return false;
     }
+    loadTimes[name] = {dlopenMs, toMs(StartupProfiler::now() - startNs)};
+    
+    activatePlugin(std::move(plugin), legacy);
+    announcePlugin(name, announce);
+    return true;
+}
+
+bool PluginManager::resolveDependencies(const PluginInfo& info) {
+    for (const auto& dependency : info.dependencies) {
+        if (!isPluginLoaded(dependency) && !loadDeferred(dependency)) {
+            std::cerr << "Plugin " << info.name << " needs " << dependency
+                      << ", which is not installed" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// May run on a loader thread, alongside other plugins' initialize()
+bool PluginManager::initializePlugin(IPlugin& plugin, const std::string& source) {
+    std::string name = plugin.getInfo().name;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        initializingPlugins.insert(name);
+    }
     
-    // Get plugin info and store
+    // It may register its commands from here
+    bool initialized = false;
+    try {
+        initialized = plugin.initialize(shell);
+    } catch (const std::exception& e) {
+        std::cerr << "Plugin " << name << " threw exception during initialization: " << e.what() << std::endl;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        initializingPlugins.erase(name);
+    }
+    if (!initialized) {
+        std::cerr << "Failed to initialize plugin " << source << std::endl;
+        removeCommandsOf(name);
+    }
+    return initialized;
+}
+
+void PluginManager::activatePlugin(std::unique_ptr<IPlugin> plugin, bool legacy) {
     const PluginInfo& info = plugin->getInfo();
     
-    // Check if plugin with same name is already loaded
-    if (isPluginLoaded(info.name)) {
-        std::cerr << "Plugin " << info.name << " is already loaded" << std::endl;
-        plugin->shutdown();
-        dlclose(handle);
-        return false;
+    auto& stats = pluginStats[info.name];
+    if (!stats) {
+        stats = std::make_unique<PluginStats>();
     }
     
-    // Store the plugin
-    loadedPlugins[info.name] = std::move(plugin);
+    // A 1.0.0 vtable has no subscribedEvents() slot, so those get everything
+    Subscription subscription{legacy ? ALL_PLUGIN_EVENTS : plugin->subscribedEvents(), legacy, nullptr, stats.get()};
+    if (subscription.mask & PLUGIN_EVENTS_ASYNC) {
+        if (!eventBus) {
+            eventBus = std::make_unique<PluginEventBus>(EVENT_WORKERS);
+        }
+        subscription.queue = eventBus->attach(plugin.get(), info.name, stats.get());
+    }
+    subscriptions[info.name] = subscription;
     
-    std::cout << "Loaded plugin: " << info.name << " v" << info.version 
-              << " by " << info.author << std::endl;
+    // Store the plugin
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        std::string name = info.name;
+        loadedPlugins[name] = std::move(plugin);
+    }
+    rebuildSubscribers();
+}
+
+void PluginManager::announcePlugin(const std::string& pluginName, bool announce) {
+    const PluginInfo& info = getPlugin(pluginName)->getInfo();
+    if (announce) {
+        std::cout << "Loaded plugin: " << info.name << " v" << info.version 
+                  << " by " << info.author << std::endl;
+    }
     
     // Broadcast plugin loaded event
-    std::map<std::string, std::string> context;
-    context["plugin_name"] = info.name;
-    context["plugin_version"] = info.version;
-    broadcastEvent(PluginEvent::SHELL_STARTUP, context);
+    if (hasSubscribers(PluginEvent::SHELL_STARTUP)) {
+        PluginEventData event(PluginEvent::SHELL_STARTUP);
+        event.pluginName = info.name;
+        event.pluginVersion = info.version;
+        broadcastEvent(event);
+    }
+}
+
+bool PluginManager::unloadPlugin(const std::string& pluginName) {
+    if (!isPluginLoaded(pluginName)) {
+        return false;
+    }
+    removePlugin(pluginName);
     
+    auto library = libraries.find(pluginName);
+    if (library != libraries.end()) {
+        library->second.watched = false;
+    }
+    std::cout << "Unloaded plugin: " << pluginName << std::endl;
     return true;
 }
 
-bool PluginManager::unloadPlugin(const std::string& pluginName) {
-    auto it = loadedPlugins.find(pluginName);
-    if (it == loadedPlugins.end()) {
+bool PluginManager::reloadPlugin(const std::string& pluginName) {
+    auto library = libraries.find(pluginName);
+    if (library == libraries.end()) {
+        if (deferredPlugins.count(pluginName)) {
+            std::cerr << "lynx: plugins: " << pluginName << " is not loaded yet; its first use loads the current build" << std::endl;
+        } else {
+            std::cerr << "lynx: plugins: " << pluginName << " was not loaded from a plugin library" << std::endl;
+        }
         return false;
     }
     
+    // Dependents may hold on to the old instance
+    for (const auto& [name, plugin] : loadedPlugins) {
+        const auto& dependencies = plugin->getInfo().dependencies;
+        if (name != pluginName && std::find(dependencies.begin(), dependencies.end(), pluginName) != dependencies.end()) {
+            std::cerr << "lynx: plugins: cannot reload " << pluginName << " while " << name
+                      << " depends on it" << std::endl;
+            return false;
+        }
+    }
+    
+    std::string path = library->second.path;
+    if (isPluginLoaded(pluginName)) {
+        removePlugin(pluginName);
+    }
+    
+    // The entry is replaced when the new build loads; if it does not, the
+    // plugin stays unloaded until the library changes again
+    if (!openPlugin(path, false, true)) {
+        library->second.modifiedNs = modifiedTime(path);
+        std::cerr << "lynx: plugins: " << pluginName << " did not reload and is no longer loaded" << std::endl;
+        return false;
+    }
+    if (!isPluginLoaded(pluginName)) {
+        library->second.watched = false;
+        std::cerr << "lynx: plugins: " << path << " no longer contains plugin " << pluginName << std::endl;
+        return false;
+    }
+    
+    const PluginInfo& info = getPlugin(pluginName)->getInfo();
+    std::cout << "Reloaded plugin: " << info.name << " v" << info.version << " by " << info.author << std::endl;
+    return true;
+}
+
+void PluginManager::reloadChangedPlugins() {
+    int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::vector<std::string> changed;
+    for (const auto& [name, library] : libraries) {
+        int64_t modifiedNs = library.watched ? modifiedTime(library.path) : 0;
+        if (modifiedNs != 0 && modifiedNs != library.modifiedNs && nowNs - modifiedNs >= RELOAD_SETTLE_NS) {
+            changed.push_back(name);
+        }
+    }
+    for (const auto& name : changed) {
+        reloadPlugin(name);
+    }
+}
+
+// Takes the plugin out of service and closes its library, without a word
+void PluginManager::removePlugin(const std::string& pluginName) {
+    // No handler may still be running on a worker when it shuts down
+    auto subscription = subscriptions.find(pluginName);
+    if (subscription != subscriptions.end() && subscription->second.queue) {
+        eventBus->detach(subscription->second.queue);
+    }
+    
     // Shutdown the plugin
-    it->second->shutdown();
+    getPlugin(pluginName)->shutdown();
     
     // Remove any commands registered by this plugin
-    auto cmdIt = pluginCommands.begin();
-    while (cmdIt != pluginCommands.end()) {
-        // Note: We would need to track which plugin registered which command
-        // For now, we'll implement a simple approach
-        ++cmdIt;
-    }
+    removeCommandsOf(pluginName);
     
     // Remove the plugin
-    loadedPlugins.erase(it);
+    std::unique_ptr<IPlugin> plugin;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        auto it = loadedPlugins.find(pluginName);
+        plugin = std::move(it->second);
+        loadedPlugins.erase(it);
+    }
+    subscriptions.erase(pluginName);
+    loadTimes.erase(pluginName);
+    rebuildSubscribers();
     
-    std::cout << "Unloaded plugin: " << pluginName << std::endl;
-    return true;
+    closePlugin(pluginName, std::move(plugin));
+}
+
+// Sets a plugin and its library aside to be deleted and closed by
+// closeRetiredPlugins(). A plugin may be unloading itself from one of its own
+// handlers, which has to be able to return first.
+void PluginManager::closePlugin(const std::string& pluginName, std::unique_ptr<IPlugin> plugin) {
+    RetiredPlugin retired;
+    retired.plugin = std::move(plugin);
+    auto library = libraries.find(pluginName);
+    if (library != libraries.end() && library->second.handle) {
+        retired.handle = library->second.handle;
+        retired.destroy = library->second.destroy;
+        library->second.handle = nullptr;
+    }
+    retiredPlugins.push_back(std::move(retired));
+}
+
+// Deletes each plugin with its library's own destroyPlugin(), then closes the
+// library; nothing of the plugin's may be left to call into by now
+void PluginManager::closeRetiredPlugins() {
+    std::vector<RetiredPlugin> retired;
+    retired.swap(retiredPlugins);
+    for (auto& entry : retired) {
+        if (entry.destroy) {
+            entry.destroy(entry.plugin.release());
+        } else {
+            entry.plugin.reset();
+        }
+        if (entry.handle) {
+            dlclose(entry.handle);
+        }
+    }
 }
 
 void PluginManager::loadAllPlugins() {
-    std::vector<std::string> plugins = discoverPlugins();
+    std::vector<std::string> plugins;
+    {
+        ProfileScope scope("discover");
+        plugins = discoverPlugins();
+    }
     
+    // Plugins with a manifest wait for first use; the rest load now
+    std::vector<std::string> eager;
     for (const auto& pluginPath : plugins) {
-        loadPlugin(pluginPath);
+        std::string manifestPath = PluginManifest::pathFor(pluginPath);
+        if (access(manifestPath.c_str(), F_OK) == 0) {
+            ProfileScope scope("manifest", std::filesystem::path(manifestPath).filename().string());
+            PluginManifest manifest;
+            manifest.libraryPath = pluginPath;
+            std::string error;
+            if (!PluginManifest::read(manifestPath, manifest, error)) {
+                std::cerr << "lynx: " << manifestPath << ": " << error << "; loading the plugin now" << std::endl;
+            } else if (manifest.lazy) {
+                deferPlugin(manifest);
+                continue;
+            }
+        }
+        eager.push_back(pluginPath);
+    }
+    
+    if (eager.size() > 1) {
+        loadInParallel(eager);
+    } else {
+        for (const auto& pluginPath : eager) {
+            loadPlugin(pluginPath);
+        }
+    }
+}
+
+void PluginManager::loadInParallel(const std::vector<std::string>& pluginPaths) {
+    ProfileScope scope("parallel load");
+    size_t count = pluginPaths.size();
+    size_t threadCount = std::min(count, LOADER_THREADS);
+    std::vector<OpenedPlugin> opened(count);
+    
+    // dlopen, symbol lookup and construction; no shared state
+    {
+        std::atomic<size_t> next{0};
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&] {
+                for (size_t i = next++; i < count; i = next++) {
+                    openLibrary(pluginPaths[i], opened[i]);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    
+    // Dependency graph; dependencies outside this batch must already be
+    // loaded or loadable from a manifest
+    enum class State : uint8_t { Skipped, Waiting, Loaded, Failed };
+    std::vector<State> state(count, State::Skipped);
+    std::vector<size_t> waitingOn(count, 0);
+    std::vector<std::vector<size_t>> dependents(count);
+    std::map<std::string, size_t> byName;
+    for (size_t i = 0; i < count; ++i) {
+        if (!opened[i].plugin) {
+            std::cerr << opened[i].error << std::endl;
+            continue;
+        }
+        const std::string& name = opened[i].plugin->getInfo().name;
+        if (isPluginLoaded(name) || byName.count(name)) {
+            std::cerr << "Plugin " << name << " is already loaded" << std::endl;
+            continue;
+        }
+        byName[name] = i;
+        state[i] = State::Waiting;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (state[i] != State::Waiting) {
+            continue;
+        }
+        const PluginInfo& info = opened[i].plugin->getInfo();
+        for (const auto& dependency : info.dependencies) {
+            auto found = byName.find(dependency);
+            if (found != byName.end() && found->second != i) {
+                dependents[found->second].push_back(i);
+                ++waitingOn[i];
+            } else if (!isPluginLoaded(dependency) && !loadDeferred(dependency)) {
+                std::cerr << "Plugin " << info.name << " needs " << dependency
+                          << ", which is not installed" << std::endl;
+                state[i] = State::Failed;
+            }
+        }
+    }
+    
+    // Initialize in dependency order, as many at once as are ready. Results
+    // come back to this thread, which stores each plugin before releasing
+    // the plugins that depend on it.
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<size_t> ready;
+    std::deque<std::pair<size_t, bool>> finished;
+    size_t running = 0;
+    bool stopping = false;
+    
+    std::function<void(size_t)> fail = [&](size_t i) {
+        for (size_t dependent : dependents[i]) {
+            if (state[dependent] == State::Waiting) {
+                std::cerr << "Plugin " << opened[dependent].plugin->getInfo().name << " needs "
+                          << opened[i].plugin->getInfo().name << ", which failed to load" << std::endl;
+                state[dependent] = State::Failed;
+                fail(dependent);
+            }
+        }
+    };
+    for (size_t i = 0; i < count; ++i) {
+        if (state[i] == State::Failed) {
+            fail(i);
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (state[i] == State::Waiting && waitingOn[i] == 0) {
+            ready.push_back(i);
+        }
+    }
+    
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&] {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;) {
+                changed.wait(lock, [&] { return stopping || !ready.empty(); });
+                if (ready.empty()) {
+                    return;
+                }
+                size_t i = ready.front();
+                ready.pop_front();
+                ++running;
+                lock.unlock();
+                
+                OpenedPlugin& entry = opened[i];
+                entry.initializeStartNs = StartupProfiler::now();
+                bool initialized = initializePlugin(*entry.plugin, entry.path);
+                entry.initializeEndNs = StartupProfiler::now();
+                
+                lock.lock();
+                --running;
+                finished.emplace_back(i, initialized);
+                changed.notify_all();
+            }
+        });
+    }
+    
+    std::vector<std::string> order;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            changed.wait(lock, [&] { return !finished.empty() || (running == 0 && ready.empty()); });
+            if (finished.empty()) {
+                break;
+            }
+            auto [i, initialized] = finished.front();
+            finished.pop_front();
+            lock.unlock();
+            
+            OpenedPlugin& entry = opened[i];
+            if (initialized) {
+                std::string name = entry.plugin->getInfo().name;
+                loadTimes[name] = {toMs(entry.openedNs - entry.startNs),
+                                   toMs(entry.initializeEndNs - entry.initializeStartNs)};
+                activatePlugin(std::move(entry.plugin), entry.legacy);
+                trackLibrary(name, entry);
+                order.push_back(name);
+                state[i] = State::Loaded;
+            } else {
+                state[i] = State::Failed;
+                fail(i);
+            }
+            
+            lock.lock();
+            if (initialized) {
+                for (size_t dependent : dependents[i]) {
+                    if (state[dependent] == State::Waiting && --waitingOn[dependent] == 0) {
+                        ready.push_back(dependent);
+                    }
+                }
+                changed.notify_all();
+            }
+        }
+        stopping = true;
+    }
+    changed.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    // Whatever is still waiting depends on itself, one way or another
+    for (size_t i = 0; i < count; ++i) {
+        if (state[i] == State::Waiting) {
+            std::cerr << "Plugin " << opened[i].plugin->getInfo().name
+                      << " is part of a dependency cycle" << std::endl;
+            state[i] = State::Failed;
+        }
+        // Failed, or a duplicate that was never started
+        if (state[i] != State::Loaded && opened[i].handle) {
+            discardLibrary(opened[i]);
+        }
+    }
+    
+    if (StartupProfiler::active) {
+        StartupProfiler& profiler = StartupProfiler::instance();
+        for (const auto& entry : opened) {
+            if (entry.openedNs == 0) {
+                continue;
+            }
+            int64_t endNs = entry.initializeEndNs ? entry.initializeEndNs : entry.openedNs;
+            profiler.addPhase("plugin", std::filesystem::path(entry.path).filename().string(), 0, entry.startNs, endNs);
+            profiler.addPhase("dlopen", "", 1, entry.startNs, entry.openedNs);
+            if (entry.initializeEndNs) {
+                profiler.addPhase("initialize", "", 1, entry.initializeStartNs, entry.initializeEndNs);
+            }
+        }
+    }
+    
+    // Announced in the order they came up, now that none are still starting
+    for (const auto& name : order) {
+        announcePlugin(name, true);
+    }
+}
+
+bool PluginManager::deferPlugin(const PluginManifest& manifest) {
+    if (isPluginLoaded(manifest.name) || deferredPlugins.count(manifest.name)) {
+        std::cerr << "Plugin " << manifest.name << " is already loaded" << std::endl;
+        return false;
+    }
+    for (const auto& command : manifest.commands) {
+        if (pluginCommands.count(command) || deferredCommands.count(command)) {
+            std::cerr << "Command " << command << " is already registered" << std::endl;
+            continue;
+        }
+        deferredCommands[command] = manifest.name;
+    }
+    
+    // Nothing to shut down in a plugin that never started
+    deferredMask |= manifest.events & ~pluginEventBit(PluginEvent::SHELL_SHUTDOWN);
+    deferredPlugins[manifest.name] = manifest;
+    return true;
+}
+
+bool PluginManager::loadDeferred(const std::string& pluginName) {
+    auto it = deferredPlugins.find(pluginName);
+    if (it == deferredPlugins.end()) {
+        return isPluginLoaded(pluginName);
+    }
+    
+    // Take it off the books first; a plugin that fails to load stays unloaded
+    PluginManifest manifest = std::move(it->second);
+    deferredPlugins.erase(it);
+    for (auto command = deferredCommands.begin(); command != deferredCommands.end();) {
+        command = command->second == pluginName ? deferredCommands.erase(command) : std::next(command);
+    }
+    deferredMask = 0;
+    for (const auto& [name, other] : deferredPlugins) {
+        deferredMask |= other.events & ~pluginEventBit(PluginEvent::SHELL_SHUTDOWN);
+    }
+    
+    if (!openPlugin(manifest.libraryPath, false)) {
+        return false;
+    }
+    if (!isPluginLoaded(manifest.name)) {
+        std::cerr << "lynx: " << PluginManifest::pathFor(manifest.libraryPath) << " names plugin "
+                  << manifest.name << ", but the library is a different plugin" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void PluginManager::loadDeferredFor(PluginEvent event) {
+    std::vector<std::string> names;
+    for (const auto& [name, manifest] : deferredPlugins) {
+        if (manifest.events & pluginEventBit(event)) {
+            names.push_back(name);
+        }
+    }
+    for (const auto& name : names) {
+        loadDeferred(name);
     }
 }
 
@@ -168,20 +878,46 @@ void PluginManager::unloadAllPlugins() {
     // Broadcast shutdown event before unloading
     broadcastEvent(PluginEvent::SHELL_SHUTDOWN);
     
+    // Give async plugins a moment to see it, then stop their delivery
+    if (eventBus) {
+        eventBus->drain(SHUTDOWN_DRAIN);
+        for (const auto& [name, subscription] : subscriptions) {
+            if (subscription.queue) {
+                eventBus->detach(subscription.queue);
+            }
+        }
+    }
+    
     // Unload all plugins
     for (auto& [name, plugin] : loadedPlugins) {
         plugin->shutdown();
     }
     
-    loadedPlugins.clear();
-    pluginCommands.clear();
+    std::map<std::string, std::unique_ptr<IPlugin>> plugins;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        plugins.swap(loadedPlugins);
+        pluginCommands.clear();
+        commandOwners.clear();
+    }
+    for (auto& [name, plugin] : plugins) {
+        closePlugin(name, std::move(plugin));
+    }
+    subscriptions.clear();
+    deferredPlugins.clear();
+    deferredCommands.clear();
+    deferredMask = 0;
+    rebuildSubscribers();
+    closeRetiredPlugins();
 }
 
 bool PluginManager::isPluginLoaded(const std::string& pluginName) const {
+    std::lock_guard<std::mutex> lock(registryMutex);
     return loadedPlugins.find(pluginName) != loadedPlugins.end();
 }
 
 IPlugin* PluginManager::getPlugin(const std::string& pluginName) const {
+    std::lock_guard<std::mutex> lock(registryMutex);
     auto it = loadedPlugins.find(pluginName);
     return (it != loadedPlugins.end()) ? it->second.get() : nullptr;
 }
@@ -195,7 +931,9 @@ std::vector<std::string> PluginManager::getLoadedPluginNames() const {
 }
 
 bool PluginManager::registerCommand(const std::string& pluginName, const PluginCommand& command) {
-    if (!isPluginLoaded(pluginName)) {
+    // Plugins initializing on loader threads register concurrently
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (loadedPlugins.find(pluginName) == loadedPlugins.end() && !initializingPlugins.count(pluginName)) {
         return false;
     }
     
@@ -205,39 +943,299 @@ bool PluginManager::registerCommand(const std::string& pluginName, const PluginC
     }
     
     pluginCommands[command.name] = command;
+    commandOwners[command.name] = pluginName;
     return true;
 }
 
 bool PluginManager::unregisterCommand(const std::string& commandName) {
+    std::lock_guard<std::mutex> lock(registryMutex);
     auto it = pluginCommands.find(commandName);
     if (it != pluginCommands.end()) {
         pluginCommands.erase(it);
+        commandOwners.erase(commandName);
         return true;
     }
     return false;
 }
 
+void PluginManager::removeCommandsOf(const std::string& pluginName) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (auto it = commandOwners.begin(); it != commandOwners.end();) {
+        if (it->second == pluginName) {
+            pluginCommands.erase(it->first);
+            it = commandOwners.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 bool PluginManager::executePluginCommand(const Command& cmd) {
+    // First use of a command from a deferred plugin loads it
+    auto deferred = deferredCommands.find(cmd.name);
+    if (deferred != deferredCommands.end()) {
+        std::string pluginName = deferred->second;
+        if (!loadDeferred(pluginName)) {
+            return false;
+        }
+        if (pluginCommands.find(cmd.name) == pluginCommands.end()) {
+            std::cerr << "lynx: plugin " << pluginName << " did not register " << cmd.name << std::endl;
+            return false;
+        }
+    }
+    
     auto it = pluginCommands.find(cmd.name);
-    if (it != pluginCommands.end()) {
-        return it->second.handler(cmd, shell);
+    if (it == pluginCommands.end()) {
+        return false;
     }
-    return false;
+    
+    // A copy to run from, and the owner looked up again afterwards, in case
+    // the command unloads or reloads its own plugin
+    std::function<bool(const Command&, Shell*)> handler = it->second.handler;
+    std::string owner = commandOwners[cmd.name];
+    int64_t startNs = StartupProfiler::now();
+    bool handled = handler(cmd, shell);
+    int64_t elapsedNs = StartupProfiler::now() - startNs;
+    auto stats = pluginStats.find(owner);
+    if (stats != pluginStats.end()) {
+        stats->second->latency[PluginStats::COMMANDS].record(elapsedNs);
+        ++stats->second->calls[PluginStats::COMMANDS];
+    }
+    return handled;
 }
 
 bool PluginManager::isPluginCommand(const std::string& commandName) const {
-    return pluginCommands.find(commandName) != pluginCommands.end();
+    return pluginCommands.find(commandName) != pluginCommands.end() ||
+           deferredCommands.find(commandName) != deferredCommands.end();
 }
 
-void PluginManager::broadcastEvent(PluginEvent event, const std::map<std::string, std::string>& context) {
-    for (auto& [name, plugin] : loadedPlugins) {
+std::vector<std::string> PluginManager::getCommandNames() const {
+    std::vector<std::string> names;
+    for (const auto& [name, command] : pluginCommands) {
+        names.push_back(name);
+    }
+    for (const auto& [name, plugin] : deferredCommands) {
+        names.push_back(name);
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+std::map<std::string, std::string> PluginManager::legacyContext(const PluginEventData& event) {
+    std::map<std::string, std::string> context;
+    switch (event.type) {
+        case PluginEvent::SHELL_STARTUP:
+            if (!event.pluginName.empty()) {
+                context["plugin_name"] = std::string(event.pluginName);
+                context["plugin_version"] = std::string(event.pluginVersion);
+            }
+            break;
+        case PluginEvent::COMMAND_BEFORE:
+            context["command"] = std::string(event.command);
+            context["args"] = "";
+            if (event.args) {
+                for (const auto& arg : *event.args) {
+                    context["args"] += arg + " ";
+                }
+            }
+            break;
+        case PluginEvent::COMMAND_AFTER:
+            context["command"] = std::string(event.command);
+            context["exit_code"] = std::to_string(event.exitCode);
+            context["success"] = event.success ? "true" : "false";
+            break;
+        case PluginEvent::PROMPT_DISPLAY:
+            context["directory"] = std::string(event.directory);
+            context["exit_code"] = std::to_string(event.exitCode);
+            break;
+        case PluginEvent::INPUT_RECEIVED:
+            context["input"] = std::string(event.input);
+            break;
+        default:
+            break;
+    }
+    return context;
+}
+
+void PluginManager::rebuildSubscribers() {
+    subscribedMask = 0;
+    for (size_t i = 0; i < static_cast<size_t>(PluginEvent::COUNT); ++i) {
+        for (const Subscriber& subscriber : subscribers[i]) {
+            subscriber.stats->calls[i] += subscriber.calls;
+        }
+        subscribers[i].clear();
+    }
+    for (const auto& [name, plugin] : loadedPlugins) {
+        const Subscription& subscription = subscriptions[name];
+        subscribedMask |= subscription.mask & ALL_PLUGIN_EVENTS;
+        
+        // The stats key outlives the plugin, should a handler unload it
+        const std::string* statsName = &pluginStats.find(name)->first;
+        for (size_t i = 0; i < static_cast<size_t>(PluginEvent::COUNT); ++i) {
+            if (subscription.mask & pluginEventBit(static_cast<PluginEvent>(i))) {
+                subscribers[i].push_back({plugin.get(), statsName, subscription.legacy, subscription.queue,
+                                          subscription.stats, 0});
+            }
+        }
+    }
+}
+
+void PluginManager::broadcastEvent(const PluginEventData& event) {
+    if (event.type >= PluginEvent::COUNT) {
+        return;
+    }
+    if (deferredMask & pluginEventBit(event.type)) {
+        loadDeferredFor(event.type);
+    }
+    // Indexed, so a handler that loads or unloads a plugin cannot leave us
+    // with a dangling iterator
+    size_t slot = static_cast<size_t>(event.type);
+    auto& list = subscribers[slot];
+    
+    // onEvent() handlers share one string map, built on first use
+    std::map<std::string, std::string> context;
+    bool contextBuilt = false;
+    auto deliver = [&](const Subscriber& target) {
         try {
-            plugin->onEvent(event, context);
+            if (target.legacy || !target.plugin->handleEvent(event)) {
+                if (!contextBuilt) {
+                    context = legacyContext(event);
+                    contextBuilt = true;
+                }
+                target.plugin->onEvent(event.type, context);
+            }
         } catch (const std::exception& e) {
-            std::cerr << "Plugin " << name << " threw exception during event handling: " 
+            std::cerr << "Plugin " << *target.name << " threw exception during event handling: " 
                       << e.what() << std::endl;
         }
+    };
+    
+    // Handlers are timed precisely for the histograms on a sample of
+    // broadcasts. On the rest the coarse clock still holds every handler to
+    // the budget, so a one-off stall is caught whenever it happens.
+    bool timed = untilSample[slot] == 0;
+    untilSample[slot] = timed ? SAMPLE_EVERY - 1 : untilSample[slot] - 1;
+    if (!timed) {
+        bool budgeted = eventBudgetNs > 0;
+        int64_t startNs = budgeted ? coarseNow() : 0;
+        for (size_t i = 0; i < list.size(); ++i) {
+            ++list[i].calls;
+            Subscriber target = list[i];
+            if (target.queue) {
+                eventBus->post(target.queue, event);
+                continue;
+            }
+            deliver(target);
+            if (budgeted) {
+                int64_t endNs = coarseNow();
+                if (endNs - startNs > eventBudgetNs) {
+                    checkBudget(*target.name, *target.stats, event.type, endNs - startNs);
+                    endNs = coarseNow();
+                }
+                startNs = endNs;
+            }
+        }
+        return;
     }
+    
+    // Each handler ends where the next one starts, so one clock read apiece;
+    // async plugins are timed on the worker
+    int64_t startNs = -1;
+    for (size_t i = 0; i < list.size(); ++i) {
+        ++list[i].calls;
+        Subscriber target = list[i];
+        if (target.queue) {
+            eventBus->post(target.queue, event);
+            startNs = -1;
+            continue;
+        }
+        if (startNs < 0) {
+            startNs = StartupProfiler::now();
+        }
+        deliver(target);
+        int64_t endNs = StartupProfiler::now();
+        target.stats->latency[slot].record(endNs - startNs);
+        if (eventBudgetNs > 0 && endNs - startNs > eventBudgetNs) {
+            checkBudget(*target.name, *target.stats, event.type, endNs - startNs);
+            endNs = StartupProfiler::now();
+        }
+        startNs = endNs;
+    }
+}
+
+void PluginManager::checkBudget(const std::string& pluginName, PluginStats& stats, PluginEvent event, int64_t ns) {
+    size_t slot = static_cast<size_t>(event);
+    stats.overBudget[slot].store(stats.overBudget[slot].load(std::memory_order_relaxed) + 1,
+                                 std::memory_order_relaxed);
+    if (stats.warned[slot]) {
+        return;
+    }
+    stats.warned[slot] = true;
+    std::cerr << "lynx: plugin " << pluginName << " took " << formatDuration(ns) << " in "
+              << eventName(event) << " (budget " << eventBudgetNs / 1000000
+              << " ms); see 'plugins stats'" << std::endl;
+}
+
+const char* PluginManager::eventName(PluginEvent event) {
+    return event < PluginEvent::COUNT ? EVENT_NAMES[static_cast<size_t>(event)] : "UNKNOWN";
+}
+
+void PluginManager::setEventBudget(int milliseconds) {
+    eventBudgetNs = static_cast<int64_t>(std::max(milliseconds, 0)) * 1000000;
+}
+
+bool PluginManager::printStats(const std::string& pluginName) const {
+    if (!pluginName.empty() && !pluginStats.count(pluginName)) {
+        std::cerr << "lynx: plugins: no stats for " << pluginName << std::endl;
+        return false;
+    }
+    
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-20s %-16s %8s %8s %10s %10s %10s %10s %6s",
+                  "plugin", "handler", "calls", "timed", "mean", "p50", "p99", "max", "over");
+    std::cout << line << std::endl;
+    for (const auto& [name, stats] : pluginStats) {
+        if (!pluginName.empty() && name != pluginName) {
+            continue;
+        }
+        std::string label = isPluginLoaded(name) ? name : name + " (unloaded)";
+        bool any = false;
+        for (size_t slot = 0; slot <= PluginStats::COMMANDS; ++slot) {
+            // Calls since the subscribers were last rebuilt are still counted there
+            uint64_t calls = stats->calls[slot];
+            if (slot < PluginStats::COMMANDS) {
+                for (const Subscriber& subscriber : subscribers[slot]) {
+                    calls += subscriber.stats == stats.get() ? subscriber.calls : 0;
+                }
+            }
+            const LatencyHistogram& latency = stats->latency[slot];
+            if (calls == 0 && latency.count() == 0) {
+                continue;
+            }
+            const char* handler = slot == PluginStats::COMMANDS ? "commands" : eventName(static_cast<PluginEvent>(slot));
+            std::snprintf(line, sizeof(line), "%-20s %-16s %8llu %8llu %10s %10s %10s %10s %6llu",
+                          any ? "" : label.c_str(), handler,
+                          static_cast<unsigned long long>(calls),
+                          static_cast<unsigned long long>(latency.count()),
+                          formatDuration(latency.meanNs()).c_str(),
+                          formatDuration(latency.percentileNs(0.5)).c_str(),
+                          formatDuration(latency.percentileNs(0.99)).c_str(),
+                          formatDuration(latency.maxNs()).c_str(),
+                          static_cast<unsigned long long>(stats->overBudget[slot].load(std::memory_order_relaxed)));
+            std::cout << line << std::endl;
+            any = true;
+        }
+        if (!any) {
+            std::snprintf(line, sizeof(line), "%-20s %-16s %8d %8d", label.c_str(), "-", 0, 0);
+            std::cout << line << std::endl;
+        }
+    }
+    if (eventBudgetNs > 0) {
+        std::cout << "Budget: " << eventBudgetNs / 1000000 << " ms per synchronous event handler (plugin_budget_ms)" << std::endl;
+    } else {
+        std::cout << "Budget: off (plugin_budget_ms)" << std::endl;
+    }
+    return true;
 }
 
 std::vector<PluginInfo> PluginManager::getPluginInfos() const {
@@ -255,6 +1253,22 @@ void PluginManager::listPlugins() const {
         std::cout << "  " << info.name << " v" << info.version 
                   << " by " << info.author << std::endl;
         std::cout << "    " << info.description << std::endl;
+        auto time = loadTimes.find(name);
+        if (time != loadTimes.end()) {
+            char line[96];
+            std::snprintf(line, sizeof(line), "    loaded in %.1f ms (dlopen %.1f ms, initialize %.1f ms)",
+                          time->second.dlopenMs + time->second.initializeMs,
+                          time->second.dlopenMs, time->second.initializeMs);
+            std::cout << line << std::endl;
+        }
+    }
+    if (!deferredPlugins.empty()) {
+        std::cout << "Not Yet Loaded:" << std::endl;
+    }
+    for (const auto& [name, manifest] : deferredPlugins) {
+        std::cout << "  " << manifest.name << " v" << manifest.version 
+                  << " by " << manifest.author << std::endl;
+        std::cout << "    " << manifest.description << std::endl;
     }
 }
 
@@ -281,7 +1295,7 @@ void PluginAPI::addToHistory(const std::string& command) {
 
 const std::vector<std::string>& PluginAPI::getHistory() const {
     static std::vector<std::string> empty;
-    return shell ? shell->getHistory() : empty;
+    return shell ? shell->getHistory().asVector() : empty;
 }
 
 std::string PluginAPI::getConfigValue(const std::string& key, const std::string& defaultValue) const {
@@ -298,7 +1312,7 @@ void PluginAPI::setConfigValue(const std::string& key, const std::string& value)
 }
 
 std::string PluginAPI::getCurrentDirectory() const {
-    return Utils::getCurrentDirectory();
+    return shell ? shell->getCurrentDirectory() : Utils::getCurrentDirectory();
 }
 
 int PluginAPI::getLastExitCode() const {
@@ -0,0 +1,214 @@
+#include "plugin_event_bus.h"
+#include <iostream>
+#include <algorithm>
+#include <utility>
+
+// Plugin Event Queue Implementation
+void PluginEventQueue::Event::assign(const PluginEventData& event) {
+    type = event.type;
+    directory.assign(event.directory);
+    input.assign(event.input);
+    command.assign(event.command);
+    hasArgs = event.args != nullptr;
+    if (hasArgs) {
+        args.assign(event.args->begin(), event.args->end());
+    } else {
+        args.clear();
+    }
+    pluginName.assign(event.pluginName);
+    pluginVersion.assign(event.pluginVersion);
+    exitCode = event.exitCode;
+    success = event.success;
+}
+
+PluginEventData PluginEventQueue::Event::view() const {
+    PluginEventData event(type);
+    event.directory = directory;
+    event.input = input;
+    event.command = command;
+    event.args = hasArgs ? &args : nullptr;
+    event.pluginName = pluginName;
+    event.pluginVersion = pluginVersion;
+    event.exitCode = exitCode;
+    event.success = success;
+    return event;
+}
+
+PluginEventQueue::PluginEventQueue(IPlugin* plugin, const std::string& name, PluginStats* stats, size_t capacity)
+    : plugin(plugin), name(name), stats(stats), slots(capacity), mask(capacity - 1) {}
+
+// Plugin Event Bus Implementation
+PluginEventBus::PluginEventBus(size_t workerCount, size_t capacity) : capacity(1), stopping(false) {
+    // A power of two, so a slot is an index masked off the running count
+    while (this->capacity < std::max<size_t>(capacity, 2)) {
+        this->capacity <<= 1;
+    }
+    for (size_t i = 0; i < std::max<size_t>(workerCount, 1); ++i) {
+        workers.emplace_back(&PluginEventBus::run, this);
+    }
+}
+
+PluginEventBus::~PluginEventBus() {
+    for (auto& queue : queues) {
+        queue->closed = true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+PluginEventQueue* PluginEventBus::attach(IPlugin* plugin, const std::string& name, PluginStats* stats) {
+    queues.push_back(std::make_unique<PluginEventQueue>(plugin, name, stats, capacity));
+    return queues.back().get();
+}
+
+void PluginEventBus::detach(PluginEventQueue* queue) {
+    queue->closed = true;
+    uint64_t dropped;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [queue] { return !queue->scheduled; });
+        dropped = queue->dropped;
+    }
+    if (dropped > 0) {
+        std::cerr << "lynx: plugin " << queue->name << " fell behind and missed "
+                  << dropped << " events" << std::endl;
+    }
+    queues.remove_if([queue](const auto& entry) { return entry.get() == queue; });
+}
+
+void PluginEventBus::post(PluginEventQueue* queue, const PluginEventData& event) {
+    if (queue->closed) {
+        return;
+    }
+
+    size_t tail = queue->tail.load(std::memory_order_relaxed);
+    bool full = tail - queue->head.load(std::memory_order_acquire) >= capacity;
+
+    if (queue->hasOverflow) {
+        // The waiting prompt goes back in line first, so nothing overtakes it
+        std::lock_guard<std::mutex> lock(queue->overflowMutex);
+        if (queue->hasOverflow && !full) {
+            std::swap(queue->slots[tail & queue->mask], queue->overflow);
+            queue->tail = ++tail;
+            queue->hasOverflow = false;
+            full = tail - queue->head.load(std::memory_order_acquire) >= capacity;
+        }
+    }
+
+    if (!full) {
+        queue->slots[tail & queue->mask].assign(event);
+        queue->tail = tail + 1;
+    } else if (event.type == PluginEvent::PROMPT_DISPLAY) {
+        std::lock_guard<std::mutex> lock(queue->overflowMutex);
+        queue->overflow.assign(event);
+        queue->hasOverflow = true;
+    } else {
+        queue->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    schedule(queue);
+}
+
+bool PluginEventBus::drain(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return idle.wait_for(lock, timeout, [this] {
+        return std::none_of(queues.begin(), queues.end(), [](const auto& queue) {
+            return queue->scheduled.load();
+        });
+    });
+}
+
+void PluginEventBus::schedule(PluginEventQueue* queue) {
+    if (queue->scheduled.exchange(true)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.push_back(queue);
+    }
+    wake.notify_one();
+}
+
+void PluginEventBus::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this] { return stopping || !ready.empty(); });
+        if (ready.empty()) {
+            return;
+        }
+        PluginEventQueue* queue = ready.front();
+        ready.pop_front();
+
+        lock.unlock();
+        deliverAll(queue);
+        lock.lock();
+
+        // The shell skips scheduling while the flag is set, so look again
+        // once it is clear in case an event arrived in between
+        queue->scheduled = false;
+        bool pending = queue->head != queue->tail || queue->hasOverflow;
+        if (pending && !queue->closed && !queue->scheduled.exchange(true)) {
+            ready.push_back(queue);
+            wake.notify_one();
+        }
+        idle.notify_all();
+    }
+}
+
+void PluginEventBus::deliverAll(PluginEventQueue* queue) {
+    for (;;) {
+        if (queue->closed) {
+            std::lock_guard<std::mutex> lock(queue->overflowMutex);
+            size_t tail = queue->tail;
+            queue->dropped += tail - queue->head + (queue->hasOverflow ? 1 : 0);
+            queue->head.store(tail);
+            queue->hasOverflow = false;
+            return;
+        }
+
+        size_t head = queue->head.load(std::memory_order_relaxed);
+        if (head != queue->tail.load(std::memory_order_acquire)) {
+            deliver(queue, queue->slots[head & queue->mask]);
+            queue->head.store(head + 1, std::memory_order_release);
+            continue;
+        }
+
+        // The ring is empty, so a coalesced prompt is the newest event left
+        if (!queue->hasOverflow) {
+            return;
+        }
+        PluginEventQueue::Event event;
+        {
+            std::lock_guard<std::mutex> lock(queue->overflowMutex);
+            if (!queue->hasOverflow || queue->head != queue->tail) {
+                continue;
+            }
+            std::swap(event, queue->overflow);
+            queue->hasOverflow = false;
+        }
+        deliver(queue, event);
+    }
+}
+
+void PluginEventBus::deliver(PluginEventQueue* queue, const PluginEventQueue::Event& event) {
+    PluginEventData data = event.view();
+    auto start = std::chrono::steady_clock::now();
+    try {
+        if (!queue->plugin->handleEvent(data)) {
+            queue->plugin->onEvent(data.type, PluginManager::legacyContext(data));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Plugin " << queue->name << " threw exception during event handling: "
+                  << e.what() << std::endl;
+    }
+    if (queue->stats) {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        queue->stats->latency[static_cast<size_t>(data.type)].record(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+}
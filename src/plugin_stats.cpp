@@ -0,0 +1,65 @@
+#include "plugin_stats.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // One writer per histogram, so no read-modify-write instructions
+    template <typename T>
+    void bump(std::atomic<T>& counter, T amount) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+}
+
+// Latency Histogram Implementation
+void LatencyHistogram::record(int64_t ns) {
+    ns = std::max<int64_t>(ns, 0);
+    bump(buckets[bucketFor(ns)], 1u);
+    bump(total, uint64_t(1));
+    bump(sumNs, ns);
+    if (ns > largest.load(std::memory_order_relaxed)) {
+        largest.store(ns, std::memory_order_relaxed);
+    }
+}
+
+int64_t LatencyHistogram::meanNs() const {
+    uint64_t calls = count();
+    return calls ? sumNs.load(std::memory_order_relaxed) / static_cast<int64_t>(calls) : 0;
+}
+
+int64_t LatencyHistogram::percentileNs(double fraction) const {
+    uint64_t calls = count();
+    if (calls == 0) {
+        return 0;
+    }
+    uint64_t wanted = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * calls)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= wanted) {
+            return std::min(highestIn(i), maxNs());
+        }
+    }
+    return maxNs();
+}
+
+// Values below 16 ns get a bucket each; above that, the top five bits pick
+// one of 16 steps within the value's power of two
+size_t LatencyHistogram::bucketFor(int64_t ns) {
+    uint64_t value = std::min<uint64_t>(static_cast<uint64_t>(ns), (uint64_t(1) << (MAX_EXPONENT + 1)) - 1);
+    if (value < (1u << SUB_BUCKET_BITS)) {
+        return static_cast<size_t>(value);
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    size_t step = (value >> (exponent - SUB_BUCKET_BITS)) & ((1u << SUB_BUCKET_BITS) - 1);
+    return (static_cast<size_t>(exponent - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS) + step;
+}
+
+int64_t LatencyHistogram::highestIn(size_t bucket) {
+    if (bucket < (1u << SUB_BUCKET_BITS)) {
+        return static_cast<int64_t>(bucket);
+    }
+    int exponent = static_cast<int>(bucket >> SUB_BUCKET_BITS) + SUB_BUCKET_BITS - 1;
+    int64_t step = static_cast<int64_t>(bucket & ((1u << SUB_BUCKET_BITS) - 1));
+    int shift = exponent - SUB_BUCKET_BITS;
+    return (((int64_t(1) << SUB_BUCKET_BITS) + step + 1) << shift) - 1;
+}
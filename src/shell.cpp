@@ -4,33 +4,116 @@
 #include "config.h"
 #include "plugin.h"
 #include "theme_manager.h"
+#include "line_editor.h"
+#include "completion.h"
+#include "highlighter.h"
+#include "git_status.h"
+#include "frecency.h"
+#include "config_watcher.h"
+#include "startup_profiler.h"
 #include <iostream>
 #include <unistd.h>
 
-Shell::Shell() : running(true), lastExitCode(0) {
-    currentDirectory = Utils::getCurrentDirectory();
+Shell::Shell() : running(true), lastExitCode(0), workTreeWrites(0) {
+    // Each phase is timed for lynx --profile-startup
     
     // Initialize configuration system
-    configManager = std::make_unique<ConfigManager>();
+    {
+        ProfileScope scope("config");
+        configManager = std::make_unique<ConfigManager>();
+    }
     
-    // Initialize theme system
-    themeManager = std::make_unique<ExternalThemeManager>();
-    themeManager->discoverThemes();
+    // Restore persisted history
+    {
+        ProfileScope scope("history");
+        history.setMaxEntries(static_cast<size_t>(configManager->getInt(ConfigSetting::HistorySize)));
+        history.load(getHistoryFilePath());
+    }
     
-    // Load theme from config
-    std::string themeName = configManager->getSetting("theme", "default");
-    themeManager->setTheme(themeName);
+    // Directories visited with cd, for z/j; the file is opened on first use
+    if (configManager->getBool(ConfigSetting::TrackDirectories)) {
+        directoryDatabase = std::make_unique<FrecencyDatabase>(configManager->getConfigDir() + "/directories.db");
+    }
+    
+    // Raw-mode editing when attached to a terminal
+    {
+        ProfileScope scope("line editor");
+        lineEditor = std::make_unique<LineEditor>();
+        lineEditor->setHistory(&history);
+        
+        // Inline suggestions from history, greyed out after the cursor
+        if (lineEditor->isInteractive() && configManager->getBool(ConfigSetting::Autosuggestions)) {
+            historySuggester = std::make_unique<HistorySuggester>(history);
+            historySuggester->setBudget(std::chrono::milliseconds(configManager->getInt(ConfigSetting::AutosuggestBudgetMs)));
+            lineEditor->setSuggester(historySuggester.get());
+        }
+    }
+    
+    // PATH is indexed in the background so the first prompt never waits
+    {
+        ProfileScope scope("completion");
+        bool tabCompletion = configManager->getBool(ConfigSetting::TabCompletion);
+        bool highlighting = configManager->getBool(ConfigSetting::SyntaxHighlighting);
+        if (lineEditor->isInteractive() && (tabCompletion || highlighting)) {
+            completionEngine = std::make_unique<CompletionEngine>(this);
+        }
+        if (completionEngine && tabCompletion) {
+            lineEditor->setCompletionCallback([this](const std::string& line, size_t cursor) {
+                return completionEngine->complete(line, cursor);
+            });
+        }
+        if (completionEngine && highlighting) {
+            syntaxHighlighter = std::make_unique<SyntaxHighlighter>(completionEngine.get());
+            lineEditor->setHighlighter(syntaxHighlighter.get());
+        }
+    }
+    
+    // Initialize theme system
+    {
+        ProfileScope scope("themes");
+        themeManager = std::make_unique<ExternalThemeManager>();
+        themeManager->setColorDepth(AnsiColors::detectColorDepth(configManager->getBool(ConfigSetting::ColorOutput)));
+        themeManager->setCacheFile(configManager->getConfigDir() + "/cache/themes.bin");
+        {
+            ProfileScope discovery("discover");
+            themeManager->discoverThemes();
+        }
+        
+        // Load theme from config
+        const std::string& themeName = configManager->getString(ConfigSetting::Theme);
+        {
+            ProfileScope selection("set theme", themeName);
+            themeManager->setTheme(themeName);
+        }
+        
+        applyThemePalette();
+    }
     
     // Initialize plugin system
-    pluginManager = std::make_unique<PluginManager>(this);
-    pluginManager->loadAllPlugins();
+    {
+        ProfileScope scope("plugins");
+        pluginManager = std::make_unique<PluginManager>(this);
+        pluginManager->setEventBudget(configManager->getInt(ConfigSetting::PluginBudgetMs));
+        pluginManager->loadAllPlugins();
+    }
+    
+    // Edits to the config, aliases and themes apply at the next prompt
+    if (lineEditor->isInteractive() && configManager->getBool(ConfigSetting::AutoReload)) {
+        ProfileScope scope("config watcher");
+        configWatcher = std::make_unique<ConfigWatcher>(configManager.get(), configManager->getAliasManager(),
+                                                        themeManager.get());
+        if (!configWatcher->start()) {
+            configWatcher.reset();
+        }
+    }
     
     // Display welcome message if configured
-    std::string welcomeMsg = configManager->getSetting("welcome_message", "Welcome to Lynx Shell!");
-    if (configManager->getSetting("show_welcome", "true") == "true") {
+    const std::string& welcomeMsg = configManager->getString(ConfigSetting::WelcomeMessage);
+    if (configManager->getBool(ConfigSetting::ShowWelcome)) {
+        ProfileScope scope("welcome");
         const ThemeConfig* theme = themeManager->getCurrentTheme();
         if (theme) {
-            std::cout << themeManager->applyColor(welcomeMsg, theme->colors.outputInfo) << std::endl;
+            std::cout << themeManager->applyColor(welcomeMsg, theme->colors[ThemeColor::OutputInfo]) << std::endl;
         } else {
             std::cout << welcomeMsg << std::endl;
         }
@@ -42,16 +125,34 @@ Shell::~Shell() {
     if (pluginManager) {
         pluginManager->unloadAllPlugins();
     }
+    
+    if (configManager) {
+        history.save(getHistoryFilePath());
+    }
 }
 
 void Shell::run() {
     // Broadcast shell startup event to plugins
     if (pluginManager) {
+        ProfileScope scope("startup event");
         pluginManager->broadcastEvent(PluginEvent::SHELL_STARTUP);
     }
     
     while (running) {
-        displayPrompt();
+        configManager->persistChanges();
+        applyConfigChanges();
+        if (pluginManager) {
+            if (configManager->getBool(ConfigSetting::PluginAutoReload)) {
+                pluginManager->reloadChangedPlugins();
+            }
+            // Plugins unloaded by the last command, possibly their own
+            pluginManager->closeRetiredPlugins();
+        }
+        {
+            ProfileScope scope("prompt");
+            displayPrompt();
+        }
+        StartupProfiler::instance().finish();
         std::string input = readInput();
         
         if (!input.empty()) {
@@ -66,30 +167,135 @@ void Shell::run() {
     }
 }
 
+void Shell::applyThemePalette() {
+    // Line editor palette, indexed by EditorStyle
+    const ThemeConfig* currentTheme = themeManager->getCurrentTheme();
+    std::vector<std::string> palette;
+    if (currentTheme && configManager->getBool(ConfigSetting::ColorOutput)) {
+        const ThemeColors& colors = currentTheme->colors;
+        palette.resize(static_cast<size_t>(EditorStyle::Count));
+        palette[static_cast<size_t>(EditorStyle::Suggestion)] = colors[ThemeColor::Dim];
+        palette[static_cast<size_t>(EditorStyle::Builtin)] = colors[ThemeColor::SyntaxKeyword];
+        palette[static_cast<size_t>(EditorStyle::PluginCommand)] = colors[ThemeColor::OutputInfo];
+        palette[static_cast<size_t>(EditorStyle::Command)] = colors[ThemeColor::OutputSuccess];
+        palette[static_cast<size_t>(EditorStyle::UnknownCommand)] = colors[ThemeColor::OutputError];
+        palette[static_cast<size_t>(EditorStyle::String)] = colors[ThemeColor::SyntaxString];
+        palette[static_cast<size_t>(EditorStyle::Number)] = colors[ThemeColor::SyntaxNumber];
+        palette[static_cast<size_t>(EditorStyle::Comment)] = colors[ThemeColor::SyntaxComment];
+        palette[static_cast<size_t>(EditorStyle::Operator)] = colors[ThemeColor::SyntaxOperator];
+    }
+    lineEditor->setStylePalette(palette);
+}
+
+void Shell::applyConfigChanges() {
+    if (!configWatcher) {
+        return;
+    }
+    std::unique_ptr<ConfigWatcher::Snapshot> changes = configWatcher->takeChanges();
+    if (!changes) {
+        return;
+    }
+    
+    // Everything was parsed by the watcher; this only swaps it in
+    AliasManager* aliases = configManager->getAliasManager();
+    if (changes->aliasesChanged) {
+        aliases->replaceAliases(std::move(changes->aliases));
+    }
+    if (changes->functionsChanged) {
+        aliases->replaceFunctions(std::move(changes->functions));
+    }
+    // Our own writes come back through the watcher, even ones that later
+    // writes have overtaken, so they are not read back in
+    bool settingsChanged = changes->settingsChanged && !configManager->isOwnWrite(changes->settings);
+    if (settingsChanged) {
+        configManager->replaceSettings(std::move(changes->settings));
+    }
+    
+    if (changes->themesChanged || settingsChanged) {
+        applySettings(changes->themesChanged);
+    }
+}
+
+void Shell::applySettings(bool themesChanged) {
+    // Changed theme files are already compiled into the theme cache
+    const std::string& themeName = configManager->getString(ConfigSetting::Theme);
+    if (themesChanged) {
+        themeManager->discoverThemes();
+    }
+    if (themesChanged || themeName != themeManager->getCurrentThemeName()) {
+        themeManager->setTheme(themeName);
+    }
+    themeManager->setColorDepth(AnsiColors::detectColorDepth(configManager->getBool(ConfigSetting::ColorOutput)));
+    applyThemePalette();
+    history.setMaxEntries(static_cast<size_t>(configManager->getInt(ConfigSetting::HistorySize)));
+    if (pluginManager) {
+        pluginManager->setEventBudget(configManager->getInt(ConfigSetting::PluginBudgetMs));
+    }
+}
+
 void Shell::displayPrompt() {
     // Broadcast prompt display event to plugins
-    if (pluginManager) {
-        std::map<std::string, std::string> context;
-        context["directory"] = Utils::getCurrentDirectory();
-        context["exit_code"] = std::to_string(lastExitCode);
-        pluginManager->broadcastEvent(PluginEvent::PROMPT_DISPLAY, context);
+    if (pluginManager && pluginManager->hasSubscribers(PluginEvent::PROMPT_DISPLAY)) {
+        PluginEventData event(PluginEvent::PROMPT_DISPLAY);
+        event.directory = workingDirectory.get();
+        event.exitCode = lastExitCode;
+        pluginManager->broadcastEvent(event);
+    }
+    
+    const std::string& cwd = workingDirectory.get();
+    promptDirectory = cwd;
+    
+    // Pick up executables installed by the previous command
+    if (completionEngine) {
+        completionEngine->refresh();
+    }
+    if (historySuggester) {
+        historySuggester->setDirectory(cwd);
+    }
+    if (syntaxHighlighter) {
+        syntaxHighlighter->invalidate();
     }
     
-    std::string cwd = Utils::getCurrentDirectory();
+    // The git segment shows what is known now; the dirty check finishes in
+    // the background and redraws the prompt while the line is being edited
+    if (themeManager && themeManager->promptUsesGit() && lineEditor->isInteractive() && !gitStatus) {
+        gitStatus = std::make_unique<GitStatusProvider>();
+        lineEditor->setPromptSource(gitStatus->getNotifyFd(), [this](std::string& prompt) {
+            if (!themeManager->promptUsesGit()) {
+                return false;
+            }
+            GitInfo git = gitStatus->current();
+            themeManager->formatPrompt(promptDirectory, lastExitCode, prompt, git.branch, git.dirtyKnown && git.dirty);
+            promptText = prompt;
+            return true;
+        });
+    }
     
     // Use themed prompt
-    std::string prompt;
     if (themeManager) {
-        prompt = themeManager->formatPrompt(cwd, lastExitCode);
+        GitInfo git;
+        if (gitStatus && themeManager->promptUsesGit()) {
+            git = gitStatus->query(cwd, workTreeWrites);
+        }
+        themeManager->formatPrompt(cwd, lastExitCode, promptText, git.branch, git.dirtyKnown && git.dirty);
     } else {
-        prompt = cwd + " $ ";
+        promptText = cwd + " $ ";
     }
     
-    std::cout << prompt;
+    std::cout << promptText << std::flush;
 }
 
 std::string Shell::readInput() {
     std::string input;
+    
+    if (lineEditor && lineEditor->isInteractive()) {
+        if (!lineEditor->readLine(promptText, input)) {
+            running = false;
+            return "";
+        }
+        return Utils::trim(input);
+    }
+    
     std::getline(std::cin, input);
     
     // Handle Ctrl+D (EOF)
@@ -105,27 +311,23 @@ void Shell::executeCommand(const std::string& input) {
     if (input.empty()) return;
     
     // Broadcast input received event to plugins
-    if (pluginManager) {
-        std::map<std::string, std::string> context;
-        context["input"] = input;
-        pluginManager->broadcastEvent(PluginEvent::INPUT_RECEIVED, context);
+    if (pluginManager && pluginManager->hasSubscribers(PluginEvent::INPUT_RECEIVED)) {
+        PluginEventData event(PluginEvent::INPUT_RECEIVED);
+        event.input = input;
+        pluginManager->broadcastEvent(event);
     }
     
-    // Expand aliases first (if alias manager exists)
-    std::string expandedInput = input;
-    // TODO: Add alias expansion when alias manager is implemented
+    // Expand aliases first
+    std::string expandedInput = configManager->getAliasManager()->expandAlias(input);
     
     Command cmd = CommandParser::parseCommand(expandedInput);
     
     // Broadcast command before event to plugins
-    if (pluginManager) {
-        std::map<std::string, std::string> context;
-        context["command"] = cmd.name;
-        context["args"] = "";
-        for (const auto& arg : cmd.args) {
-            context["args"] += arg + " ";
-        }
-        pluginManager->broadcastEvent(PluginEvent::COMMAND_BEFORE, context);
+    if (pluginManager && pluginManager->hasSubscribers(PluginEvent::COMMAND_BEFORE)) {
+        PluginEventData event(PluginEvent::COMMAND_BEFORE);
+        event.command = cmd.name;
+        event.args = &cmd.args;
+        pluginManager->broadcastEvent(event);
     }
     
     lastExitCode = 0;  // Reset exit code
@@ -133,6 +335,7 @@ void Shell::executeCommand(const std::string& input) {
     
     // First check if it's a plugin command
     if (pluginManager && pluginManager->isPluginCommand(cmd.name)) {
+        ++workTreeWrites;
         commandExecuted = pluginManager->executePluginCommand(cmd);
         if (!commandExecuted) {
             lastExitCode = 1;
@@ -147,22 +350,23 @@ void Shell::executeCommand(const std::string& input) {
     }
     // Finally try external commands
     else {
+        ++workTreeWrites;
         lastExitCode = CommandExecutor::executeExternalCommand(cmd);
         commandExecuted = (lastExitCode == 0);
     }
     
     // Broadcast command after event to plugins
-    if (pluginManager) {
-        std::map<std::string, std::string> context;
-        context["command"] = cmd.name;
-        context["exit_code"] = std::to_string(lastExitCode);
-        context["success"] = commandExecuted ? "true" : "false";
-        pluginManager->broadcastEvent(PluginEvent::COMMAND_AFTER, context);
+    if (pluginManager && pluginManager->hasSubscribers(PluginEvent::COMMAND_AFTER)) {
+        PluginEventData event(PluginEvent::COMMAND_AFTER);
+        event.command = cmd.name;
+        event.exitCode = lastExitCode;
+        event.success = commandExecuted;
+        pluginManager->broadcastEvent(event);
     }
 }
 
 void Shell::addToHistory(const std::string& command) {
-    history.push_back(command);
+    history.add(command, workingDirectory.get());
 }
 
 void Shell::printHistory() {
@@ -171,6 +375,10 @@ void Shell::printHistory() {
     }
 }
 
+std::string Shell::getHistoryFilePath() const {
+    return configManager->getConfigDir() + "/history.db";
+}
+
 bool Shell::isRunning() const {
     return running;
 }
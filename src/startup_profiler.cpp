@@ -0,0 +1,127 @@
+#include "startup_profiler.h"
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <ctime>
+
+namespace {
+    double toMs(int64_t ns) {
+        return static_cast<double>(ns) / 1e6;
+    }
+
+    void writeJSONString(std::ostream& out, std::string_view text) {
+        out << '"';
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                out << '\\' << c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escape[8];
+                std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+                out << escape;
+            } else {
+                out << c;
+            }
+        }
+        out << '"';
+    }
+}
+
+// Startup Profiler Implementation
+StartupProfiler& StartupProfiler::instance() {
+    static StartupProfiler profiler;
+    return profiler;
+}
+
+void StartupProfiler::start(const std::string& path) {
+    jsonPath = path;
+    phases.clear();
+    phases.reserve(64);
+    depth = 0;
+    originNs = now();
+    active = true;
+}
+
+size_t StartupProfiler::begin(std::string_view name, std::string_view detail) {
+    phases.push_back({std::string(name), std::string(detail), depth++, now() - originNs, -1});
+    return phases.size() - 1;
+}
+
+void StartupProfiler::end(size_t phase) {
+    phases[phase].endNs = now() - originNs;
+    --depth;
+}
+
+void StartupProfiler::addPhase(std::string_view name, std::string_view detail, int nesting,
+                               int64_t startNs, int64_t endNs) {
+    phases.push_back({std::string(name), std::string(detail), depth + nesting, startNs - originNs, endNs - originNs});
+}
+
+void StartupProfiler::finish() {
+    if (!active) {
+        return;
+    }
+    active = false;
+    int64_t totalNs = now() - originNs;
+
+    if (jsonPath.empty()) {
+        printTable(std::cerr, totalNs);
+        return;
+    }
+    std::ofstream file(jsonPath);
+    if (!file.is_open()) {
+        std::cerr << "lynx: cannot write startup profile to " << jsonPath << std::endl;
+        return;
+    }
+    writeJSON(file, totalNs);
+}
+
+int64_t StartupProfiler::now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+void StartupProfiler::printTable(std::ostream& out, int64_t totalNs) const {
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-44s %10s %10s", "phase", "start ms", "ms");
+    out << line << std::endl;
+    for (const auto& phase : phases) {
+        std::string label(static_cast<size_t>(phase.depth) * 2, ' ');
+        label += phase.name;
+        if (!phase.detail.empty()) {
+            label += ' ';
+            label += phase.detail;
+        }
+        if (label.size() > 44) {
+            label = label.substr(0, 41) + "...";
+        }
+        int64_t endNs = phase.endNs < 0 ? totalNs : phase.endNs;
+        std::snprintf(line, sizeof(line), "%-44s %10.3f %10.3f", label.c_str(),
+                      toMs(phase.startNs), toMs(endNs - phase.startNs));
+        out << line << std::endl;
+    }
+    std::snprintf(line, sizeof(line), "%-44s %10s %10.3f", "total to first prompt", "", toMs(totalNs));
+    out << line << std::endl;
+}
+
+void StartupProfiler::writeJSON(std::ostream& out, int64_t totalNs) const {
+    char number[32];
+    std::snprintf(number, sizeof(number), "%.3f", toMs(totalNs));
+    out << "{\n  \"total_ms\": " << number << ",\n  \"phases\": [";
+    for (size_t i = 0; i < phases.size(); ++i) {
+        const Phase& phase = phases[i];
+        int64_t endNs = phase.endNs < 0 ? totalNs : phase.endNs;
+        out << (i ? ",\n" : "\n") << "    {\"name\": ";
+        writeJSONString(out, phase.name);
+        if (!phase.detail.empty()) {
+            out << ", \"detail\": ";
+            writeJSONString(out, phase.detail);
+        }
+        out << ", \"depth\": " << phase.depth;
+        std::snprintf(number, sizeof(number), "%.3f", toMs(phase.startNs));
+        out << ", \"start_ms\": " << number;
+        std::snprintf(number, sizeof(number), "%.3f", toMs(endNs - phase.startNs));
+        out << ", \"duration_ms\": " << number << "}";
+    }
+    out << "\n  ]\n}\n";
+}
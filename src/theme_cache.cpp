@@ -0,0 +1,251 @@
+#include "theme_cache.h"
+#include "theme_manager.h"
+#include "utils.h"
+#include <filesystem>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Layout of the cache file; any change here needs a new CACHE_VERSION
+struct ThemeCache::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t entryCount;
+    uint64_t fileSize;
+};
+
+struct ThemeCache::StringRef {
+    uint32_t offset;  // from the start of the file
+    uint32_t length;
+};
+
+namespace {
+    const char CACHE_MAGIC[8] = {'L', 'Y', 'N', 'X', 'T', 'H', 'M', '\0'};
+    const uint32_t CACHE_VERSION = 2;
+
+    const uint32_t FLAG_VALID = 1;
+    const uint32_t FLAG_GIT_BRANCH = 2;
+    const uint32_t FLAG_EXIT_CODE = 4;
+    const uint32_t FLAG_TIMESTAMP = 8;
+
+    std::string ThemeConfig::* const THEME_STRINGS[] = {
+        &ThemeConfig::name,
+        &ThemeConfig::version,
+        &ThemeConfig::author,
+        &ThemeConfig::description,
+        &ThemeConfig::promptFormat
+    };
+
+    constexpr size_t THEME_FIELDS = sizeof(THEME_STRINGS) / sizeof(THEME_STRINGS[0]);
+    constexpr size_t COLOR_FIELDS = ThemeColors::COUNT;
+}
+
+struct ThemeCache::Entry {
+    StringRef source;
+    int64_t mtimeNs;
+    uint64_t size;
+    uint32_t flags;
+    uint32_t customCount;
+    uint32_t customOffset;  // customCount key/value StringRef pairs
+    uint32_t reserved;
+    StringRef fields[THEME_FIELDS + COLOR_FIELDS];
+};
+
+// Theme Cache Implementation
+bool ThemeCache::open(const std::string& path) {
+    static_assert(sizeof(Header) % 8 == 0 && sizeof(Entry) % 8 == 0, "cache records must stay 8-byte aligned");
+
+    entries.clear();
+    if (!file.open(path) || file.size() < sizeof(Header)) {
+        file.close();
+        return false;
+    }
+
+    const Header* header = reinterpret_cast<const Header*>(file.data());
+    if (std::memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        header->version != CACHE_VERSION || header->fileSize != file.size() ||
+        header->entryCount > (file.size() - sizeof(Header)) / sizeof(Entry)) {
+        file.close();
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header->entryCount; ++i) {
+        uint32_t offset = static_cast<uint32_t>(sizeof(Header) + i * sizeof(Entry));
+        const Entry* entry = reinterpret_cast<const Entry*>(file.data() + offset);
+        std::string_view source;
+        if (!view(entry->source, source)) {
+            entries.clear();
+            file.close();
+            return false;
+        }
+        entries[source] = offset;
+    }
+    return true;
+}
+
+ThemeCache::Lookup ThemeCache::lookup(const Source& source, ThemeConfig& theme) const {
+    auto it = entries.find(source.path);
+    if (it == entries.end()) {
+        return Lookup::Miss;
+    }
+    const Entry* entry = reinterpret_cast<const Entry*>(file.data() + it->second);
+    if (entry->mtimeNs != source.mtimeNs || entry->size != source.size) {
+        return Lookup::Miss;
+    }
+    if (!(entry->flags & FLAG_VALID)) {
+        return Lookup::Invalid;
+    }
+
+    std::string_view text;
+    for (size_t i = 0; i < THEME_FIELDS; ++i) {
+        if (!view(entry->fields[i], text)) return Lookup::Miss;
+        theme.*THEME_STRINGS[i] = text;
+    }
+    for (size_t i = 0; i < COLOR_FIELDS; ++i) {
+        if (!view(entry->fields[THEME_FIELDS + i], text)) return Lookup::Miss;
+        theme.colors.sequences[i] = text;
+    }
+
+    uint64_t customBytes = static_cast<uint64_t>(entry->customCount) * 2 * sizeof(StringRef);
+    if (entry->customOffset % alignof(StringRef) != 0 || entry->customOffset + customBytes > file.size()) {
+        return Lookup::Miss;
+    }
+    const StringRef* custom = reinterpret_cast<const StringRef*>(file.data() + entry->customOffset);
+    theme.customSettings.clear();
+    for (uint32_t i = 0; i < entry->customCount; ++i) {
+        std::string_view key, value;
+        if (!view(custom[2 * i], key) || !view(custom[2 * i + 1], value)) return Lookup::Miss;
+        theme.customSettings.emplace(key, value);
+    }
+
+    theme.showGitBranch = entry->flags & FLAG_GIT_BRANCH;
+    theme.showExitCode = entry->flags & FLAG_EXIT_CODE;
+    theme.showTimestamp = entry->flags & FLAG_TIMESTAMP;
+    return Lookup::Hit;
+}
+
+bool ThemeCache::isCurrent(const std::vector<Source>& sources) const {
+    if (sources.size() != entries.size()) {
+        return false;
+    }
+    for (const auto& source : sources) {
+        auto it = entries.find(source.path);
+        if (it == entries.end()) {
+            return false;
+        }
+        const Entry* entry = reinterpret_cast<const Entry*>(file.data() + it->second);
+        if (entry->mtimeNs != source.mtimeNs || entry->size != source.size) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ThemeCache::write(const std::string& path, const std::vector<Record>& records) {
+    // Fixed-size parts first, strings last, so every offset is known as the
+    // pool grows
+    size_t customTotal = 0;
+    for (const auto& record : records) {
+        if (record.theme) {
+            customTotal += record.theme->customSettings.size();
+        }
+    }
+    size_t entriesOffset = sizeof(Header);
+    size_t customOffset = entriesOffset + records.size() * sizeof(Entry);
+    size_t poolOffset = customOffset + customTotal * 2 * sizeof(StringRef);
+
+    std::vector<Entry> entryTable(records.size());
+    std::vector<StringRef> customTable;
+    customTable.reserve(customTotal * 2);
+    std::string pool;
+    bool overflow = false;
+    auto intern = [&](std::string_view text) {
+        StringRef reference{static_cast<uint32_t>(poolOffset + pool.size()), static_cast<uint32_t>(text.size())};
+        overflow |= poolOffset + pool.size() + text.size() > UINT32_MAX;
+        pool.append(text);
+        return reference;
+    };
+
+    for (size_t i = 0; i < records.size(); ++i) {
+        const Record& record = records[i];
+        Entry& entry = entryTable[i];
+        std::memset(&entry, 0, sizeof(entry));
+        entry.source = intern(record.source.path);
+        entry.mtimeNs = record.source.mtimeNs;
+        entry.size = record.source.size;
+        entry.customOffset = static_cast<uint32_t>(customOffset + customTable.size() * sizeof(StringRef));
+        if (!record.theme) {
+            continue;
+        }
+
+        const ThemeConfig& theme = *record.theme;
+        entry.flags = FLAG_VALID;
+        if (theme.showGitBranch) entry.flags |= FLAG_GIT_BRANCH;
+        if (theme.showExitCode) entry.flags |= FLAG_EXIT_CODE;
+        if (theme.showTimestamp) entry.flags |= FLAG_TIMESTAMP;
+        for (size_t field = 0; field < THEME_FIELDS; ++field) {
+            entry.fields[field] = intern(theme.*THEME_STRINGS[field]);
+        }
+        for (size_t field = 0; field < COLOR_FIELDS; ++field) {
+            entry.fields[THEME_FIELDS + field] = intern(theme.colors.sequences[field]);
+        }
+        entry.customCount = static_cast<uint32_t>(theme.customSettings.size());
+        for (const auto& [key, value] : theme.customSettings) {
+            customTable.push_back(intern(key));
+            customTable.push_back(intern(value));
+        }
+    }
+    if (overflow) {
+        return false;
+    }
+
+    Header header;
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.entryCount = static_cast<uint32_t>(records.size());
+    header.fileSize = poolOffset + pool.size();
+
+    std::string contents;
+    contents.reserve(header.fileSize);
+    contents.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    contents.append(reinterpret_cast<const char*>(entryTable.data()), entryTable.size() * sizeof(Entry));
+    contents.append(reinterpret_cast<const char*>(customTable.data()), customTable.size() * sizeof(StringRef));
+    contents.append(pool);
+
+    // Readers keep whichever complete file they mapped
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+    std::string temporary = path + ".XXXXXX";
+    int fd = mkstemp(temporary.data());
+    if (fd < 0) {
+        return false;
+    }
+    fchmod(fd, 0644);
+    bool written = ::write(fd, contents.data(), contents.size()) == static_cast<ssize_t>(contents.size());
+    written = ::close(fd) == 0 && written;
+    if (!written || rename(temporary.c_str(), path.c_str()) != 0) {
+        unlink(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ThemeCache::statSource(const std::string& path, Source& source) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    source.path = path;
+    source.mtimeNs = Utils::getModificationTimeNs(st);
+    source.size = static_cast<uint64_t>(st.st_size);
+    return true;
+}
+
+bool ThemeCache::view(const StringRef& reference, std::string_view& out) const {
+    if (static_cast<uint64_t>(reference.offset) + reference.length > file.size()) {
+        return false;
+    }
+    out = std::string_view(file.data() + reference.offset, reference.length);
+    return true;
+}
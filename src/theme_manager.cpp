@@ -1,11 +1,16 @@
 #include "theme_manager.h"
 #include "utils.h"
+#include "json_reader.h"
+#include "mapped_file.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <filesystem>
-#include <regex>
 #include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdlib>
+#include <ctime>
 
 // ANSI Color Utilities Implementation
 namespace AnsiColors {
@@ -22,30 +27,529 @@ namespace AnsiColors {
             return "";
         }
         
-        try {
-            int r = std::stoi(hexColor.substr(1, 2), nullptr, 16);
-            int g = std::stoi(hexColor.substr(3, 2), nullptr, 16);
-            int b = std::stoi(hexColor.substr(5, 2), nullptr, 16);
-            return rgb(r, g, b);
-        } catch (const std::exception&) {
+        unsigned int value = 0;
+        const char* digits = hexColor.data() + 1;
+        auto [end, error] = std::from_chars(digits, digits + 6, value, 16);
+        if (error != std::errc() || end != digits + 6) {
             return "";
         }
+        return rgb((value >> 16) & 0xFF, (value >> 8) & 0xFF, value & 0xFF);
     }
     
     bool isTerminalColorSupported() {
+        static const bool supported = detectColorDepth() != ColorDepth::None;
+        return supported;
+    }
+    
+    ColorDepth detectColorDepth(bool colorOutput) {
+        const char* noColor = getenv("NO_COLOR");
         const char* term = getenv("TERM");
-        if (!term) return false;
+        if (!colorOutput || (noColor && *noColor) || !term || std::string_view(term) == "dumb") {
+            return ColorDepth::None;
+        }
+        
+        std::string_view termName(term);
+        const char* colorTerm = getenv("COLORTERM");
+        if (colorTerm && (std::string_view(colorTerm) == "truecolor" || std::string_view(colorTerm) == "24bit")) {
+            return ColorDepth::TrueColor;
+        }
+        if (termName.size() >= 7 && termName.substr(termName.size() - 7) == "-direct") {
+            return ColorDepth::TrueColor;
+        }
+        if (termName.find("256color") != std::string_view::npos) {
+            return ColorDepth::Extended;
+        }
+        for (const char* family : {"color", "xterm", "screen", "tmux", "rxvt", "linux", "ansi", "vt100"}) {
+            if (termName.find(family) != std::string_view::npos) {
+                return ColorDepth::Basic;
+            }
+        }
+        return ColorDepth::None;
+    }
+    
+    namespace {
+        struct Rgb {
+            int r, g, b;
+        };
+        
+        // xterm's default 16-color palette
+        const Rgb BASIC_PALETTE[16] = {
+            {0, 0, 0}, {205, 0, 0}, {0, 205, 0}, {205, 205, 0},
+            {0, 0, 238}, {205, 0, 205}, {0, 205, 205}, {229, 229, 229},
+            {127, 127, 127}, {255, 0, 0}, {0, 255, 0}, {255, 255, 0},
+            {92, 92, 255}, {255, 0, 255}, {0, 255, 255}, {255, 255, 255},
+        };
+        const int CUBE_LEVELS[6] = {0, 95, 135, 175, 215, 255};
+        
+        int distance(const Rgb& a, const Rgb& b) {
+            int dr = a.r - b.r, dg = a.g - b.g, db = a.b - b.b;
+            return dr * dr + dg * dg + db * db;
+        }
+        
+        Rgb paletteColor(int index) {
+            if (index < 16) {
+                return BASIC_PALETTE[index];
+            }
+            if (index < 232) {
+                index -= 16;
+                return {CUBE_LEVELS[index / 36], CUBE_LEVELS[(index / 6) % 6], CUBE_LEVELS[index % 6]};
+            }
+            int level = 8 + (index - 232) * 10;
+            return {level, level, level};
+        }
+        
+        uint8_t nearestBasic(const Rgb& color) {
+            uint8_t best = 0;
+            for (uint8_t i = 1; i < 16; ++i) {
+                if (distance(color, BASIC_PALETTE[i]) < distance(color, BASIC_PALETTE[best])) {
+                    best = i;
+                }
+            }
+            return best;
+        }
+        
+        // Built once; every lookup afterwards is an array index
+        struct ColorTables {
+            uint8_t cubeIndex[256];   // channel value -> nearest cube level
+            uint8_t grayIndex[256];   // channel value -> nearest gray ramp step
+            uint8_t basicFrom256[256];
+            uint8_t basicFromRgb[4096];  // 4 bits per channel
+            
+            ColorTables() {
+                for (int value = 0; value < 256; ++value) {
+                    int best = 0;
+                    for (int level = 1; level < 6; ++level) {
+                        if (std::abs(value - CUBE_LEVELS[level]) < std::abs(value - CUBE_LEVELS[best])) {
+                            best = level;
+                        }
+                    }
+                    cubeIndex[value] = static_cast<uint8_t>(best);
+                    grayIndex[value] = static_cast<uint8_t>(std::min(23, std::max(0, (value - 3) / 10)));
+                }
+                for (int index = 0; index < 256; ++index) {
+                    basicFrom256[index] = index < 16 ? static_cast<uint8_t>(index) : nearestBasic(paletteColor(index));
+                }
+                for (int bin = 0; bin < 4096; ++bin) {
+                    Rgb center = {((bin >> 8) << 4) | 8, (((bin >> 4) & 0xF) << 4) | 8, ((bin & 0xF) << 4) | 8};
+                    basicFromRgb[bin] = nearestBasic(center);
+                }
+            }
+        };
+        
+        const ColorTables& colorTables() {
+            static const ColorTables tables;
+            return tables;
+        }
+        
+        void appendColor(std::string& out, bool background, uint8_t index, ColorDepth depth) {
+            if (depth == ColorDepth::Basic || index < 16) {
+                uint8_t basic = depth == ColorDepth::Basic ? colorTables().basicFrom256[index] : index;
+                int base = basic < 8 ? (background ? 40 : 30) : (background ? 100 : 90);
+                out += std::to_string(base + basic % 8);
+            } else {
+                out += background ? "48;5;" : "38;5;";
+                out += std::to_string(index);
+            }
+        }
+    }
+    
+    uint8_t rgbTo256(int r, int g, int b) {
+        const ColorTables& tables = colorTables();
+        r = std::clamp(r, 0, 255);
+        g = std::clamp(g, 0, 255);
+        b = std::clamp(b, 0, 255);
+        Rgb color = {r, g, b};
         
-        std::string termStr(term);
-        return termStr.find("color") != std::string::npos ||
-               termStr.find("xterm") != std::string::npos ||
-               termStr.find("screen") != std::string::npos;
+        int cube = 16 + 36 * tables.cubeIndex[r] + 6 * tables.cubeIndex[g] + tables.cubeIndex[b];
+        int gray = 232 + tables.grayIndex[(r + g + b) / 3];
+        return static_cast<uint8_t>(distance(color, paletteColor(gray)) < distance(color, paletteColor(cube)) ? gray : cube);
+    }
+    
+    uint8_t rgbTo16(int r, int g, int b) {
+        r = std::clamp(r, 0, 255);
+        g = std::clamp(g, 0, 255);
+        b = std::clamp(b, 0, 255);
+        return colorTables().basicFromRgb[((r >> 4) << 8) | ((g >> 4) << 4) | (b >> 4)];
     }
+    
+    uint8_t ansi256To16(int colorCode) {
+        return colorTables().basicFrom256[std::clamp(colorCode, 0, 255)];
+    }
+    
+    std::string downsample(const std::string& sequence, ColorDepth depth) {
+        if (depth == ColorDepth::TrueColor) {
+            return sequence;
+        }
+        
+        std::string out;
+        size_t pos = 0;
+        while (pos < sequence.size()) {
+            size_t start = sequence.find("\033[", pos);
+            if (start == std::string::npos) {
+                out.append(sequence, pos, std::string::npos);
+                break;
+            }
+            out.append(sequence, pos, start - pos);
+            size_t end = sequence.find_first_not_of("0123456789;", start + 2);
+            if (end == std::string::npos || sequence[end] != 'm') {
+                // Not SGR; keep it untouched
+                size_t next = end == std::string::npos ? sequence.size() : end + 1;
+                out.append(sequence, start, next - start);
+                pos = next;
+                continue;
+            }
+            pos = end + 1;
+            if (depth == ColorDepth::None) {
+                continue;
+            }
+            
+            std::vector<int> params;
+            for (const auto& field : Utils::split(sequence.substr(start + 2, end - start - 2), ';')) {
+                params.push_back(field.empty() ? 0 : std::atoi(field.c_str()));
+            }
+            std::string rewritten = "\033[";
+            for (size_t i = 0; i < params.size(); ++i) {
+                if (rewritten.size() > 2) {
+                    rewritten += ';';
+                }
+                int code = params[i];
+                bool extended = (code == 38 || code == 48) && i + 1 < params.size();
+                if (extended && params[i + 1] == 2 && i + 4 < params.size()) {
+                    uint8_t index = depth == ColorDepth::Basic ? rgbTo16(params[i + 2], params[i + 3], params[i + 4])
+                                                               : rgbTo256(params[i + 2], params[i + 3], params[i + 4]);
+                    appendColor(rewritten, code == 48, index, depth == ColorDepth::Basic ? ColorDepth::Extended : depth);
+                    i += 4;
+                } else if (extended && params[i + 1] == 5 && i + 2 < params.size()) {
+                    appendColor(rewritten, code == 48, static_cast<uint8_t>(std::clamp(params[i + 2], 0, 255)), depth);
+                    i += 2;
+                } else {
+                    rewritten += std::to_string(code);
+                }
+            }
+            out += rewritten;
+            out += 'm';
+        }
+        return out;
+    }
+}
+
+// Prompt Template Implementation
+namespace {
+    struct PlaceholderName {
+        const char* name;
+        PromptTemplate::Field field;
+    };
+
+    const PlaceholderName PLACEHOLDERS[] = {
+        {"prefix", PromptTemplate::Field::Prefix},
+        {"suffix", PromptTemplate::Field::Suffix},
+        {"directory", PromptTemplate::Field::Directory},
+        {"cwd", PromptTemplate::Field::Directory},
+        {"user", PromptTemplate::Field::User},
+        {"host", PromptTemplate::Field::Host},
+        {"exit_code", PromptTemplate::Field::ExitCode},
+        {"timestamp", PromptTemplate::Field::Timestamp},
+        {"time", PromptTemplate::Field::Timestamp},
+        {"git", PromptTemplate::Field::Git},
+        {"symbol", PromptTemplate::Field::Symbol},
+    };
+}
+
+PromptTemplate::PromptTemplate(const std::string& format) {
+    compile(format);
+}
+
+void PromptTemplate::compile(const std::string& format) {
+    literals.clear();
+    segments.clear();
+    fieldMask = 0;
+
+    auto appendLiteral = [this](const char* text, size_t length) {
+        if (!segments.empty() && segments.back().field == Field::Literal) {
+            segments.back().length += static_cast<uint32_t>(length);
+        } else {
+            segments.push_back({Field::Literal, static_cast<uint32_t>(literals.size()), static_cast<uint32_t>(length)});
+        }
+        literals.append(text, length);
+    };
+
+    size_t i = 0;
+    while (i < format.size()) {
+        // Theme files write line breaks as a literal backslash-n
+        if (format[i] == '\\' && i + 1 < format.size() && format[i + 1] == 'n') {
+            appendLiteral("\n", 1);
+            i += 2;
+            continue;
+        }
+
+        if (format[i] == '{') {
+            size_t close = format.find('}', i + 1);
+            if (close != std::string::npos) {
+                std::string_view name(format.data() + i + 1, close - i - 1);
+                const PlaceholderName* match = nullptr;
+                for (const auto& placeholder : PLACEHOLDERS) {
+                    if (name == placeholder.name) {
+                        match = &placeholder;
+                        break;
+                    }
+                }
+                if (match) {
+                    segments.push_back({match->field, 0, 0});
+                    fieldMask |= 1u << static_cast<unsigned>(match->field);
+                    i = close + 1;
+                    continue;
+                }
+            }
+        }
+
+        // Unknown placeholders stay as literal text
+        size_t next = i + 1;
+        while (next < format.size() && format[next] != '{' && format[next] != '\\') {
+            ++next;
+        }
+        appendLiteral(format.data() + i, next - i);
+        i = next;
+    }
+}
+
+void PromptTemplate::render(const Style& style, const Values& values, std::string& out) const {
+    for (const auto& segment : segments) {
+        switch (segment.field) {
+            case Field::Literal:
+                out.append(literals, segment.offset, segment.length);
+                break;
+            case Field::Prefix:
+                out += style.prefix;
+                break;
+            case Field::Suffix:
+                out += style.suffix;
+                break;
+            case Field::Directory:
+                out += style.directory;
+                if (style.directoryLimit > 3 && values.directory.size() > style.directoryLimit) {
+                    out += "...";
+                    out += values.directory.substr(values.directory.size() - (style.directoryLimit - 3));
+                } else {
+                    out += values.directory;
+                }
+                out += style.reset;
+                break;
+            case Field::User:
+                out += style.user;
+                out += values.user;
+                out += style.reset;
+                break;
+            case Field::Host:
+                out += style.host;
+                out += values.host;
+                out += style.reset;
+                break;
+            case Field::ExitCode:
+                if (values.exitCode != 0) {
+                    char code[16];
+                    char* end = std::to_chars(code, code + sizeof(code), values.exitCode).ptr;
+                    out += style.error;
+                    out += '[';
+                    out.append(code, end);
+                    out += ']';
+                    out += style.reset;
+                    out += ' ';
+                }
+                break;
+            case Field::Timestamp: {
+                char stamp[16];
+                std::time_t now = std::time(nullptr);
+                struct tm local;
+                localtime_r(&now, &local);
+                out.append(stamp, std::strftime(stamp, sizeof(stamp), "%H:%M:%S", &local));
+                break;
+            }
+            case Field::Git:
+                if (!values.git.empty()) {
+                    out += values.gitDirty ? style.gitDirty : style.git;
+                    out += " (";
+                    out += values.git;
+                    if (values.gitDirty) out += '*';
+                    out += ')';
+                    out += style.reset;
+                }
+                break;
+            case Field::Symbol:
+                out += style.symbol;
+                out += "$ ";
+                out += style.reset;
+                break;
+        }
+    }
+}
+
+// Theme Colors Implementation
+namespace {
+    const std::string_view COLOR_KEYS[ThemeColors::COUNT] = {
+        "prompt_prefix",
+        "prompt_directory",
+        "prompt_suffix",
+        "prompt_input",
+        "prompt_user",
+        "prompt_host",
+        "output_normal",
+        "output_success",
+        "output_warning",
+        "output_error",
+        "output_info",
+        "syntax_keyword",
+        "syntax_string",
+        "syntax_number",
+        "syntax_comment",
+        "syntax_operator",
+        "highlight_background",
+        "selection_background",
+        "cursor_color",
+        "reset",
+        "bold",
+        "dim",
+        "underline"
+    };
+    
+    // Key names of the original flat .theme format
+    const struct {
+        std::string_view key;
+        ThemeColor color;
+    } LEGACY_COLOR_KEYS[] = {
+        {"prompt_user_color", ThemeColor::PromptUser},
+        {"prompt_host_color", ThemeColor::PromptHost},
+        {"prompt_cwd_color", ThemeColor::PromptDirectory},
+        {"prompt_symbol_color", ThemeColor::PromptSuffix},
+        {"prompt_error_color", ThemeColor::OutputError},
+        {"command_color", ThemeColor::PromptInput},
+        {"output_color", ThemeColor::OutputNormal},
+        {"error_color", ThemeColor::OutputError},
+        {"success_color", ThemeColor::OutputSuccess},
+        {"warning_color", ThemeColor::OutputWarning},
+        {"info_color", ThemeColor::OutputInfo}
+    };
+}
+
+std::string_view ThemeColors::keyName(ThemeColor color) {
+    return COLOR_KEYS[static_cast<size_t>(color)];
+}
+
+bool ThemeColors::fromKey(std::string_view key, ThemeColor& color) {
+    for (size_t i = 0; i < COUNT; ++i) {
+        if (COLOR_KEYS[i] == key) {
+            color = static_cast<ThemeColor>(i);
+            return true;
+        }
+    }
+    for (const auto& legacy : LEGACY_COLOR_KEYS) {
+        if (legacy.key == key) {
+            color = legacy.color;
+            return true;
+        }
+    }
+    return false;
 }
 
 // External Theme Manager Implementation
-ExternalThemeManager::ExternalThemeManager() : currentTheme(nullptr) {
+namespace {
+    // INI values may be double-quoted with C-style escapes for ESC
+    std::string unquoteINIValue(const std::string& value) {
+        if (value.size() < 2 || value.front() != '"' || value.back() != '"') {
+            return value;
+        }
+        std::string out;
+        out.reserve(value.size());
+        for (size_t i = 1; i + 1 < value.size(); ++i) {
+            if (value[i] != '\\' || i + 2 >= value.size()) {
+                out += value[i];
+                continue;
+            }
+            std::string_view rest(value.data() + i + 1, value.size() - i - 2);
+            if (rest.compare(0, 3, "033") == 0) {
+                out += '\033';
+                i += 3;
+            } else if (rest.compare(0, 3, "x1b") == 0 || rest.compare(0, 3, "x1B") == 0) {
+                out += '\033';
+                i += 3;
+            } else if (rest[0] == 'e') {
+                out += '\033';
+                i += 1;
+            } else if (rest[0] == 'n') {
+                out += '\n';
+                i += 1;
+            } else if (rest[0] == '"' || rest[0] == '\\') {
+                out += rest[0];
+                i += 1;
+            } else {
+                out += value[i];
+            }
+        }
+        return out;
+    }
+    
+    // The original format ends the prompt with a literal "$ "; the exit code
+    // and a colored symbol take its place
+    std::string convertLegacyPromptFormat(std::string_view format) {
+        std::string converted(format);
+        size_t symbol = converted.rfind("$ ");
+        if (symbol != std::string::npos) {
+            converted.replace(symbol, 2, "{exit_code}{symbol}");
+        }
+        return converted;
+    }
+    
+    const char LEGACY_PROMPT_FORMAT[] = "{user}@{host}:{cwd}$ ";
+    
+    // Themes that used to be compiled in, in the original key format
+    const struct {
+        const char* theme;
+        const char* key;
+        const char* value;
+    } BUILTIN_THEMES[] = {
+        {"dark", "description", "Modern dark theme with bright colors"},
+        {"dark", "prompt_format", "┌─[{user}@{host}]─[{cwd}]\n└─$ "},
+        {"dark", "prompt_user_color", "bright_green"},
+        {"dark", "prompt_host_color", "bright_blue"},
+        {"dark", "prompt_cwd_color", "bright_cyan"},
+        {"dark", "prompt_symbol_color", "bright_white"},
+        {"dark", "prompt_error_color", "bright_red"},
+        {"dark", "command_color", "bright_white"},
+        {"dark", "output_color", "bright_white"},
+        {"dark", "error_color", "bright_red"},
+        {"dark", "success_color", "bright_green"},
+        {"dark", "warning_color", "bright_yellow"},
+        {"dark", "info_color", "bright_blue"},
+        
+        {"minimal", "description", "Just the prompt symbol"},
+        {"minimal", "prompt_format", "$ "},
+        {"minimal", "prompt_symbol_color", "white"},
+        {"minimal", "command_color", "white"},
+        {"minimal", "output_color", "white"},
+        {"minimal", "error_color", "red"},
+        {"minimal", "success_color", "green"},
+        {"minimal", "warning_color", "yellow"},
+        {"minimal", "info_color", "blue"},
+        
+        {"rainbow", "description", "A color for every part of the prompt"},
+        {"rainbow", "prompt_format", "🌈 {user}@{host}:{cwd} ➜ "},
+        {"rainbow", "prompt_user_color", "magenta"},
+        {"rainbow", "prompt_host_color", "yellow"},
+        {"rainbow", "prompt_cwd_color", "cyan"},
+        {"rainbow", "prompt_symbol_color", "green"},
+        {"rainbow", "prompt_error_color", "red"},
+        {"rainbow", "command_color", "bright_white"},
+        {"rainbow", "output_color", "white"},
+        {"rainbow", "error_color", "bright_red"},
+        {"rainbow", "success_color", "bright_green"},
+        {"rainbow", "warning_color", "bright_yellow"},
+        {"rainbow", "info_color", "bright_blue"}
+    };
+}
+
+ExternalThemeManager::ExternalThemeManager()
+    : currentTheme(nullptr), colorDepth(AnsiColors::detectColorDepth()) {
     initializeDefaultTheme();
+    initializeBuiltinThemes();
     
     // Add default theme paths
     std::string homeDir = Utils::getHomeDirectory();
@@ -53,12 +557,19 @@ ExternalThemeManager::ExternalThemeManager() : currentTheme(nullptr) {
     addThemePath("/usr/local/share/lynx/themes");
     addThemePath("./themes");
     
+    userName = Utils::getUsername();
+    hostName = Utils::getHostname();
+    
     // Set default theme as current
     currentThemeName = "default";
-    currentTheme = defaultTheme.get();
+    selectTheme(*defaultTheme);
 }
 
-ExternalThemeManager::~ExternalThemeManager() = default;
+ExternalThemeManager::~ExternalThemeManager() {
+    if (cacheBuilder.joinable()) {
+        cacheBuilder.join();
+    }
+}
 
 void ExternalThemeManager::initializeDefaultTheme() {
     defaultTheme = std::make_unique<ThemeConfig>();
@@ -68,27 +579,27 @@ void ExternalThemeManager::initializeDefaultTheme() {
     defaultTheme->description = "Default Lynx theme";
     
     // Initialize default colors
-    defaultTheme->colors.promptPrefix = AnsiColors::BRIGHT_BLUE;
-    defaultTheme->colors.promptDirectory = AnsiColors::BRIGHT_CYAN;
-    defaultTheme->colors.promptSuffix = AnsiColors::BRIGHT_GREEN;
-    defaultTheme->colors.promptInput = AnsiColors::WHITE;
-    
-    defaultTheme->colors.outputNormal = AnsiColors::WHITE;
-    defaultTheme->colors.outputSuccess = AnsiColors::BRIGHT_GREEN;
-    defaultTheme->colors.outputWarning = AnsiColors::BRIGHT_YELLOW;
-    defaultTheme->colors.outputError = AnsiColors::BRIGHT_RED;
-    defaultTheme->colors.outputInfo = AnsiColors::BRIGHT_CYAN;
-    
-    defaultTheme->colors.syntaxKeyword = AnsiColors::BRIGHT_BLUE;
-    defaultTheme->colors.syntaxString = AnsiColors::BRIGHT_GREEN;
-    defaultTheme->colors.syntaxNumber = AnsiColors::BRIGHT_MAGENTA;
-    defaultTheme->colors.syntaxComment = AnsiColors::BRIGHT_BLACK;
-    defaultTheme->colors.syntaxOperator = AnsiColors::BRIGHT_YELLOW;
-    
-    defaultTheme->colors.reset = AnsiColors::RESET;
-    defaultTheme->colors.bold = AnsiColors::BOLD;
-    defaultTheme->colors.dim = AnsiColors::DIM;
-    defaultTheme->colors.underline = AnsiColors::UNDERLINE;
+    defaultTheme->colors[ThemeColor::PromptPrefix] = AnsiColors::BRIGHT_BLUE;
+    defaultTheme->colors[ThemeColor::PromptDirectory] = AnsiColors::BRIGHT_CYAN;
+    defaultTheme->colors[ThemeColor::PromptSuffix] = AnsiColors::BRIGHT_GREEN;
+    defaultTheme->colors[ThemeColor::PromptInput] = AnsiColors::WHITE;
+    
+    defaultTheme->colors[ThemeColor::OutputNormal] = AnsiColors::WHITE;
+    defaultTheme->colors[ThemeColor::OutputSuccess] = AnsiColors::BRIGHT_GREEN;
+    defaultTheme->colors[ThemeColor::OutputWarning] = AnsiColors::BRIGHT_YELLOW;
+    defaultTheme->colors[ThemeColor::OutputError] = AnsiColors::BRIGHT_RED;
+    defaultTheme->colors[ThemeColor::OutputInfo] = AnsiColors::BRIGHT_CYAN;
+    
+    defaultTheme->colors[ThemeColor::SyntaxKeyword] = AnsiColors::BRIGHT_BLUE;
+    defaultTheme->colors[ThemeColor::SyntaxString] = AnsiColors::BRIGHT_GREEN;
+    defaultTheme->colors[ThemeColor::SyntaxNumber] = AnsiColors::BRIGHT_MAGENTA;
+    defaultTheme->colors[ThemeColor::SyntaxComment] = AnsiColors::BRIGHT_BLACK;
+    defaultTheme->colors[ThemeColor::SyntaxOperator] = AnsiColors::BRIGHT_YELLOW;
+    
+    defaultTheme->colors[ThemeColor::Reset] = AnsiColors::RESET;
+    defaultTheme->colors[ThemeColor::Bold] = AnsiColors::BOLD;
+    defaultTheme->colors[ThemeColor::Dim] = AnsiColors::DIM;
+    defaultTheme->colors[ThemeColor::Underline] = AnsiColors::UNDERLINE;
     
     defaultTheme->promptFormat = "{prefix}[{directory}]{suffix} ";
     defaultTheme->showGitBranch = false;
@@ -103,26 +614,136 @@ void ExternalThemeManager::addThemePath(const std::string& path) {
 }
 
 void ExternalThemeManager::discoverThemes() {
-    for (const auto& path : themePaths) {
-        if (!std::filesystem::exists(path)) {
+    // Only directory entries are read here; parsing waits until a theme is used
+    themeIndex.clear();
+    availableThemes.clear();
+    parsedFiles.clear();
+    std::vector<ThemeCache::Source> sources = findThemeFiles(themePaths);
+    for (const auto& source : sources) {
+        themeIndex[std::filesystem::path(source.path).stem().string()].push_back(source.path);
+    }
+    
+    if (!cacheFile.empty()) {
+        themeCache = std::make_unique<ThemeCache>();
+        if (!themeCache->open(cacheFile) || !themeCache->isCurrent(sources)) {
+            rebuildCache(std::move(sources));
+        }
+    }
+}
+
+std::vector<ThemeCache::Source> ExternalThemeManager::findThemeFiles(const std::vector<std::string>& paths) {
+    std::vector<ThemeCache::Source> sources;
+    for (const auto& path : paths) {
+        std::error_code error;
+        std::filesystem::directory_iterator entries(path, error);
+        if (error) {
             continue;
         }
         
-        try {
-            for (const auto& entry : std::filesystem::directory_iterator(path)) {
-                if (entry.is_regular_file()) {
-                    std::string filename = entry.path().filename().string();
-                    if (filename.find(".json") != std::string::npos || 
-                        filename.find(".ini") != std::string::npos || 
-                        filename.find(".theme") != std::string::npos) {
-                        loadThemeFromFile(entry.path().string());
-                    }
-                }
+        for (const auto& entry : entries) {
+            std::string ext = entry.path().extension().string();
+            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+            // Paths are made absolute so cache records do not depend on the
+            // directory the shell started in
+            ThemeCache::Source source;
+            if ((ext == ".json" || ext == ".ini" || ext == ".theme") &&
+                ThemeCache::statSource(std::filesystem::absolute(entry.path(), error).string(), source)) {
+                sources.push_back(std::move(source));
             }
-        } catch (const std::filesystem::filesystem_error& e) {
-            std::cerr << "Error scanning theme directory " << path << ": " << e.what() << std::endl;
         }
     }
+    return sources;
+}
+
+void ExternalThemeManager::compileThemes() const {
+    if (!cacheFile.empty()) {
+        writeCache(findThemeFiles(themePaths));
+    }
+}
+
+void ExternalThemeManager::rebuildCache(std::vector<ThemeCache::Source> sources) {
+    if (cacheBuilder.joinable()) {
+        cacheBuilder.join();
+    }
+    cacheBuilder = std::thread([this, sources = std::move(sources)]() {
+        writeCache(sources);
+    });
+}
+
+void ExternalThemeManager::writeCache(const std::vector<ThemeCache::Source>& sources) const {
+    // Only the const readers run here, and they touch no shared state, so
+    // this may run on any thread; errors are left for the text loaders to
+    // report when a theme is used
+    std::vector<ThemeConfig> themes(sources.size());
+    std::vector<ThemeCache::Record> records;
+    records.reserve(sources.size());
+    for (size_t i = 0; i < sources.size(); ++i) {
+        std::string error;
+        bool valid = readThemeFile(sources[i].path, themes[i], error) && validateTheme(themes[i]);
+        records.push_back({sources[i], valid ? &themes[i] : nullptr});
+    }
+    ThemeCache::write(cacheFile, records);
+}
+
+void ExternalThemeManager::parseIndexedFile(const std::string& themeFile) const {
+    // Parsing fills the cache behind the const interface
+    if (!parsedFiles.insert(themeFile).second) {
+        return;
+    }
+    
+    // A compiled theme is only trusted while the file still matches it; a
+    // file cached as invalid goes to the text loader so the error is shown
+    ThemeCache::Source source;
+    if (themeCache && ThemeCache::statSource(themeFile, source)) {
+        auto theme = std::make_unique<ThemeConfig>();
+        if (themeCache->lookup(source, *theme) == ThemeCache::Lookup::Hit) {
+            availableThemes[theme->name] = std::move(theme);
+            return;
+        }
+    }
+    const_cast<ExternalThemeManager*>(this)->loadThemeFromFile(themeFile);
+}
+
+void ExternalThemeManager::parseAllIndexedFiles() const {
+    for (const auto& [stem, files] : themeIndex) {
+        for (const auto& file : files) {
+            parseIndexedFile(file);
+        }
+    }
+}
+
+const ThemeConfig* ExternalThemeManager::findTheme(const std::string& themeName) const {
+    auto it = availableThemes.find(themeName);
+    if (it != availableThemes.end()) {
+        return it->second.get();
+    }
+    
+    // Themes are normally named after their file; only a theme whose file is
+    // named differently needs every file parsed
+    auto indexed = themeIndex.find(themeName);
+    if (indexed != themeIndex.end()) {
+        for (const auto& file : indexed->second) {
+            parseIndexedFile(file);
+        }
+        it = availableThemes.find(themeName);
+        if (it != availableThemes.end()) {
+            return it->second.get();
+        }
+    }
+    
+    // A theme file with the same name has replaced a built-in theme by now
+    auto builtin = builtinThemes.find(themeName);
+    if (builtin != builtinThemes.end()) {
+        return builtin->second.get();
+    }
+    
+    // The stock config names the default theme, which has no file of its own
+    if (themeName == "default") {
+        return nullptr;
+    }
+    parseAllIndexedFiles();
+    it = availableThemes.find(themeName);
+    return it != availableThemes.end() ? it->second.get() : nullptr;
 }
 
 bool ExternalThemeManager::loadTheme(const std::string& themePath) {
@@ -130,151 +751,296 @@ bool ExternalThemeManager::loadTheme(const std::string& themePath) {
 }
 
 bool ExternalThemeManager::loadThemeFromFile(const std::string& themeFile) {
-    if (!std::filesystem::exists(themeFile)) {
+    auto theme = std::make_unique<ThemeConfig>();
+    std::string error;
+    bool parsed = readThemeFile(themeFile, *theme, error);
+    return registerTheme(std::move(theme), parsed, error);
+}
+
+bool ExternalThemeManager::loadThemeFromJSON(const std::string& jsonFile) {
+    auto theme = std::make_unique<ThemeConfig>();
+    std::string error;
+    bool parsed = readThemeJSON(jsonFile, *theme, error);
+    return registerTheme(std::move(theme), parsed, error);
+}
+
+bool ExternalThemeManager::loadThemeFromINI(const std::string& iniFile) {
+    auto theme = std::make_unique<ThemeConfig>();
+    bool parsed = readThemeINI(iniFile, *theme);
+    return registerTheme(std::move(theme), parsed, "");
+}
+
+bool ExternalThemeManager::registerTheme(std::unique_ptr<ThemeConfig> theme, bool parsed, const std::string& error) {
+    if (!error.empty()) {
+        std::cerr << "lynx: " << error << std::endl;
+    }
+    if (!parsed || !validateTheme(*theme)) {
         return false;
     }
-    
-    ThemeConfig theme;
-    
+    availableThemes[theme->name] = std::move(theme);
+    return true;
+}
+
+bool ExternalThemeManager::readThemeFile(const std::string& themeFile, ThemeConfig& theme, std::string& error) const {
     std::string ext = std::filesystem::path(themeFile).extension().string();
     std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
     
-    bool success = false;
+    // Anything that is not JSON is read as INI
     if (ext == ".json") {
-        success = loadThemeFromJSON(themeFile);
-    } else if (ext == ".ini" || ext == ".theme") {
-        success = loadThemeFromINI(themeFile);
-    } else {
-        success = parseThemeFile(themeFile, theme);
+        return readThemeJSON(themeFile, theme, error);
+    }
+    return readThemeINI(themeFile, theme);
+}
+
+bool ExternalThemeManager::readThemeJSON(const std::string& jsonFile, ThemeConfig& theme, std::string& error) const {
+    MappedFile file;
+    if (!file.open(jsonFile)) {
+        return false;
     }
+    initializeThemeDefaults(theme);
     
-    if (success && !theme.name.empty()) {
-        auto newTheme = std::make_unique<ThemeConfig>(std::move(theme));
-        if (validateTheme(*newTheme)) {
-            availableThemes[newTheme->name] = std::move(newTheme);
+    JsonReader reader(file.data(), file.size());
+    JsonReader::Token token = reader.next();
+    if (token == JsonReader::Token::BeginObject) {
+        if (readJSONObject(reader, theme, "") && reader.next() == JsonReader::Token::End) {
             return true;
         }
+    } else if (token != JsonReader::Token::Error) {
+        error = jsonFile + ": theme must be a JSON object";
+        return false;
     }
-    
+    error = jsonFile + ":" + std::to_string(reader.errorLine()) + ":" + std::to_string(reader.errorColumn()) +
+            ": " + reader.errorMessage();
     return false;
 }
 
-bool ExternalThemeManager::loadThemeFromJSON(const std::string& jsonFile) {
-    // This is a simplified JSON parser - in a real implementation,
-    // you might want to use a proper JSON library like nlohmann/json
-    std::ifstream file(jsonFile);
-    if (!file.is_open()) {
-        return false;
-    }
-    
-    auto theme = std::make_unique<ThemeConfig>();
-    std::string line;
-    
-    // Simple JSON parsing (this is basic - consider using a proper JSON library)
-    while (std::getline(file, line)) {
-        // Remove whitespace and quotes
-        line = std::regex_replace(line, std::regex("^\\s+|\\s+$"), "");
-        line = std::regex_replace(line, std::regex("\""), "");
+bool ExternalThemeManager::readJSONObject(JsonReader& reader, ThemeConfig& theme, const std::string& section) const {
+    std::string key;
+    while (true) {
+        JsonReader::Token token = reader.next();
+        if (token == JsonReader::Token::EndObject) {
+            return true;
+        }
+        if (token != JsonReader::Token::Key) {
+            return false;
+        }
+        // The key's text does not outlive the next token
+        key.assign(reader.text());
         
-        if (line.find("name:") != std::string::npos) {
-            size_t pos = line.find(":");
-            if (pos != std::string::npos) {
-                theme->name = line.substr(pos + 1);
-                theme->name = std::regex_replace(theme->name, std::regex("^\\s+|\\s+$|,$"), "");
-            }
+        token = reader.next();
+        switch (token) {
+            case JsonReader::Token::BeginObject:
+                // Nested objects flatten into dotted section names
+                if (!readJSONObject(reader, theme, section.empty() ? key : section + "." + key)) {
+                    return false;
+                }
+                break;
+            case JsonReader::Token::String:
+            case JsonReader::Token::Number:
+                applyThemeSetting(theme, section, key, reader.text());
+                break;
+            case JsonReader::Token::True:
+                applyThemeSetting(theme, section, key, "true");
+                break;
+            case JsonReader::Token::False:
+                applyThemeSetting(theme, section, key, "false");
+                break;
+            case JsonReader::Token::Null:
+                break;
+            default:
+                // Arrays have no place in a theme
+                if (!reader.skip(token)) {
+                    return false;
+                }
+                break;
         }
-        // Add more JSON parsing logic here...
     }
-    
-    if (!theme->name.empty() && validateTheme(*theme)) {
-        availableThemes[theme->name] = std::move(theme);
-        return true;
-    }
-    
-    return false;
 }
 
-bool ExternalThemeManager::loadThemeFromINI(const std::string& iniFile) {
+bool ExternalThemeManager::readThemeINI(const std::string& iniFile, ThemeConfig& theme) const {
     std::ifstream file(iniFile);
     if (!file.is_open()) {
         return false;
     }
-    
-    auto theme = std::make_unique<ThemeConfig>();
+    initializeThemeDefaults(theme);
     std::string line;
     std::string currentSection;
+    bool sectioned = false;
     
     while (std::getline(file, line)) {
-        // Remove comments and trim whitespace
-        size_t commentPos = line.find('#');
-        if (commentPos != std::string::npos) {
-            line = line.substr(0, commentPos);
+        // Remove comments and trim whitespace; a '#' directly followed by
+        // text is a hex color, not a comment
+        for (size_t commentPos = line.find('#'); commentPos != std::string::npos;
+             commentPos = line.find('#', commentPos + 1)) {
+            bool startsComment = (commentPos == 0 || std::isspace(static_cast<unsigned char>(line[commentPos - 1]))) &&
+                                 (commentPos + 1 == line.size() || !std::isxdigit(static_cast<unsigned char>(line[commentPos + 1])));
+            if (startsComment) {
+                line.erase(commentPos);
+                break;
+            }
         }
-        line = std::regex_replace(line, std::regex("^\\s+|\\s+$"), "");
+        line = Utils::trim(line);
         
         if (line.empty()) continue;
         
         // Check for section headers
         if (line.front() == '[' && line.back() == ']') {
             currentSection = line.substr(1, line.length() - 2);
+            sectioned = true;
             continue;
         }
         
         // Parse key-value pairs
         size_t equalPos = line.find('=');
         if (equalPos != std::string::npos) {
-            std::string key = line.substr(0, equalPos);
-            std::string value = line.substr(equalPos + 1);
-            
-            // Trim key and value
-            key = std::regex_replace(key, std::regex("^\\s+|\\s+$"), "");
-            value = std::regex_replace(value, std::regex("^\\s+|\\s+$"), "");
-            
-            // Process based on section
-            if (currentSection == "info") {
-                if (key == "name") theme->name = value;
-                else if (key == "version") theme->version = value;
-                else if (key == "author") theme->author = value;
-                else if (key == "description") theme->description = value;
-            } else if (currentSection == "colors") {
-                std::string colorCode = resolveColorCode(value);
-                if (key == "prompt_prefix") theme->colors.promptPrefix = colorCode;
-                else if (key == "prompt_directory") theme->colors.promptDirectory = colorCode;
-                else if (key == "prompt_suffix") theme->colors.promptSuffix = colorCode;
-                else if (key == "output_success") theme->colors.outputSuccess = colorCode;
-                else if (key == "output_error") theme->colors.outputError = colorCode;
-                // Add more color mappings...
-            } else if (currentSection == "settings") {
-                if (key == "prompt_format") theme->promptFormat = value;
-                else if (key == "show_git_branch") theme->showGitBranch = (value == "true");
-                else if (key == "show_exit_code") theme->showExitCode = (value == "true");
-                else if (key == "show_timestamp") theme->showTimestamp = (value == "true");
-            }
+            std::string key = Utils::trim(line.substr(0, equalPos));
+            std::string value = unquoteINIValue(Utils::trim(line.substr(equalPos + 1)));
+            applyThemeSetting(theme, currentSection, key, value);
         }
     }
-    
-    if (!theme->name.empty() && validateTheme(*theme)) {
-        availableThemes[theme->name] = std::move(theme);
-        return true;
+    if (!sectioned) {
+        completeLegacyTheme(theme, std::filesystem::path(iniFile).stem().string());
+    }
+    return true;
+}
+
+void ExternalThemeManager::initializeThemeDefaults(ThemeConfig& theme) {
+    theme.colors[ThemeColor::Reset] = AnsiColors::RESET;
+    theme.colors[ThemeColor::Bold] = AnsiColors::BOLD;
+    theme.colors[ThemeColor::Dim] = AnsiColors::DIM;
+    theme.colors[ThemeColor::Underline] = AnsiColors::UNDERLINE;
+    theme.showGitBranch = false;
+    theme.showExitCode = false;
+    theme.showTimestamp = false;
+}
+
+void ExternalThemeManager::applyThemeSetting(ThemeConfig& theme, std::string_view section,
+                                             std::string_view key, std::string_view value) const {
+    // Both file formats share these keys; anything unrecognized is kept in
+    // customSettings under "section.key". The original format has no
+    // sections, so its keys are looked up outside any section.
+    ThemeColor color;
+    if (section.empty() || section == "info") {
+        if (key == "name") { theme.name = value; return; }
+        if (key == "version") { theme.version = value; return; }
+        if (key == "author") { theme.author = value; return; }
+        if (key == "description") { theme.description = value; return; }
+    }
+    if ((section.empty() || section == "colors") && ThemeColors::fromKey(key, color)) {
+        theme.colors[color] = resolveColorCode(std::string(value));
+        return;
+    }
+    if (section.empty() && key == "prompt_format") {
+        theme.promptFormat = convertLegacyPromptFormat(value);
+        return;
+    }
+    if (section == "settings") {
+        if (key == "prompt_format") { theme.promptFormat = value; return; }
+        if (key == "show_git_branch") { theme.showGitBranch = value == "true"; return; }
+        if (key == "show_exit_code") { theme.showExitCode = value == "true"; return; }
+        if (key == "show_timestamp") { theme.showTimestamp = value == "true"; return; }
+    } else if (section == "custom") {
+        theme.customSettings[std::string(key)] = value;
+        return;
     }
     
-    return false;
+    std::string name;
+    if (section.compare(0, 7, "custom.") == 0) {
+        name.assign(section.substr(7)).append(".");
+    } else if (!section.empty()) {
+        name.assign(section).append(".");
+    }
+    name.append(key);
+    theme.customSettings[std::move(name)] = value;
+}
+
+void ExternalThemeManager::completeLegacyTheme(ThemeConfig& theme, const std::string& name) {
+    // Files in the original format carry no metadata; they are named after
+    // the file and keep the prompt the old engine fell back to
+    if (theme.name.empty()) theme.name = name;
+    if (theme.version.empty()) theme.version = "1.0";
+    if (theme.promptFormat.empty()) theme.promptFormat = convertLegacyPromptFormat(LEGACY_PROMPT_FORMAT);
+}
+
+void ExternalThemeManager::initializeBuiltinThemes() {
+    for (const auto& setting : BUILTIN_THEMES) {
+        std::unique_ptr<ThemeConfig>& theme = builtinThemes[setting.theme];
+        if (!theme) {
+            theme = std::make_unique<ThemeConfig>();
+            initializeThemeDefaults(*theme);
+            theme->author = "Lynx Shell";
+        }
+        applyThemeSetting(*theme, "", setting.key, setting.value);
+    }
+    for (auto& [name, theme] : builtinThemes) {
+        completeLegacyTheme(*theme, name);
+    }
 }
 
 bool ExternalThemeManager::setTheme(const std::string& themeName) {
-    auto it = availableThemes.find(themeName);
-    if (it != availableThemes.end()) {
+    if (const ThemeConfig* theme = getTheme(themeName)) {
         currentThemeName = themeName;
-        currentTheme = it->second.get();
-        return true;
-    } else if (themeName == "default") {
-        currentThemeName = "default";
-        currentTheme = defaultTheme.get();
+        selectTheme(*theme);
         return true;
     }
     return false;
 }
 
+void ExternalThemeManager::setColorDepth(AnsiColors::ColorDepth depth) {
+    if (depth != colorDepth) {
+        colorDepth = depth;
+        if (const ThemeConfig* theme = getTheme(currentThemeName)) {
+            selectTheme(*theme);
+        }
+    }
+}
+
+void ExternalThemeManager::selectTheme(const ThemeConfig& theme) {
+    // Colors are converted for the terminal once here, so rendering only
+    // ever copies prebuilt sequences
+    resolvedTheme = std::make_unique<ThemeConfig>(theme);
+    for (std::string& color : resolvedTheme->colors.sequences) {
+        color = AnsiColors::downsample(color, colorDepth);
+    }
+    currentTheme = resolvedTheme.get();
+    compilePrompt();
+}
+
+void ExternalThemeManager::compilePrompt() {
+    const ThemeColors& colors = currentTheme->colors;
+    std::string format = currentTheme->promptFormat;
+
+    // show_git_branch puts the branch after the directory unless the format
+    // already places {git} itself
+    if (currentTheme->showGitBranch && format.find("{git}") == std::string::npos) {
+        size_t directory = format.find("{directory}");
+        size_t length = 11;
+        if (directory == std::string::npos) {
+            directory = format.find("{cwd}");
+            length = 5;
+        }
+        if (directory != std::string::npos) {
+            format.insert(directory + length, "{git}");
+        }
+    }
+
+    promptTemplate.compile(format);
+    promptStyle = PromptTemplate::Style();
+    promptStyle.prefix = colors[ThemeColor::PromptPrefix];
+    promptStyle.suffix = colors[ThemeColor::PromptSuffix];
+    promptStyle.directory = colors[ThemeColor::PromptDirectory];
+    // Themes without their own user and host colors use the prefix color
+    const std::string& user = colors[ThemeColor::PromptUser];
+    const std::string& host = colors[ThemeColor::PromptHost];
+    promptStyle.user = user.empty() ? colors[ThemeColor::PromptPrefix] : user;
+    promptStyle.host = host.empty() ? colors[ThemeColor::PromptPrefix] : host;
+    promptStyle.symbol = colors[ThemeColor::PromptSuffix];
+    promptStyle.error = colors[ThemeColor::OutputError];
+    promptStyle.git = colors[ThemeColor::OutputSuccess];
+    promptStyle.gitDirty = colors[ThemeColor::OutputWarning];
+    promptStyle.reset = colors[ThemeColor::Reset];
+}
+
 const ThemeConfig* ExternalThemeManager::getCurrentTheme() const {
     return currentTheme;
 }
@@ -284,28 +1050,41 @@ std::string ExternalThemeManager::getCurrentThemeName() const {
 }
 
 std::vector<std::string> ExternalThemeManager::getAvailableThemes() const {
+    parseAllIndexedFiles();
     std::vector<std::string> themes;
     themes.push_back("default");
     
     for (const auto& [name, theme] : availableThemes) {
         themes.push_back(name);
     }
+    for (const auto& [name, theme] : builtinThemes) {
+        if (!availableThemes.count(name)) {
+            themes.push_back(name);
+        }
+    }
     
     return themes;
 }
 
+// A default.theme file replaces the built-in default
 const ThemeConfig* ExternalThemeManager::getTheme(const std::string& themeName) const {
-    if (themeName == "default") {
+    const ThemeConfig* theme = findTheme(themeName);
+    if (!theme && themeName == "default") {
         return defaultTheme.get();
     }
-    
-    auto it = availableThemes.find(themeName);
-    return (it != availableThemes.end()) ? it->second.get() : nullptr;
+    return theme;
 }
 
 void ExternalThemeManager::listThemes() const {
+    parseAllIndexedFiles();
     std::cout << "Available Themes:" << std::endl;
     std::cout << "  default (built-in)" << std::endl;
+    for (const auto& [name, theme] : builtinThemes) {
+        if (!availableThemes.count(name)) {
+            std::cout << "  " << name << " (built-in)" << std::endl;
+            std::cout << "    " << theme->description << std::endl;
+        }
+    }
     
     for (const auto& [name, theme] : availableThemes) {
         std::cout << "  " << name << " v" << theme->version 
@@ -315,38 +1094,54 @@ void ExternalThemeManager::listThemes() const {
 }
 
 std::string ExternalThemeManager::applyColor(const std::string& text, const std::string& colorCode) const {
-    if (!AnsiColors::isTerminalColorSupported()) {
+    if (colorDepth == AnsiColors::ColorDepth::None) {
         return text;
     }
-    return colorCode + text + currentTheme->colors.reset;
+    return colorCode + text + currentTheme->colors[ThemeColor::Reset];
 }
 
 std::string ExternalThemeManager::formatPrompt(const std::string& directory, int exitCode) const {
+    std::string prompt;
+    formatPrompt(directory, exitCode, prompt);
+    return prompt;
+}
+
+void ExternalThemeManager::formatPrompt(const std::string& directory, int exitCode, std::string& out,
+                                        std::string_view gitBranch, bool gitDirty) const {
+    out.clear();
     if (!currentTheme) {
-        return directory + " $ ";
+        out += directory;
+        out += " $ ";
+        return;
     }
     
-    std::string prompt = currentTheme->promptFormat;
+    PromptTemplate::Values values;
+    values.directory = directory;
+    values.user = userName;
+    values.host = hostName;
+    values.git = gitBranch;
+    values.gitDirty = gitDirty;
+    values.exitCode = exitCode;
+    promptTemplate.render(promptStyle, values, out);
     
-    // Replace placeholders
-    prompt = std::regex_replace(prompt, std::regex("\\{prefix\\}"), currentTheme->colors.promptPrefix);
-    prompt = std::regex_replace(prompt, std::regex("\\{directory\\}"), 
-                               currentTheme->colors.promptDirectory + directory + currentTheme->colors.reset);
-    prompt = std::regex_replace(prompt, std::regex("\\{suffix\\}"), currentTheme->colors.promptSuffix);
-    
-    if (currentTheme->showExitCode && exitCode != 0) {
-        prompt += currentTheme->colors.outputError + "[" + std::to_string(exitCode) + "]" + 
-                 currentTheme->colors.reset + " ";
+    // Themes that do not place {exit_code} themselves get it at the end
+    if (currentTheme->showExitCode && exitCode != 0 && !promptTemplate.uses(PromptTemplate::Field::ExitCode)) {
+        out += currentTheme->colors[ThemeColor::OutputError];
+        out += '[';
+        out += std::to_string(exitCode);
+        out += ']';
+        out += currentTheme->colors[ThemeColor::Reset];
+        out += ' ';
     }
     
-    return prompt + currentTheme->colors.reset;
+    out += currentTheme->colors[ThemeColor::Reset];
 }
 
 bool ExternalThemeManager::validateTheme(const ThemeConfig& theme) const {
     return !theme.name.empty() && 
            !theme.version.empty() &&
-           isValidColorCode(theme.colors.promptPrefix) &&
-           isValidColorCode(theme.colors.outputNormal);
+           isValidColorCode(theme.colors[ThemeColor::PromptPrefix]) &&
+           isValidColorCode(theme.colors[ThemeColor::OutputNormal]);
 }
 
 std::vector<std::string> ExternalThemeManager::getThemeErrors(const ThemeConfig& theme) const {
@@ -358,19 +1153,13 @@ std::vector<std::string> ExternalThemeManager::getThemeErrors(const ThemeConfig&
     if (theme.version.empty()) {
         errors.push_back("Theme version is required");
     }
-    if (!isValidColorCode(theme.colors.promptPrefix)) {
+    if (!isValidColorCode(theme.colors[ThemeColor::PromptPrefix])) {
         errors.push_back("Invalid prompt prefix color code");
     }
     
     return errors;
 }
 
-bool ExternalThemeManager::parseThemeFile(const std::string& filePath, ThemeConfig& theme) {
-    // Fallback parser for custom theme file formats
-    (void)theme; // Suppress unused parameter warning
-    return loadThemeFromINI(filePath);
-}
-
 std::string ExternalThemeManager::resolveColorCode(const std::string& colorName) const {
     // Map color names to ANSI codes
     static const std::map<std::string, std::string> colorMap = {
@@ -397,6 +1186,11 @@ std::string ExternalThemeManager::resolveColorCode(const std::string& colorName)
     };
     
     auto it = colorMap.find(colorName);
+    if (it == colorMap.end() && std::any_of(colorName.begin(), colorName.end(), ::isupper)) {
+        std::string lower = colorName;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        it = colorMap.find(lower);
+    }
     if (it != colorMap.end()) {
         return it->second;
     }
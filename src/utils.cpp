@@ -5,6 +5,7 @@
 #include <cstdlib>
 #include <pwd.h>
 #include <limits.h>
+#include <sys/stat.h>
 #include <iostream>
 
 std::string Utils::trim(const std::string& str) {
@@ -54,6 +55,14 @@ bool Utils::changeDirectory(const std::string& path) {
     return chdir(path.c_str()) == 0;
 }
 
+int64_t Utils::getModificationTimeNs(const struct stat& st) {
+#ifdef __APPLE__
+    return static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+}
+
 std::string Utils::getEnvVar(const std::string& name) {
     const char* value = getenv(name.c_str());
     return value ? std::string(value) : "";
@@ -0,0 +1,151 @@
+#include "working_directory.h"
+#include "utils.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Working Directory Implementation
+WorkingDirectory::WorkingDirectory() {
+    // An inherited $PWD keeps the parent's symlinked path, but only if it
+    // still names the directory we are actually in
+    std::string inherited = Utils::getEnvVar("PWD");
+    struct stat pwdStat, dotStat;
+    if (!inherited.empty() && inherited[0] == '/' && inherited == resolve("/", inherited) &&
+        stat(inherited.c_str(), &pwdStat) == 0 && stat(".", &dotStat) == 0 &&
+        pwdStat.st_dev == dotStat.st_dev && pwdStat.st_ino == dotStat.st_ino) {
+        logical = inherited;
+    } else {
+        logical = Utils::getCurrentDirectory();
+    }
+    oldLogical = Utils::getEnvVar("OLDPWD");
+    Utils::setEnvVar("PWD", logical);
+}
+
+std::string WorkingDirectory::physical() const {
+    return Utils::getCurrentDirectory();
+}
+
+bool WorkingDirectory::change(const std::string& target, bool physical, std::string& error) {
+    std::string next;
+    if (!physical) {
+        next = resolve(logical, target);
+        if (chdir(next.c_str()) != 0) {
+            next.clear();
+        }
+    }
+
+    // Physical mode, or a logical path that does not exist on disk
+    // (".." out of a symlink whose parent is gone): resolve as the kernel does
+    if (next.empty()) {
+        if (chdir(target.c_str()) != 0) {
+            error = target + ": " + std::strerror(errno);
+            return false;
+        }
+        next = Utils::getCurrentDirectory();
+    }
+
+    oldLogical = logical;
+    logical = next;
+    Utils::setEnvVar("OLDPWD", oldLogical);
+    Utils::setEnvVar("PWD", logical);
+    return true;
+}
+
+std::vector<std::string> WorkingDirectory::listDirectories() const {
+    std::vector<std::string> directories;
+    directories.reserve(stack.size() + 1);
+    directories.push_back(logical);
+    directories.insert(directories.end(), stack.begin(), stack.end());
+    return directories;
+}
+
+bool WorkingDirectory::pushDirectory(const std::string& target, std::string& error) {
+    std::string current = logical;
+    if (!change(target, false, error)) {
+        return false;
+    }
+    stack.insert(stack.begin(), current);
+    return true;
+}
+
+bool WorkingDirectory::exchangeTop(std::string& error) {
+    if (stack.empty()) {
+        error = "no other directory";
+        return false;
+    }
+    std::string current = logical;
+    if (!change(stack.front(), false, error)) {
+        return false;
+    }
+    stack.front() = current;
+    return true;
+}
+
+bool WorkingDirectory::rotateTo(size_t index, std::string& error) {
+    std::vector<std::string> directories = listDirectories();
+    if (index >= directories.size()) {
+        error = "directory stack index out of range";
+        return false;
+    }
+    if (index == 0) {
+        return true;
+    }
+    if (!change(directories[index], false, error)) {
+        return false;
+    }
+
+    // Entries keep their cyclic order with the chosen one on top
+    stack.clear();
+    for (size_t i = 1; i < directories.size(); ++i) {
+        stack.push_back(directories[(index + i) % directories.size()]);
+    }
+    return true;
+}
+
+bool WorkingDirectory::popDirectory(size_t index, std::string& error) {
+    if (stack.empty()) {
+        error = "directory stack empty";
+        return false;
+    }
+    if (index > stack.size()) {
+        error = "directory stack index out of range";
+        return false;
+    }
+    if (index > 0) {
+        stack.erase(stack.begin() + static_cast<std::ptrdiff_t>(index - 1));
+        return true;
+    }
+    if (!change(stack.front(), false, error)) {
+        return false;
+    }
+    stack.erase(stack.begin());
+    return true;
+}
+
+std::string WorkingDirectory::resolve(const std::string& base, const std::string& path) {
+    std::string result = !path.empty() && path[0] == '/' ? "" : base;
+    if (result == "/") {
+        result.clear();
+    }
+
+    size_t pos = 0;
+    while (pos <= path.size()) {
+        size_t slash = path.find('/', pos);
+        if (slash == std::string::npos) {
+            slash = path.size();
+        }
+        size_t length = slash - pos;
+        if (length == 0 || (length == 1 && path[pos] == '.')) {
+            // empty or "." component
+        } else if (length == 2 && path[pos] == '.' && path[pos + 1] == '.') {
+            size_t parent = result.rfind('/');
+            result.erase(parent == std::string::npos ? 0 : parent);
+        } else {
+            result += '/';
+            result.append(path, pos, length);
+        }
+        pos = slash + 1;
+    }
+    return result.empty() ? "/" : result;
+}